@@ -0,0 +1,553 @@
+// Headless microbenchmark of the core DSP kernels.
+//
+// Every kernel runs on the calling thread on synthetic IQ, so the numbers only depend on the DSP
+// code and not on scheduling. Only depends on volk and fftw, no GUI.
+//
+// Usage: sdrpp_dsp_bench [--size <samples>] [--duration <ms>] [--wav <LogMMSE input>] [filter]
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+#include <volk/volk.h>
+#include <dsp/bench/kernel_bench.h>
+#include <dsp/filter/fir.h>
+#include <dsp/filter/decimating_fir.h>
+#include <dsp/multirate/power_decimator.h>
+#include <dsp/multirate/polyphase_resampler.h>
+#include <dsp/multirate/rational_resampler.h>
+#include <dsp/channel/rx_vfo.h>
+#include <dsp/demod/fm.h>
+#include <dsp/demod/am.h>
+#include <dsp/demod/ssb.h>
+#include <dsp/loop/agc.h>
+#include <dsp/noise_reduction/noise_blanker.h>
+#include <dsp/compression/sample_stream_compressor.h>
+#include <dsp/taps/low_pass.h>
+#include <dsp/taps/tap_cache.h>
+#include <dsp/window/nuttall.h>
+#include <gui/widgets/waterfall_zoom.h>
+#include <utils/arrays.h>
+#include <utils/arrays_expr.h>
+#include <utils/wav.h>
+#include "experimental_fft_compressor_reference.h"
+#include "../../misc_modules/noise_reduction_logmmse/src/logmmse.h"
+#include "../../misc_modules/noise_reduction_logmmse/src/logmmse_engine.h"
+
+// Normally provided by utils/networking.cpp which isn't part of the benchmark
+void logDebugMessage(const char* msg) {
+    flog::info("logDebugMessage: {}", msg);
+}
+
+using namespace dsp;
+
+struct BenchContext {
+    int size;
+    int durationMs;
+    std::string filter;
+    std::string wavPath;
+    std::vector<bench::KernelResult> results;
+
+    complex_t* in;
+    complex_t* cout;
+    float* fout;
+    uint8_t* bout;
+
+    bool enabled(const std::string& name) {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    void run(const std::string& name, const std::function<int()>& kernel) {
+        auto res = bench::measureKernel(name, kernel, durationMs);
+        printf("%-40s %10.2f MS/s %10.2f ns/sample\n", res.name.c_str(), res.rate / 1e6, res.nsPerSample);
+        fflush(stdout);
+        results.push_back(res);
+    }
+};
+
+static void benchFilters(BenchContext& ctx) {
+    for (int count : { 32, 128, 512 }) {
+        std::string name = "FIR<complex,float> " + std::to_string(count) + " taps";
+        if (!ctx.enabled(name)) { continue; }
+        tap<float> taps = taps::alloc<float>(count);
+        for (int i = 0; i < count; i++) { taps.taps[i] = 1.0f / (float)count; }
+        filter::FIR<complex_t, float> fir;
+        fir.init(NULL, taps);
+        ctx.run(name + (fir.isUsingFFT() ? " (fft)" : ""), [&]() { return fir.process(ctx.size, ctx.in, ctx.cout); });
+        taps::free(taps);
+    }
+
+    if (ctx.enabled("DecimatingFIR")) {
+        tap<float> taps = taps::lowPass(100e3, 50e3, 1e6);
+        filter::DecimatingFIR<complex_t, float> fir;
+        fir.init(NULL, taps, 4);
+        ctx.run("DecimatingFIR<complex,float> /4 " + std::to_string(taps.size) + " taps", [&]() {
+            fir.process(ctx.size, ctx.in, ctx.cout);
+            return ctx.size;
+        });
+        taps::free(taps);
+    }
+
+    // Filter design, rate is in taps per second
+    if (ctx.enabled("lowPass design")) {
+        const int count = taps::estimateTapCount(1e3, 2.4e6);
+        ctx.run("lowPass design " + std::to_string(count) + " taps", [&]() {
+            tap<float> t = taps::lowPass(100e3, 1e3, 2.4e6);
+            taps::free(t);
+            return count;
+        });
+        float* out = buffer::alloc<float>(count);
+        ctx.run("nuttallWindowedSinc " + std::to_string(count) + " taps", [&]() {
+            taps::nuttallWindowedSinc(out, count, math::hzToRads(100e3, 2.4e6));
+            return count;
+        });
+        buffer::free(out);
+        ctx.run("cache::lowPass " + std::to_string(count) + " taps (hit)", [&]() {
+            tap<float> t = taps::cache::lowPass(100e3, 1e3, 2.4e6);
+            taps::free(t);
+            return count;
+        });
+    }
+}
+
+static void benchMultirate(BenchContext& ctx) {
+    if (ctx.enabled("PowerDecimator")) {
+        multirate::PowerDecimator<complex_t> decim;
+        decim.init(NULL, 16);
+        ctx.run("PowerDecimator<complex> /16", [&]() {
+            decim.process(ctx.size, ctx.in, ctx.cout);
+            return ctx.size;
+        });
+    }
+
+    if (ctx.enabled("PolyphaseResampler")) {
+        tap<float> taps = taps::lowPass(16e3, 4e3, 3 * 48e3);
+        multirate::PolyphaseResampler<complex_t> resamp;
+        resamp.init(NULL, 3, 2, taps);
+        ctx.run("PolyphaseResampler<complex> 3/2", [&]() {
+            resamp.process(ctx.size, ctx.in, ctx.cout);
+            return ctx.size;
+        });
+        taps::free(taps);
+    }
+
+    if (ctx.enabled("RationalResampler")) {
+        multirate::RationalResampler<complex_t> resamp;
+        resamp.init(NULL, 2.4e6, 48e3);
+        ctx.run("RationalResampler<complex> 2.4M->48k", [&]() {
+            resamp.process(ctx.size, ctx.in, ctx.cout);
+            return ctx.size;
+        });
+    }
+}
+
+static void benchChannel(BenchContext& ctx) {
+    if (ctx.enabled("RxVFO")) {
+        channel::RxVFO vfo;
+        vfo.init(NULL, 2.4e6, 250e3, 200e3, 300e3);
+        ctx.run("RxVFO 2.4M->250k", [&]() {
+            vfo.process(ctx.size, ctx.in, ctx.cout);
+            return ctx.size;
+        });
+    }
+}
+
+static void benchDemods(BenchContext& ctx) {
+    if (ctx.enabled("Quadrature")) {
+        // 250k FM carrying two tones at up to 75 kHz deviation, plus a little noise
+        const double samplerate = 250e3;
+        complex_t* fm = bench::randomBuffer<complex_t>(ctx.size);
+        double phase = 0.0;
+        for (int i = 0; i < ctx.size; i++) {
+            double t = (double)i / samplerate;
+            double freq = 50e3 * sin(2.0 * M_PI * 1e3 * t) + 25e3 * sin(2.0 * M_PI * 13.7e3 * t);
+            phase += 2.0 * M_PI * freq / samplerate;
+            fm[i] = complex_t{ (float)cos(phase), (float)sin(phase) } + fm[i] * 0.01f;
+        }
+
+        // The block kernel must track the per sample atan2f path before their speed can be compared
+        demod::Quadrature quad, ref;
+        quad.init(NULL, 75e3, samplerate);
+        ref.init(NULL, 75e3, samplerate);
+        float* refOut = buffer::alloc<float>(ctx.size);
+        quad.process(ctx.size, fm, ctx.fout);
+        ref.processScalar(ctx.size, fm, refOut);
+        float maxErr = 0.0f;
+        for (int i = 0; i < ctx.size; i++) { maxErr = std::max<float>(maxErr, fabsf(ctx.fout[i] - refOut[i])); }
+        printf("Quadrature: max error %g of full deviation relative to the scalar path\n", maxErr);
+        buffer::free(refOut);
+
+        ctx.run("Quadrature 250k (scalar)", [&]() { return ref.processScalar(ctx.size, fm, ctx.fout); });
+        ctx.run("Quadrature 250k", [&]() { return quad.process(ctx.size, fm, ctx.fout); });
+        buffer::free(fm);
+    }
+
+    if (ctx.enabled("FM")) {
+        demod::FM<float> fm;
+        fm.init(NULL, 250e3, 200e3, true, false);
+        ctx.run("FM demod 250k", [&]() { return fm.process(ctx.size, ctx.in, ctx.fout); });
+    }
+
+    if (ctx.enabled("AM")) {
+        demod::AM<float> am;
+        am.init(NULL, demod::AM<float>::CARRIER, 10e3, 50.0 / 15e3, 5.0 / 15e3, 10.0 / 15e3, 15e3);
+        ctx.run("AM demod 15k", [&]() { return am.process(ctx.size, ctx.in, ctx.fout); });
+    }
+
+    if (ctx.enabled("SSB")) {
+        demod::SSB<float> ssb;
+        ssb.init(NULL, demod::SSB<float>::USB, 2.8e3, 24e3, 50.0 / 24e3, 5.0 / 24e3);
+        ctx.run("SSB demod 24k", [&]() { return ssb.process(ctx.size, ctx.in, ctx.fout); });
+    }
+
+    if (ctx.enabled("AGC")) {
+        loop::AGC<complex_t> agc;
+        agc.init(NULL, 1.0, 50.0 / 24e3, 5.0 / 24e3, 10e6, 10.0, INFINITY);
+        ctx.run("AGC<complex> 24k", [&]() { return agc.process(ctx.size, ctx.in, ctx.cout); });
+    }
+
+    if (ctx.enabled("NoiseBlanker")) {
+        noise_reduction::NoiseBlanker nb;
+        nb.init(NULL, 500.0 / 24e3, 10.0);
+        ctx.run("NoiseBlanker 24k", [&]() { return nb.process(ctx.size, ctx.in, ctx.cout); });
+    }
+}
+
+// Same work as IQFrontEnd::handler: window, FFT and power spectrum of one FFT frame
+static void benchSpectrum(BenchContext& ctx) {
+    for (int fftSize : { 8192, 65536 }) {
+        std::string name = "FFT+power spectrum " + std::to_string(fftSize);
+        if (!ctx.enabled(name)) { continue; }
+        float* window = buffer::alloc<float>(fftSize);
+        for (int i = 0; i < fftSize; i++) { window[i] = window::nuttall(i, fftSize) * ((i % 2) ? -1.0f : 1.0f); }
+        auto plan = arrays::allocateFFTWPlan(false, fftSize);
+        ctx.run(name, [&]() {
+            volk_32fc_32f_multiply_32fc((lv_32fc_t*)plan->getInput()->data(), (lv_32fc_t*)ctx.in, window, fftSize);
+            arrays::npfftfft(plan->getInput(), plan);
+            volk_32fc_s32f_power_spectrum_32f(ctx.fout, (lv_32fc_t*)plan->getOutput()->data(), fftSize, fftSize);
+            return fftSize;
+        });
+        buffer::free(window);
+    }
+
+    // Waterfall zoom of a 65536 bin line to a typical display width
+    if (ctx.enabled("doZoom")) {
+        const int bins = 65536;
+        const int width = 1920;
+        float* line = bench::randomBuffer<float>(bins);
+        float* zoomed = buffer::alloc<float>(width);
+        ctx.run("doZoom 65536->1920", [&]() {
+            doZoom(0, bins, bins, width, line, zoomed);
+            return bins;
+        });
+        ctx.run("doZoom 8192 of 65536->1920", [&]() {
+            doZoom(bins / 2, 8192, bins, width, line, zoomed);
+            return 8192;
+        });
+        ZoomPyramid pyramid;
+        pyramid.init(bins);
+        float* pyr = buffer::alloc<float>(pyramid.size());
+        ctx.run("ZoomPyramid build 65536", [&]() {
+            pyramid.build(line, pyr);
+            return bins;
+        });
+        ctx.run("ZoomPyramid zoom 65536->1920", [&]() {
+            pyramid.zoom(0, bins, width, line, pyr, zoomed);
+            return bins;
+        });
+        buffer::free(pyr);
+        buffer::free(line);
+        buffer::free(zoomed);
+    }
+}
+
+static void benchCompression(BenchContext& ctx) {
+    const std::pair<compression::PCMType, const char*> types[] = {
+        { compression::PCM_TYPE_I8, "I8" },
+        { compression::PCM_TYPE_I16, "I16" },
+        { compression::PCM_TYPE_BFP8, "BFP8" },
+        { compression::PCM_TYPE_F32, "F32" }
+    };
+    for (auto& [type, typeName] : types) {
+        std::string name = std::string("SampleStreamCompressor ") + typeName;
+        if (!ctx.enabled(name)) { continue; }
+        ctx.run(name, [&, type = type]() {
+            compression::SampleStreamCompressor::process(ctx.size, type, ctx.in, ctx.bout);
+            return ctx.size;
+        });
+    }
+}
+
+// Per FFT frame element wise chains, allocating numpy style calls against the fused expressions
+static void benchArrays(BenchContext& ctx) {
+    const int frame = 2048;
+    auto a = arrays::npzeros(frame);
+    auto b = arrays::npzeros(frame);
+    auto c = arrays::npzeros(frame);
+    for (int i = 0; i < frame; i++) {
+        (*a)[i] = ctx.in[i].re;
+        (*b)[i] = ctx.in[i].im;
+        (*c)[i] = 0.5f + fabsf(ctx.in[i + frame].re);
+    }
+    std::vector<float> out(frame);
+    std::vector<float> gammak(frame);
+    std::vector<float> ksi(frame);
+
+    if (ctx.enabled("arrays npexp(mul(addeach))")) {
+        ctx.run("arrays npexp(mul(addeach)) 2048", [&]() {
+            auto r = arrays::npexp(arrays::mul(arrays::addeach(a, b), 0.5f));
+            return frame;
+        });
+        ctx.run("arrays npexp(mul(addeach)) 2048 (fused)", [&]() {
+            arrays::expr::assign(out, arrays::expr::npexpfast((arrays::expr::view(a) + b) * 0.5f));
+            return frame;
+        });
+    }
+
+    // LogMMSE gain chain without the exponential integral
+    if (ctx.enabled("arrays gain")) {
+        ctx.run("arrays gain 2048", [&]() {
+            auto gammak = arrays::npminimum_(arrays::diveach(arrays::muleach(a, a), c), 40);
+            auto ksi = arrays::add(arrays::mul(arrays::npmaximum_(arrays::add(gammak, -1), 0), 0.02f), 0.98f);
+            auto A = arrays::diveach(ksi, arrays::add(ksi, 1));
+            auto r = arrays::muleach(A, gammak);
+            return frame;
+        });
+        ctx.run("arrays gain 2048 (fused)", [&]() {
+            using namespace arrays::expr;
+            assign(gammak, npminimum(square(view(a)) / c, 40));
+            assign(ksi, npmaximum(view(gammak) - 1, 0) * 0.02f + 0.98f);
+            assign(out, view(ksi) / (view(ksi) + 1) * gammak);
+            return frame;
+        });
+    }
+}
+
+// One 50 ms slice per call at 2 MS/s, against the original dsp::arrays implementation
+static void benchFFTCompressor(BenchContext& ctx) {
+    if (!ctx.enabled("ExperimentalFFTCompressor")) { return; }
+    const int sampleRate = 2000000;
+    compression::ExperimentalFFTCompressor comp;
+    bench::ReferenceFFTCompressor ref;
+    comp.setSampleRate(sampleRate);
+    ref.setSampleRate(sampleRate);
+    int slice = comp.fftSize;
+
+    // Noise with a few carriers so both the noise floor and the signal mask have work to do
+    const int slices = 4;
+    complex_t* iq = bench::randomBuffer<complex_t>(slice * slices);
+    for (int i = 0; i < slice * slices; i++) {
+        iq[i] *= 0.01f;
+        for (double freq : { -310e3, 25e3, 480e3 }) {
+            double phase = 2.0 * M_PI * freq * (double)i / (double)sampleRate;
+            iq[i] += complex_t{ (float)cos(phase), (float)sin(phase) } * 0.2f;
+        }
+    }
+
+    // Both must produce the same output before their speed can be compared
+    int compared = 0;
+    int mismatches = 0;
+    for (int n = 0; n < 3 * comp.minRecents; n++) {
+        complex_t* data = &iq[(n % slices) * slice];
+        comp.inputBuffer.insert(comp.inputBuffer.end(), data, data + slice);
+        ref.inputBuffer.insert(ref.inputBuffer.end(), data, data + slice);
+        int count = comp.process();
+        if (ref.process() != count) {
+            mismatches++;
+        }
+        else if (count) {
+            compared++;
+            if (memcmp(comp.out.writeBuf, ref.out.writeBuf, count * sizeof(complex_t))) { mismatches++; }
+        }
+    }
+    if (mismatches) {
+        printf("ExperimentalFFTCompressor: %d of %d slices differ from the reference\n", mismatches, compared);
+    }
+
+    int n = 0;
+    ctx.run("ExperimentalFFTCompressor 2M (reference)", [&]() {
+        complex_t* data = &iq[(n++ % slices) * slice];
+        ref.inputBuffer.insert(ref.inputBuffer.end(), data, data + slice);
+        ref.process();
+        return slice;
+    });
+    ctx.run("ExperimentalFFTCompressor 2M", [&]() {
+        complex_t* data = &iq[(n++ % slices) * slice];
+        comp.inputBuffer.insert(comp.inputBuffer.end(), data, data + slice);
+        comp.process();
+        return slice;
+    });
+    buffer::free(iq);
+}
+
+// Noise with keyed carriers, so the noise profile has both quiet and busy frames to follow
+static std::vector<complex_t> logmmseSignal(int count) {
+    std::vector<complex_t> sig(count);
+    complex_t* noise = bench::randomBuffer<complex_t>(count, 7);
+    for (int i = 0; i < count; i++) {
+        sig[i] = noise[i] * 0.05f;
+        int keyed = (i / 4096) % 3;
+        for (double freq : { 0.07, -0.21, 0.33 }) {
+            if (keyed-- == 0) { continue; }
+            double phase = 2.0 * M_PI * freq * (double)i;
+            sig[i] += complex_t{ (float)cos(phase), (float)sin(phase) } * 0.1f;
+        }
+    }
+    buffer::free(noise);
+    return sig;
+}
+
+// 16 bit mono (real) or stereo (IQ) WAV, looped by the reader if shorter than the requested duration
+static bool logmmseWav(const std::string& path, double seconds, std::vector<complex_t>& sig, int& sampleRate) {
+    wav::Reader reader(path);
+    if (!reader.isValid() || reader.getBitDepth() != 16 || reader.getChannelCount() < 1 || reader.getChannelCount() > 2) {
+        printf("LogMMSE: %s is not a 16 bit mono or stereo WAV file\n", path.c_str());
+        return false;
+    }
+    sampleRate = reader.getSampleRate();
+    int channels = reader.getChannelCount();
+    int count = sampleRate * seconds;
+    std::vector<int16_t> raw(count * channels);
+    reader.readSamples(raw.data(), raw.size() * sizeof(int16_t));
+    reader.close();
+    sig.resize(count);
+    for (int i = 0; i < count; i++) {
+        sig[i].re = raw[i * channels] / 32768.0f;
+        sig[i].im = (channels == 2) ? raw[i * channels + 1] / 32768.0f : 0.0f;
+    }
+    return true;
+}
+
+// Same input and block sizes through the original dsp::arrays LogMMSE and LogMMSEEngine, the way
+// AFNRLogMMSE (audio) and IFNRLogMMSE (wideband) drive them
+static void benchLogMMSECase(BenchContext& ctx, const std::string& name, const std::vector<complex_t>& sig, int sampleRate, bool wideband) {
+    using namespace logmmse;
+    const int noiseFrames = 12;
+    const int block = sampleRate / 10;
+    const int demand = LogMMSEEngine::sampleDemand(sampleRate, noiseFrames);
+    int total = sig.size();
+
+    LogMMSE::SavedParamsC params;
+    LogMMSEEngine engine;
+    params.forceAudio = engine.forceAudio = !wideband;
+    params.forceWideband = engine.forceWideband = wideband;
+
+    auto refWorker = arrays::npzeros_c(0);
+    std::vector<complex_t> worker;
+    std::vector<complex_t> engineOut(sampleRate);
+    int refOffset = 0;
+    int engineOffset = 0;
+
+    auto refStep = [&](std::vector<complex_t>* collect) {
+        int n = std::min<int>(block, total - refOffset);
+        refWorker->insert(refWorker->end(), &sig[refOffset], &sig[refOffset] + n);
+        refOffset = (refOffset + n) % total;
+        if (!params.noise_mu2) {
+            if (refWorker->size() < demand) { return n; }
+            LogMMSE::logmmse_sample(refWorker, sampleRate, 0.15f, &params, noiseFrames);
+        }
+        auto rv = LogMMSE::logmmse_all(refWorker, sampleRate, 0.15f, &params);
+        refWorker->erase(refWorker->begin(), refWorker->begin() + rv->size());
+        if (collect) { collect->insert(collect->end(), rv->begin(), rv->end()); }
+        return n;
+    };
+    auto engineStep = [&](std::vector<complex_t>* collect) {
+        int n = std::min<int>(block, total - engineOffset);
+        worker.insert(worker.end(), &sig[engineOffset], &sig[engineOffset] + n);
+        engineOffset = (engineOffset + n) % total;
+        if (!engine.isSampled()) {
+            if (worker.size() < demand) { return n; }
+            engine.sample(worker.data(), sampleRate, noiseFrames);
+        }
+        int produced = engine.process(worker.data(), worker.size(), engineOut.data());
+        worker.erase(worker.begin(), worker.begin() + produced);
+        if (collect) { collect->insert(collect->end(), engineOut.begin(), engineOut.begin() + produced); }
+        return n;
+    };
+
+    // The engine trades the exponential integral table for polynomials, so outputs are compared by error power
+    std::vector<complex_t> refOut;
+    std::vector<complex_t> newOut;
+    for (int done = 0; done < total; done += block) {
+        refStep(&refOut);
+        engineStep(&newOut);
+    }
+    double signalPower = 0;
+    double errorPower = 0;
+    int compared = std::min<int>(refOut.size(), newOut.size());
+    for (int i = 0; i < compared; i++) {
+        signalPower += refOut[i].re * refOut[i].re + refOut[i].im * refOut[i].im;
+        complex_t d = refOut[i] - newOut[i];
+        errorPower += d.re * d.re + d.im * d.im;
+    }
+    double errorDb = 10.0 * log10((errorPower + 1e-30) / (signalPower + 1e-30));
+    bool ok = (refOut.size() == newOut.size()) && (errorDb <= LogMMSEEngine::REFERENCE_TOLERANCE_DB);
+    printf("%s: %d samples, error %.1f dB relative to the reference (limit %.1f dB)%s\n", name.c_str(), compared, errorDb,
+           LogMMSEEngine::REFERENCE_TOLERANCE_DB, ok ? "" : ", MISMATCH");
+
+    ctx.run(name + " (reference)", [&]() { return refStep(NULL); });
+    ctx.run(name, [&]() { return engineStep(NULL); });
+}
+
+static void benchLogMMSE(BenchContext& ctx) {
+    if (!ctx.enabled("LogMMSE")) { return; }
+    if (!ctx.wavPath.empty()) {
+        std::vector<complex_t> sig;
+        int sampleRate;
+        if (logmmseWav(ctx.wavPath, 10.0, sig, sampleRate)) {
+            benchLogMMSECase(ctx, "LogMMSE " + ctx.wavPath, sig, sampleRate, sampleRate > 24000);
+        }
+        return;
+    }
+    benchLogMMSECase(ctx, "LogMMSE audio 24k", logmmseSignal(24000 * 10), 24000, false);
+    benchLogMMSECase(ctx, "LogMMSE wideband 192k", logmmseSignal(192000 * 3), 192000, true);
+}
+
+int main(int argc, char* argv[]) {
+    BenchContext ctx;
+    ctx.size = 65536;
+    ctx.durationMs = 500;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+            ctx.size = std::max<int>(atoi(argv[++i]), 1);
+        }
+        else if (!strcmp(argv[i], "--duration") && i + 1 < argc) {
+            ctx.durationMs = std::max<int>(atoi(argv[++i]), 1);
+        }
+        else if (!strcmp(argv[i], "--wav") && i + 1 < argc) {
+            ctx.wavPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")) {
+            printf("Usage: %s [--size <samples>] [--duration <ms>] [--wav <LogMMSE input>] [filter]\n", argv[0]);
+            return 0;
+        }
+        else {
+            ctx.filter = argv[i];
+        }
+    }
+
+    // Outputs are sized for the worst case expansion (3/2 resampler, compressor header)
+    ctx.in = bench::randomBuffer<complex_t>(std::max<int>(ctx.size, 65536));
+    ctx.cout = buffer::alloc<complex_t>(2 * ctx.size + 64);
+    ctx.fout = buffer::alloc<float>(std::max<int>(2 * ctx.size, 65536));
+    ctx.bout = buffer::alloc<uint8_t>(ctx.size * sizeof(complex_t) + 64);
+
+    printf("Block size: %d samples, %d ms per kernel\n", ctx.size, ctx.durationMs);
+    benchFilters(ctx);
+    benchMultirate(ctx);
+    benchChannel(ctx);
+    benchDemods(ctx);
+    benchSpectrum(ctx);
+    benchArrays(ctx);
+    benchCompression(ctx);
+    benchFFTCompressor(ctx);
+    benchLogMMSE(ctx);
+
+    buffer::free(ctx.in);
+    buffer::free(ctx.cout);
+    buffer::free(ctx.fout);
+    buffer::free(ctx.bout);
+    return 0;
+}
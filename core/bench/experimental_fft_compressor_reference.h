@@ -0,0 +1,196 @@
+#pragma once
+// The original dsp::arrays based ExperimentalFFTCompressor::process(), kept in the benchmark as the
+// baseline the preallocated version is timed against and must match sample for sample.
+#include <dsp/compression/experimental_fft_compressor.h>
+
+namespace dsp::bench {
+    using namespace ::dsp::arrays;
+
+    class ReferenceFFTCompressor : public Processor<complex_t, complex_t> {
+    public:
+        int sampleRate = 0;
+        int sliceMsec = 50;
+        int fftSize = 1024;
+        double lossRate = 1.0;
+        bool txMode = false;
+
+        Arg<FFTPlan> fftPlan;
+        std::shared_ptr<std::vector<complex_t>> inArray;
+        std::vector<float> fftWindow;
+
+        std::vector<complex_t> inputBuffer;
+
+        const int minRecents = 10;
+        std::vector<ComplexArray> cleanFreqDomain;
+        std::vector<FloatArray> cleanMagnitudes;
+        std::vector<FloatArray> windowedMagnitudes;
+
+        float hzTick;
+        int smallTick;
+        int largeTick;
+        int signalWidth = 300;
+
+        std::vector<int32_t> maskedFrequencies;
+
+        const int noiseNPoints = 16;
+        std::vector<float> noiseFigure;
+        float prevAllowance = 0;
+
+        void setSampleRate(int sampleRate) {
+            this->sampleRate = sampleRate;
+            fftSize = sampleRate * sliceMsec / 1000;
+            fftSize = pow(2, floor(log2(fftSize)));
+            fftPlan = allocateFFTWPlan(false, fftSize);
+            inArray = std::make_shared<std::vector<dsp::complex_t>>(fftSize);
+
+            fftWindow.resize(fftSize);
+            for (int i = 0; i < fftSize; i++) { fftWindow[i] = compression::blackmanWindowElement(i+5, fftSize+10); }
+
+            hzTick = ((float) sampleRate) / fftSize;
+            smallTick = signalWidth / hzTick;
+            largeTick = smallTick * 10;
+        }
+
+        FloatArray filterSignal(FloatArray windowedMags, FloatArray clearMags, dsp::complex_t *unfiltered) {
+            auto mvar = dsp::arrays::movingVariance(windowedMags, noiseNPoints);
+            auto newAllowance = lossRate * percentile::percentile_sampling(*clone(mvar), .15);
+            auto allowance = newAllowance * 0.1 + prevAllowance * 0.9;
+            prevAllowance = allowance;
+
+            auto cma = centeredSma(windowedMags, largeTick);
+            for (int i = 0; i < fftSize; i++) {
+                if (mvar->at(i) > allowance) {
+                    cma->at(i) = 0;
+                }
+            }
+            dsp::math::linearInterpolateHoles(cma->data(), cma->size());
+
+            cma = centeredSma(cma, largeTick);
+            auto cmax = centeredSma(cma, 5*largeTick);
+            auto diff = subeach(cma, cmax);
+            for (int i = 0; i < fftSize; i++) {
+                diff->at(i) = fabs(diff->at(i));
+            }
+            auto cmaxAllow = percentile::percentile_sampling(*clone(diff), .15);
+            for (int i = 0; i < fftSize; i++) {
+                if (diff->at(i)  > cmaxAllow) {
+                    cma->at(i) = 0;
+                }
+            }
+            dsp::math::linearInterpolateHoles(cma->data(), cma->size());
+            cma = centeredSma(cma, largeTick);
+
+            auto mask = npzeros(fftSize);
+            if (!txMode) {
+                for (int i = 0; i < fftSize; i++) {
+                    if (clearMags->at(i) > cma->at(i) + allowance) {
+                        mask->at(i) = 1;
+                    }
+                }
+            }
+            for(int i=0; i<maskedFrequencies.size(); i+=2) {
+                int from = maskedFrequencies[i+0];
+                int to = maskedFrequencies[i+1];
+                int tickFrom = fftSize/2 + from / hzTick;
+                int tickTo = fftSize/2 + to / hzTick;
+                for (int j = tickFrom; j < tickTo; j++) {
+                    if (j >= 0 && j < fftSize) {
+                        mask->at(j) = 1;
+                    }
+                }
+            }
+            mask = centeredSma(mask, signalWidth / 8);
+            for (int i = 0; i < fftSize; i++) {
+                if (mask->at(i) == 0) {
+                    unfiltered[i] = {0, 0};
+                }
+            }
+            return cma;
+        }
+
+        std::vector<float> estimateNoise(FloatArray noiseFloor) {
+            int nslices = 30;
+            int slice = fftSize / nslices;
+            auto rv = std::vector<float>(nslices);
+            for(int i=0; i<nslices; i++) {
+                rv[i] = 7 + noiseFloor->at(i * slice + slice/2);
+            }
+            return rv;
+        }
+
+        int process() {
+            if (inputBuffer.size() < fftSize) {
+                return 0;
+            }
+
+            inArray->clear();
+            inArray->insert(inArray->begin(), inputBuffer.begin(), inputBuffer.begin() + fftSize);
+            inputBuffer.erase(inputBuffer.begin(), inputBuffer.begin() + fftSize);
+            auto out = fftPlan->npfftfft(inArray);
+            swapfft(out);
+            cleanFreqDomain.emplace_back(clone(out));
+
+            auto spectrumOut = npzeros(fftSize);
+            volk_32fc_s32f_power_spectrum_32f(spectrumOut->data(), (const lv_32fc_t *) out->data(), fftSize, fftSize);
+            if (!txMode) {
+                cleanMagnitudes.emplace_back(spectrumOut);
+            }
+
+            volk_32fc_32f_multiply_32fc((lv_32fc_t*)inArray->data(), (lv_32fc_t*)inArray->data(), fftWindow.data(), fftSize);
+            out = fftPlan->npfftfft(inArray);
+            swapfft(out);
+            auto windowedSpectrumOut = npzeros(fftSize);
+            volk_32fc_s32f_power_spectrum_32f(windowedSpectrumOut->data(), (const lv_32fc_t *) out->data(), fftSize, fftSize);
+            if (!txMode) {
+                windowedMagnitudes.emplace_back(windowedSpectrumOut);
+            }
+
+            if (cleanFreqDomain.size() < minRecents) {
+                return 0;
+            }
+
+            std::copy(cleanFreqDomain[0]->begin(), cleanFreqDomain[0]->end(), this->out.writeBuf);
+
+            auto windowedSpectrum = npzeros(fftSize);
+            for (int r = 0; r < windowedMagnitudes.size(); r++) {
+                windowedSpectrum = addeach(windowedSpectrum, windowedMagnitudes[r]);
+            }
+            windowedSpectrum = div(windowedSpectrum, windowedMagnitudes.size());
+
+            auto clearSpectrum = npzeros(fftSize);
+            for (int r = 0; r < cleanMagnitudes.size(); r++) {
+                clearSpectrum = addeach(clearSpectrum, cleanMagnitudes[r]);
+            }
+            clearSpectrum = div(clearSpectrum, cleanMagnitudes.size());
+
+            std::vector<dsp::complex_t> noise(fftSize, {0, 0});
+
+            if (lossRate > 0) {
+                auto nf = filterSignal(windowedSpectrum, clearSpectrum, this->out.writeBuf);
+                if (!txMode) {
+                    noiseFigure = estimateNoise(nf);
+                }
+            }
+            auto unfiltered = this->out.writeBuf;
+            for(int i=0; i<fftSize; i++) {
+                if (unfiltered[i].re == 0 && unfiltered[i].im == 0) {
+
+                } else {
+                    auto amp = unfiltered[i].amplitude();
+                    auto namp = sqrt(sqrt(amp));
+                    unfiltered[i] *= (namp / amp);
+                }
+            }
+
+            cleanFreqDomain.erase(cleanFreqDomain.begin() + 0);
+            if (cleanMagnitudes.size() > minRecents * 2) {
+                cleanMagnitudes.erase(cleanMagnitudes.begin() + 0);
+                windowedMagnitudes.erase(windowedMagnitudes.begin() + 0);
+            }
+
+            return fftSize;
+        }
+
+        int run() { return -1; }
+    };
+}
@@ -29,7 +29,9 @@ void CommandArgsParser::defineAll() {
         define('x', "temp", "Temp directory, where all temporary files are stored", tempPath);
         define('s', "server", "Run in server mode");
         define('\0', "password", "Protect server mode protocol with password",std::string(""));
+        define('\0', "max-clients", "Maximum number of simultaneous server mode clients", 8);
         define('\0', "autostart", "Automatically start the SDR after loading");
+        define('\0', "bench-fir", "Benchmark direct vs FFT FIR convolution and exit");
 }
 
 int CommandArgsParser::parse(int argc, char* argv[]) {
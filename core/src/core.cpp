@@ -16,6 +16,7 @@
 #include <backend.h>
 #include <iostream>
 #include <gui/menus/display.h>
+#include <dsp/bench/fir_crossover.h>
 
 #ifdef __APPLE__
 #include <sys/wait.h>
@@ -334,6 +335,16 @@ int sdrpp_main(int argc, char* argv[]) {
         return 0;
     }
 
+    // Find the tap count from which FIR filters should use FFT convolution
+    if (core::args["bench-fir"].b()) {
+        auto points = dsp::bench::firCrossover();
+        for (const auto& p : points) {
+            flog::info("{} taps: direct {} MS/s, FFT {} MS/s", p.taps, p.directRate / 1e6, p.fftRate / 1e6);
+        }
+        flog::info("FFT convolution is faster from {} taps (current threshold {})", dsp::bench::firCrossoverTaps(points), dsp::filter::fftConvolutionThreshold);
+        return 0;
+    }
+
 
     bool serverMode = (bool)core::args["server"];
 
@@ -555,6 +566,7 @@ int sdrpp_main(int argc, char* argv[]) {
     defConfig["decimation"] = 1;
     defConfig["iqCorrection"] = false;
     defConfig["invertIQ"] = false;
+    defConfig["vfoChannelizer"] = false;
     defConfig["operatorCallsign"] = "";
     defConfig["operatorLocation"] = "KO80";
 
@@ -578,6 +590,12 @@ int sdrpp_main(int argc, char* argv[]) {
 #endif
     defConfig["transcieverLayout"] = 0;
 
+    // DSP scheduler (0 workers means one per core)
+    defConfig["dspScheduler"]["enabled"] = false;
+    defConfig["dspScheduler"]["workers"] = 0;
+    defConfig["dspScheduler"]["cpuAffinity"] = json::array();
+    defConfig["dspScheduler"]["rtPriority"] = 0;
+
 #if defined(_WIN32)
     defConfig["modulesDirectory"] = "./modules";
     defConfig["resourcesDirectory"] = "./res";
@@ -660,6 +678,17 @@ int sdrpp_main(int argc, char* argv[]) {
     // Load UI scaling
     style::uiScale = core::configManager.conf["uiScale"];
 
+    // Start the DSP scheduler before any block gets started
+    dsp::scheduler::Config schedConfig;
+    json schedConf = core::configManager.conf["dspScheduler"];
+    schedConfig.enabled = schedConf.value("enabled", false);
+    schedConfig.workers = schedConf.value("workers", 0);
+    schedConfig.rtPriority = schedConf.value("rtPriority", 0);
+    if (schedConf.contains("cpuAffinity")) {
+        for (auto& cpu : schedConf["cpuAffinity"]) { schedConfig.cpuAffinity.push_back(cpu); }
+    }
+    dsp::scheduler::configure(schedConfig);
+
     core::configManager.release(true);
 
     if (serverMode) { return server::main(); }
@@ -0,0 +1,72 @@
+#pragma once
+#include <chrono>
+#include <climits>
+#include <vector>
+#include "../filter/fir.h"
+#include "../taps/low_pass.h"
+
+namespace dsp::bench {
+    struct FIRCrossoverPoint {
+        int taps;
+        double directRate; // Samples per second
+        double fftRate;
+    };
+
+    // Throughput of a complex FIR with real taps using the direct and the FFT convolution, doubling the tap count each step
+    inline std::vector<FIRCrossoverPoint> firCrossover(int minTaps = 8, int maxTaps = 4096, int bufferSize = 8192, int durationMs = 200) {
+        std::vector<FIRCrossoverPoint> points;
+        complex_t* in = buffer::alloc<complex_t>(bufferSize);
+        complex_t* out = buffer::alloc<complex_t>(bufferSize);
+        for (int i = 0; i < bufferSize; i++) {
+            in[i].re = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+            in[i].im = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+        }
+
+        auto measure = [=](filter::FIR<complex_t, float>& fir) {
+            long long samples = 0;
+            auto start = std::chrono::steady_clock::now();
+            auto end = start + std::chrono::milliseconds(durationMs);
+            auto now = start;
+            while (now < end) {
+                samples += fir.process(bufferSize, in, out);
+                now = std::chrono::steady_clock::now();
+            }
+            return (double)samples / std::chrono::duration<double>(now - start).count();
+        };
+
+        int oldThreshold = filter::fftConvolutionThreshold;
+        for (int count = minTaps; count <= maxTaps; count *= 2) {
+            tap<float> taps = taps::alloc<float>(count);
+            for (int i = 0; i < count; i++) { taps.taps[i] = 1.0f / (float)count; }
+
+            FIRCrossoverPoint point;
+            point.taps = count;
+
+            filter::fftConvolutionThreshold = INT_MAX;
+            filter::FIR<complex_t, float> direct;
+            direct.init(NULL, taps);
+            point.directRate = measure(direct);
+
+            filter::fftConvolutionThreshold = 0;
+            filter::FIR<complex_t, float> fft;
+            fft.init(NULL, taps);
+            point.fftRate = measure(fft);
+
+            points.push_back(point);
+            taps::free(taps);
+        }
+        filter::fftConvolutionThreshold = oldThreshold;
+
+        buffer::free(in);
+        buffer::free(out);
+        return points;
+    }
+
+    // Smallest measured tap count from which the FFT convolution is faster, or -1 if it never was
+    inline int firCrossoverTaps(const std::vector<FIRCrossoverPoint>& points) {
+        for (const auto& p : points) {
+            if (p.fftRate > p.directRate) { return p.taps; }
+        }
+        return -1;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <string>
+#include <stdlib.h>
+#include "../types.h"
+#include "../buffer/buffer.h"
+
+namespace dsp::bench {
+    struct KernelResult {
+        std::string name;
+        double rate;          // Input samples per second
+        double nsPerSample;
+        long long calls;
+    };
+
+    // Times a kernel called repeatedly on the calling thread, without streams or worker threads.
+    // The kernel processes one block and returns the number of input samples it consumed.
+    inline KernelResult measureKernel(const std::string& name, const std::function<int()>& kernel, int durationMs = 500) {
+        // Warm up caches, plans and lazily allocated buffers
+        for (int i = 0; i < 4; i++) { kernel(); }
+
+        long long samples = 0;
+        long long calls = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto end = start + std::chrono::milliseconds(durationMs);
+        auto now = start;
+        while (now < end) {
+            samples += kernel();
+            calls++;
+            now = std::chrono::steady_clock::now();
+        }
+
+        double seconds = std::chrono::duration<double>(now - start).count();
+        KernelResult res;
+        res.name = name;
+        res.rate = (double)samples / seconds;
+        res.nsPerSample = (samples > 0) ? (seconds * 1e9 / (double)samples) : 0.0;
+        res.calls = calls;
+        return res;
+    }
+
+    // Buffer of uniform noise in [-1, 1], deterministic so runs can be compared
+    template <class T>
+    inline T* randomBuffer(int count, unsigned int seed = 1) {
+        srand(seed);
+        T* buf = buffer::alloc<T>(count);
+        for (int i = 0; i < count; i++) {
+            if constexpr (std::is_same_v<T, complex_t>) {
+                buf[i].re = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+                buf[i].im = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+            }
+            else if constexpr (std::is_same_v<T, stereo_t>) {
+                buf[i].l = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+                buf[i].r = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+            }
+            else {
+                buf[i] = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+            }
+        }
+        return buf;
+    }
+}
@@ -32,6 +32,7 @@ namespace dsp {
                 return;
             }
             running = true;
+            stats::registerBlock(&counters, typeName(), this);
             doStart();
         }
 
@@ -43,6 +44,7 @@ namespace dsp {
             }
             doStop();
             running = false;
+            stats::unregisterBlock(&counters);
         }
 
         void tempStart() {
@@ -65,25 +67,99 @@ namespace dsp {
 
         virtual int run() = 0;
 
+        // Whether run() follows the read/process/flush/swap pattern and can thus be executed as a
+        // task by the pooled scheduler once all inputs are ready and all outputs are writable
+        virtual bool isPoolable() { return false; }
+
+        // Realtime blocks always get a dedicated thread with elevated priority (see scheduler::Config)
+        void setRealtime(bool enabled) {
+            std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+            tempStop();
+            realtime = enabled;
+            tempStart();
+        }
+
+        bool isRunnable() {
+            for (auto& in : inputs) {
+                if (in && !in->isDataReady()) { return false; }
+            }
+            for (auto& out : outputs) {
+                if (!out->canWrite()) { return false; }
+            }
+            return true;
+        }
+
+        // run() with its duration, processed samples and stream waits accounted in the block's counters.
+        // Wait time is charged to the counters of the calling thread, see stats::setCurrentBlock().
+        int measuredRun() {
+            uint64_t waitBefore = counters.inputWaitNs.load(std::memory_order_relaxed) + counters.outputWaitNs.load(std::memory_order_relaxed);
+            uint64_t start = stats::nowNs();
+            int count = run();
+            uint64_t elapsed = stats::nowNs() - start;
+            uint64_t waited = counters.inputWaitNs.load(std::memory_order_relaxed) + counters.outputWaitNs.load(std::memory_order_relaxed) - waitBefore;
+            counters.busyNs.fetch_add((elapsed > waited) ? (elapsed - waited) : 0, std::memory_order_relaxed);
+            counters.runs.fetch_add(1, std::memory_order_relaxed);
+            if (count > 0) { counters.samples.fetch_add(count, std::memory_order_relaxed); }
+            return count;
+        }
+
+        // Scheduler bookkeeping, only touched by dsp::scheduler
+        std::atomic_int schedState = 0;
+
+        stats::BlockCounters counters;
+
     protected:
-        void workerLoop() {
+        friend void scheduler::add(block* blk);
+        friend void scheduler::remove(block* blk);
+
+        // Unqualified class name, template arguments left out
+        std::string typeName() {
             std::string tn = typeid(*this).name();
-            int lastDigit = -1;
-            for(int q=0; q<tn.size(); q++) {
-                if (isdigit(tn[q])) {
-                    lastDigit = q;
+            // Itanium mangling: a nested name is N<len><id>...<len><id>[I<args>]E
+            if (!tn.empty() && (tn[0] == 'N' || isdigit(tn[0]))) {
+                std::string last;
+                size_t pos = (tn[0] == 'N') ? 1 : 0;
+                while (pos < tn.size() && isdigit(tn[pos])) {
+                    size_t len = 0;
+                    while (pos < tn.size() && isdigit(tn[pos])) { len = len * 10 + (tn[pos++] - '0'); }
+                    last = tn.substr(pos, len);
+                    pos += len;
                 }
+                if (!last.empty()) { return last; }
             }
-            tn = tn.substr(lastDigit+1);
-            SetThreadName("block:" + tn);
-            while (run() >= 0) {}
+            // MSVC: "class ns::Name<args>"
+            size_t end = tn.find('<');
+            if (end == std::string::npos) { end = tn.size(); }
+            size_t begin = tn.rfind(':', end);
+            begin = (begin == std::string::npos) ? tn.rfind(' ', end) : begin;
+            return tn.substr((begin == std::string::npos) ? 0 : begin + 1, end - ((begin == std::string::npos) ? 0 : begin + 1));
+        }
+
+        void workerLoop() {
+            SetThreadName("block:" + typeName());
+            if (realtime) { scheduler::applyRealtimePriority(); }
+            stats::setCurrentBlock(&counters);
+            while (measuredRun() >= 0) {}
+            stats::setCurrentBlock(NULL);
         }
 
         virtual void doStart() {
+            bool hasInput = std::any_of(inputs.begin(), inputs.end(), [](untyped_stream* in) { return in != NULL; });
+            if (!realtime && hasInput && isPoolable() && scheduler::isEnabled()) {
+                pooled = true;
+                scheduler::add(this);
+                return;
+            }
             workerThread = std::thread(&block::workerLoop, this);
         }
 
         virtual void doStop() {
+            if (pooled) {
+                scheduler::remove(this);
+                pooled = false;
+                return;
+            }
+
             for (auto& in : inputs) {
                 if (in) {
                     in->stopReader();
@@ -146,6 +222,8 @@ namespace dsp {
         bool running = false;
         bool tempStopped = false;
         int tempStopDepth = 0;
+        bool realtime = false;
+        bool pooled = false;
         std::thread workerThread;
     };
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+#include <algorithm>
+#include "buffer.h"
+
+namespace dsp::buffer {
+    // Delay line for filters that read sliding windows of `taps` samples.
+    //
+    // A filter sees its input as the last taps - 1 samples of the previous block followed by the
+    // new block. Windows entirely inside the new block are read straight from the input buffer,
+    // only those straddling both come from a seam buffer joining the history with the start of
+    // the block. Per block that's a copy of at most 2 * (taps - 1) samples instead of copying the
+    // whole block in and moving the history back, and the memory needed is 2 * (taps - 1) samples.
+    //
+    // If the output overlaps the input (in-place processing), the output would overwrite samples
+    // that later windows still need, so the block is copied first.
+    template <class T>
+    class DelayLine {
+    public:
+        DelayLine() {}
+
+        ~DelayLine() {
+            if (seam) { buffer::free(seam); }
+            if (copy) { buffer::free(copy); }
+        }
+
+        // Changing the tap count keeps the most recent history, a longer history is zero-filled in front
+        void setTapCount(int taps) {
+            int newHist = std::max<int>(taps - 1, 0);
+            T* newSeam = buffer::alloc<T>(2 * newHist + 1);
+            buffer::clear(newSeam, newHist);
+            if (seam) {
+                int keep = std::min<int>(newHist, hist);
+                memcpy(&newSeam[newHist - keep], &seam[hist - keep], keep * sizeof(T));
+                buffer::free(seam);
+            }
+            seam = newSeam;
+            hist = newHist;
+        }
+
+        void clear() {
+            buffer::clear(seam, hist);
+        }
+
+        // The taps - 1 samples preceding the next block
+        T* history() { return seam; }
+        int historySize() { return hist; }
+
+        // Start a block, `out` and `outCount` describe the output area written while the block is processed
+        inline void begin(const T* in, int count, const void* out, int outCount) {
+            const char* inStart = (const char*)in;
+            const char* outStart = (const char*)out;
+            if (outStart < inStart + count * sizeof(T) && inStart < outStart + (size_t)outCount * sizeof(T)) {
+                if (count > copyCapacity) {
+                    if (copy) { buffer::free(copy); }
+                    copy = buffer::alloc<T>(count);
+                    copyCapacity = count;
+                }
+                memcpy(copy, in, count * sizeof(T));
+                in = copy;
+            }
+
+            _in = in;
+            _count = count;
+            memcpy(&seam[hist], in, std::min<int>(count, hist) * sizeof(T));
+        }
+
+        // Window starting at sample i of the history followed by the block, valid for 0 <= i < count
+        inline const T* window(int i) {
+            return (i >= hist) ? &_in[i - hist] : &seam[i];
+        }
+
+        // Finish the block, its tail becomes the history
+        inline void end() {
+            if (_count >= hist) {
+                memcpy(seam, &_in[_count - hist], hist * sizeof(T));
+            }
+            else {
+                // The block was already appended to the history by begin()
+                memmove(seam, &seam[_count], hist * sizeof(T));
+            }
+        }
+
+    private:
+        T* seam = NULL;
+        int hist = 0;
+
+        T* copy = NULL;
+        int copyCapacity = 0;
+
+        const T* _in = NULL;
+        int _count = 0;
+    };
+}
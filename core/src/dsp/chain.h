@@ -1,7 +1,9 @@
 #pragma once
 #include <vector>
 #include <map>
+#include <memory>
 #include "processor.h"
+#include "fused_executor.h"
 
 namespace dsp {
     template<class T>
@@ -14,19 +16,33 @@ namespace dsp {
         void init(stream<T>* in) {
             _in = in;
             out = _in;
+            threadedOut = _in;
         }
 
         template<typename Func>
         void setInput(stream<T>* in, Func onOutputChange) {
             _in = in;
+            if (executor) { executor->setInput(_in); }
             for (auto& ln : links) {
                 if (states[ln]) {
                     ln->setInput(_in);
                     return;
                 }
             }
-            out = _in;
-            onOutputChange(out);
+            setThreadedOutput(_in, onOutputChange);
+        }
+
+        // When fused, the enabled blocks are run inline on a single thread by a FusedExecutor instead
+        // of one thread per block. This only takes effect while every enabled block is fusable,
+        // otherwise the chain transparently falls back to running the blocks on their own threads.
+        template<typename Func>
+        void setFused(bool enabled, Func onOutputChange) {
+            fuseRequested = enabled;
+            updateFusion(onOutputChange);
+        }
+
+        bool isFused() {
+            return fused;
         }
         
         void addBlock(Processor<T, T>* block, bool enabled) {
@@ -77,16 +93,17 @@ namespace dsp {
                 after->setInput(&block->out);
             }
             else {
-                out = &block->out;
-                onOutputChange(out);
+                setThreadedOutput(&block->out, onOutputChange);
             }
 
             // Set input of the new block
             block->setInput(before ? &before->out : _in);
 
             // Start new block
-            if (running) { block->start(); }
+            if (running && !fused) { block->start(); }
             states[block] = true;
+
+            updateFusion(onOutputChange);
         }
 
         template<typename Func>
@@ -112,9 +129,10 @@ namespace dsp {
                 after->setInput(before ? &before->out : _in);
             }
             else {
-                out = before ? &before->out : _in;
-                onOutputChange(out);
+                setThreadedOutput(before ? &before->out : _in, onOutputChange);
             }
+
+            updateFusion(onOutputChange);
         }
 
         template<typename Func>
@@ -143,18 +161,28 @@ namespace dsp {
 
         void start() {
             if (running) { return; }
-            for (auto& ln : links) {
-                if (!states[ln]) { continue; }
-                ln->start();
+            if (fused) {
+                executor->start();
+            }
+            else {
+                for (auto& ln : links) {
+                    if (!states[ln]) { continue; }
+                    ln->start();
+                }
             }
             running = true;
         }
 
         void stop() {
             if (!running) { return; }
-            for (auto& ln : links) {
-                if (!states[ln]) { continue; }
-                ln->stop();
+            if (fused) {
+                executor->stop();
+            }
+            else {
+                for (auto& ln : links) {
+                    if (!states[ln]) { continue; }
+                    ln->stop();
+                }
             }
             running = false;
         }
@@ -162,6 +190,53 @@ namespace dsp {
         stream<T>* out;
 
     private:
+        // The blocks are always wired as they would be when threaded, fusing only changes which
+        // thread runs them and which stream is exposed as the output of the chain.
+        template<typename Func>
+        void setThreadedOutput(stream<T>* newOut, Func onOutputChange) {
+            threadedOut = newOut;
+            if (fused) { return; }
+            out = threadedOut;
+            onOutputChange(out);
+        }
+
+        template<typename Func>
+        void updateFusion(Func onOutputChange) {
+            std::vector<Processor<T, T>*> enabled;
+            for (auto& ln : links) {
+                if (states[ln]) { enabled.push_back(ln); }
+            }
+            bool fuse = fuseRequested && FusedExecutor<T>::canFuse(enabled);
+
+            if (fuse && fused) {
+                executor->setLinks(enabled);
+                return;
+            }
+            if (fuse == fused) { return; }
+
+            if (fuse) {
+                // Allocated on first use since most chains never get fused
+                if (!executor) { executor = std::make_unique<FusedExecutor<T>>(_in); }
+                if (running) {
+                    for (auto& ln : enabled) { ln->stop(); }
+                }
+                executor->setInput(_in);
+                executor->setLinks(enabled);
+                if (running) { executor->start(); }
+                fused = true;
+                out = &executor->out;
+            }
+            else {
+                if (running) {
+                    executor->stop();
+                    for (auto& ln : enabled) { ln->start(); }
+                }
+                fused = false;
+                out = threadedOut;
+            }
+            onOutputChange(out);
+        }
+
         Processor<T, T>* blockBefore(Processor<T, T>* block) {
             // TODO: This is wrong and must be fixed when I get more time
             for (auto& ln : links) {
@@ -188,8 +263,13 @@ namespace dsp {
         }
 
         stream<T>* _in;
+        stream<T>* threadedOut;
         std::vector<Processor<T, T>*> links;
         std::map<Processor<T, T>*, bool> states;
         bool running = false;
+
+        bool fuseRequested = false;
+        bool fused = false;
+        std::unique_ptr<FusedExecutor<T>> executor;
     };
 }
\ No newline at end of file
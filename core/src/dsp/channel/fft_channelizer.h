@@ -0,0 +1,364 @@
+#pragma once
+#include <map>
+#include <vector>
+#include <fftw3.h>
+#include "../sink.h"
+#include "../taps/low_pass.h"
+#include "../taps/estimate_tap_count.h"
+
+namespace dsp::channel {
+    // Overlap-save FFT filterbank channelizer.
+    //
+    // Runs one forward FFT per block of the full rate input and derives every channel from it: the bins
+    // around the channel center are weighted by the response of a shared anti-aliasing filter and brought
+    // back to the time domain with a small inverse FFT, which translates, filters and decimates in one step.
+    // Channel centers are quantized to the bin spacing, the residual offset is left to the consumer.
+    // Unless given a fixed size, the FFT follows the samplerate so a block stays around 20ms of input.
+    class FFTChannelizer : public Sink<complex_t> {
+        using base_type = Sink<complex_t>;
+    public:
+        class Channel {
+        public:
+            Channel(FFTChannelizer* owner) : owner(owner) {}
+
+            // Returns the residual offset that was not covered by the bin quantization
+            double setOffset(double offset) { return owner->setChannelOffset(this, offset); }
+
+            // Picks the highest decimation still giving at least this samplerate, returns the channel samplerate
+            double setMinSamplerate(double samplerate) { return owner->setChannelMinSamplerate(this, samplerate); }
+
+            double getSamplerate() { return owner->_samplerate / (double)decim; }
+
+            double getResidualOffset() { return offset - ((double)bin * owner->_samplerate / (double)owner->_fftSize); }
+
+            stream<complex_t> out;
+
+        private:
+            friend FFTChannelizer;
+            FFTChannelizer* owner;
+            double offset = 0.0;
+            double minSamplerate = 0.0;
+            int bin = 0;
+            int decim = 1;
+            int outCount = 0;
+            int blockQuarterTurns = 0;
+        };
+
+        FFTChannelizer() {}
+
+        FFTChannelizer(stream<complex_t>* in, double samplerate, int fftSize = 0) { init(in, samplerate, fftSize); }
+
+        ~FFTChannelizer() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            for (auto& ch : channels) { delete ch; }
+            channels.clear();
+            for (auto& [decim, bank] : banks) { freeBank(bank); }
+            banks.clear();
+            freeFFT();
+        }
+
+        // A zero fftSize picks one from the samplerate, see fftSizeFor()
+        void init(stream<complex_t>* in, double samplerate, int fftSize = 0) {
+            _samplerate = samplerate;
+            _fixedFFTSize = fftSize;
+            allocateFFT(fftSize ? fftSize : fftSizeFor(samplerate));
+            base_type::init(in);
+        }
+
+        void setInSamplerate(double samplerate) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            {
+                std::lock_guard<std::mutex> lck2(chanMtx);
+                _samplerate = samplerate;
+
+                // The filters depend on the samplerate, redesign all of them
+                for (auto& [decim, bank] : banks) { freeBank(bank); }
+                banks.clear();
+                int fftSize = _fixedFFTSize ? _fixedFFTSize : fftSizeFor(samplerate);
+                if (fftSize != _fftSize) {
+                    freeFFT();
+                    allocateFFT(fftSize);
+                }
+                for (auto& ch : channels) {
+                    ch->decim = pickDecimation(ch->minSamplerate);
+                    acquireBank(ch->decim);
+                    updateBin(ch);
+                }
+                buffer::clear(fftIn, _fftSize);
+                fill = 0;
+            }
+            base_type::tempStart();
+        }
+
+        Channel* addChannel(double offset, double minSamplerate) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            Channel* ch = new Channel(this);
+            ch->offset = offset;
+            ch->minSamplerate = minSamplerate;
+            ch->decim = pickDecimation(minSamplerate);
+            acquireBank(ch->decim);
+            updateBin(ch);
+            channels.push_back(ch);
+            base_type::registerOutput(&ch->out);
+            base_type::tempStart();
+            return ch;
+        }
+
+        void removeChannel(Channel* ch) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            auto it = std::find(channels.begin(), channels.end(), ch);
+            if (it == channels.end()) {
+                throw std::runtime_error("[FFTChannelizer] Tried to remove a channel that doesn't exist");
+            }
+            base_type::tempStop();
+            channels.erase(it);
+            base_type::unregisterOutput(&ch->out);
+            releaseBank(ch->decim);
+            delete ch;
+            base_type::tempStart();
+        }
+
+        int getFFTSize() { return _fftSize; }
+
+        int getMaxDecimation() { return _fftSize / DECIM_TO_FFT_RATIO; }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            const complex_t* in = base_type::_in->readBuf;
+            int i = 0;
+            while (i < count) {
+                {
+                    std::lock_guard<std::mutex> lck(chanMtx);
+                    for (auto& ch : channels) { ch->outCount = 0; }
+
+                    // Fill blocks of new samples after the overlap, process each complete one
+                    while (i < count) {
+                        int n = std::min<int>(_blockSize - fill, count - i);
+                        memcpy(&fftIn[_overlap + fill], &in[i], n * sizeof(complex_t));
+                        fill += n;
+                        i += n;
+                        if (fill < _blockSize) { break; }
+                        processBlock();
+                        memmove(fftIn, &fftIn[_blockSize], _overlap * sizeof(complex_t));
+                        fill = 0;
+
+                        // Undecimated channels get a whole block out per block in, swap before one more could overflow them
+                        if (!outputRoom()) { break; }
+                    }
+                }
+
+                for (auto& ch : channels) {
+                    if (!ch->outCount) { continue; }
+                    if (!ch->out.swap(ch->outCount)) { return -1; }
+                }
+            }
+
+            base_type::_in->flush();
+            return count;
+        }
+
+        // Bounds for the samplerate derived FFT size
+        static constexpr int MIN_FFT_SIZE = 4096;
+        static constexpr int MAX_FFT_SIZE = 65536;
+
+    protected:
+        struct Bank {
+            int size;
+            int users;
+            complex_t* in;
+            complex_t* out;
+            complex_t* resp;
+            fftwf_plan plan;
+        };
+
+        // The filter needs about 38 taps per unit of decimation (see taps::estimateTapCount) and
+        // must fit in the overlap of a quarter FFT, so the FFT is 256 times the largest decimation
+        static constexpr int DECIM_TO_FFT_RATIO = 256;
+
+        // Smallest power of two whose block holds 20ms of input, so low input rates don't wait long for a block
+        static int fftSizeFor(double samplerate) {
+            int size = MIN_FFT_SIZE;
+            while (size < MAX_FFT_SIZE && (double)((size / 4) * 3) < samplerate * 0.02) { size *= 2; }
+            return size;
+        }
+
+        void allocateFFT(int fftSize) {
+            _fftSize = fftSize;
+            _blockSize = (_fftSize / 4) * 3;
+            _overlap = _fftSize - _blockSize;
+            fftIn = (complex_t*)fftwf_malloc(_fftSize * sizeof(complex_t));
+            fftOut = (complex_t*)fftwf_malloc(_fftSize * sizeof(complex_t));
+            buffer::clear(fftIn, _fftSize);
+            fwdPlan = fftwf_plan_dft_1d(_fftSize, (fftwf_complex*)fftIn, (fftwf_complex*)fftOut, FFTW_FORWARD, FFTW_ESTIMATE);
+        }
+
+        void freeFFT() {
+            fftwf_destroy_plan(fwdPlan);
+            fftwf_free(fftIn);
+            fftwf_free(fftOut);
+        }
+
+        bool outputRoom() {
+            for (auto& ch : channels) {
+                if (ch->outCount + _blockSize / ch->decim > STREAM_BUFFER_SIZE) { return false; }
+            }
+            return true;
+        }
+
+        // Taps of the anti-aliasing filter for a decimation, they have to fit in the overlap
+        int filterTapCount(int decim) {
+            return taps::estimateTapCount((_samplerate / (double)decim) * 0.1, _samplerate) + 1;
+        }
+
+        inline void processBlock() {
+            fftwf_execute(fwdPlan);
+
+            for (auto& ch : channels) {
+                Bank& bank = banks[ch->decim];
+                int half = bank.size / 2;
+
+                // Positive then negative frequencies of the channel, weighted by the filter response
+                weightBins(bank.in, ch->bin, half, bank.resp);
+                weightBins(&bank.in[half], ch->bin - half, half, &bank.resp[half]);
+                fftwf_execute(bank.plan);
+
+                // Drop the samples corrupted by circular convolution and correct the phase of the
+                // block, the shift by `bin` bins is a mix that restarts at the beginning of every block
+                int skip = _overlap / ch->decim;
+                int keep = _blockSize / ch->decim;
+                static const lv_32fc_t quarterTurns[4] = { lv_cmake(1.0f, 0.0f), lv_cmake(0.0f, -1.0f), lv_cmake(-1.0f, 0.0f), lv_cmake(0.0f, 1.0f) };
+                volk_32fc_s32fc_multiply_32fc((lv_32fc_t*)&ch->out.writeBuf[ch->outCount], (lv_32fc_t*)&bank.out[skip], quarterTurns[ch->blockQuarterTurns], keep);
+                ch->outCount += keep;
+
+                // Advancing by 3/4 of the FFT mixes the channel by -3/4 of a turn per bin
+                ch->blockQuarterTurns = (ch->blockQuarterTurns + 3 * (ch->bin & 3)) & 3;
+            }
+        }
+
+        inline void weightBins(complex_t* dst, int firstBin, int count, const complex_t* resp) {
+            firstBin = ((firstBin % _fftSize) + _fftSize) % _fftSize;
+            int first = std::min<int>(count, _fftSize - firstBin);
+            volk_32fc_x2_multiply_32fc((lv_32fc_t*)dst, (lv_32fc_t*)&fftOut[firstBin], (lv_32fc_t*)resp, first);
+            if (first < count) {
+                volk_32fc_x2_multiply_32fc((lv_32fc_t*)&dst[first], (lv_32fc_t*)fftOut, (lv_32fc_t*)&resp[first], count - first);
+            }
+        }
+
+        double setChannelOffset(Channel* ch, double offset) {
+            std::lock_guard<std::mutex> lck(chanMtx);
+            ch->offset = offset;
+            updateBin(ch);
+            return ch->getResidualOffset();
+        }
+
+        double setChannelMinSamplerate(Channel* ch, double samplerate) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            ch->minSamplerate = samplerate;
+            int decim = pickDecimation(samplerate);
+            if (decim != ch->decim) {
+                base_type::tempStop();
+                releaseBank(ch->decim);
+                ch->decim = decim;
+                acquireBank(ch->decim);
+                base_type::tempStart();
+            }
+            return ch->getSamplerate();
+        }
+
+        void updateBin(Channel* ch) {
+            ch->bin = (int)round(ch->offset * (double)_fftSize / _samplerate);
+        }
+
+        // Keep the usable passband (80% of the channel rate) above the requested samplerate
+        int pickDecimation(double minSamplerate) {
+            int decim = 1;
+            int maxDecim = getMaxDecimation();
+            while (decim * 2 <= maxDecim && filterTapCount(decim * 2) <= _overlap + 1 && (_samplerate / (double)(decim * 2)) * 0.8 >= minSamplerate) {
+                decim *= 2;
+            }
+            return decim;
+        }
+
+        void acquireBank(int decim) {
+            auto it = banks.find(decim);
+            if (it != banks.end()) {
+                it->second.users++;
+                return;
+            }
+
+            Bank bank;
+            bank.size = _fftSize / decim;
+            bank.users = 1;
+            bank.in = (complex_t*)fftwf_malloc(bank.size * sizeof(complex_t));
+            bank.out = (complex_t*)fftwf_malloc(bank.size * sizeof(complex_t));
+            bank.resp = buffer::alloc<complex_t>(bank.size);
+            bank.plan = fftwf_plan_dft_1d(bank.size, (fftwf_complex*)bank.in, (fftwf_complex*)bank.out, FFTW_BACKWARD, FFTW_ESTIMATE);
+
+            // Anti-aliasing filter that is fully stopped at the edge of the channel
+            double chanRate = _samplerate / (double)decim;
+            tap<float> ftaps = taps::lowPass(chanRate * 0.45, chanRate * 0.1, _samplerate);
+
+            // Full size frequency response, scaled to undo the gain of the unnormalized FFTs
+            complex_t* padded = (complex_t*)fftwf_malloc(_fftSize * sizeof(complex_t));
+            complex_t* resp = (complex_t*)fftwf_malloc(_fftSize * sizeof(complex_t));
+            buffer::clear(padded, _fftSize);
+            assert(ftaps.size <= _overlap + 1);
+            for (int i = 0; i < ftaps.size; i++) {
+                padded[i] = { ftaps.taps[i] / (float)_fftSize, 0.0f };
+            }
+            fftwf_plan plan = fftwf_plan_dft_1d(_fftSize, (fftwf_complex*)padded, (fftwf_complex*)resp, FFTW_FORWARD, FFTW_ESTIMATE);
+            fftwf_execute(plan);
+            fftwf_destroy_plan(plan);
+
+            // Keep the bins around DC in the same order they are gathered in
+            int half = bank.size / 2;
+            for (int i = 0; i < half; i++) {
+                bank.resp[i] = resp[i];
+                bank.resp[half + i] = resp[_fftSize - half + i];
+            }
+
+            fftwf_free(padded);
+            fftwf_free(resp);
+            taps::free(ftaps);
+            banks[decim] = bank;
+        }
+
+        void releaseBank(int decim) {
+            auto it = banks.find(decim);
+            if (it == banks.end() || --it->second.users) { return; }
+            freeBank(it->second);
+            banks.erase(it);
+        }
+
+        void freeBank(Bank& bank) {
+            fftwf_destroy_plan(bank.plan);
+            fftwf_free(bank.in);
+            fftwf_free(bank.out);
+            buffer::free(bank.resp);
+        }
+
+        double _samplerate;
+        int _fixedFFTSize = 0;
+        int _fftSize;
+        int _blockSize;
+        int _overlap;
+        int fill = 0;
+
+        complex_t* fftIn;
+        complex_t* fftOut;
+        fftwf_plan fwdPlan;
+
+        std::vector<Channel*> channels;
+        std::map<int, Bank> banks;
+        std::mutex chanMtx;
+    };
+}
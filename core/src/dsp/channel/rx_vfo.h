@@ -1,6 +1,8 @@
 #pragma once
 #include "frequency_xlator.h"
 #include "../multirate/rational_resampler.h"
+#include "fft_channelizer.h"
+#include "../taps/tap_cache.h"
 
 namespace dsp::channel {
     class RxVFO : public Processor<complex_t, complex_t> {
@@ -37,8 +39,7 @@ namespace dsp::channel {
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
             _inSamplerate = inSamplerate;
-            xlator.setOffset(-_offset, _inSamplerate);
-            resamp.setInSamplerate(_inSamplerate);
+            configureInput();
             base_type::tempStart();
         }
 
@@ -50,6 +51,7 @@ namespace dsp::channel {
             _bandwidth = bandwidth;
             filterNeeded = (_bandwidth != _outSamplerate);
             resamp.setOutSamplerate(_outSamplerate);
+            if (_channel) { configureInput(); }
             if (filterNeeded) {
                 generateTaps();
                 filter.setTaps(ftaps);
@@ -60,11 +62,26 @@ namespace dsp::channel {
         void setBandwidth(double bandwidth) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            std::lock_guard<std::mutex> lck2(filterMtx);
+
+            // A wider bandwidth may need a channel with a lower decimation
+            if (_channel && bandwidth > _bandwidth) {
+                base_type::tempStop();
+                _bandwidth = bandwidth;
+                configureInput();
+                base_type::tempStart();
+            }
+
+            // Design (or fetch) the filter before blocking the DSP thread
             _bandwidth = bandwidth;
-            filterNeeded = (_bandwidth != _outSamplerate);
+            bool needed = (_bandwidth != _outSamplerate);
+            tap<float> newTaps;
+            if (needed) { newTaps = designTaps(); }
+
+            std::lock_guard<std::mutex> lck2(filterMtx);
+            filterNeeded = needed;
             if (filterNeeded) {
-                generateTaps();
+                taps::free(ftaps);
+                ftaps = newTaps;
                 filter.setTaps(ftaps);
             }
         }
@@ -73,9 +90,32 @@ namespace dsp::channel {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             _offset = offset;
+            if (_channel) {
+                // The channel does the coarse shift, only the residual is left to the xlator
+                xlator.setOffset(-_channel->setOffset(_offset), _channel->getSamplerate());
+                return;
+            }
             xlator.setOffset(-_offset, _inSamplerate);
         }
 
+        // Take the input from a channelizer channel (or from the full rate stream if NULL).
+        // The input stream itself must be switched with setInput().
+        void setChannel(FFTChannelizer::Channel* channel) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            _channel = channel;
+            configureInput();
+            base_type::tempStart();
+        }
+
+        FFTChannelizer::Channel* getChannel() { return _channel; }
+
+        double getOffset() { return _offset; }
+
+        // Lowest input samplerate the VFO can work with
+        double getRequiredSamplerate() { return std::max<double>(_outSamplerate, _bandwidth); }
+
         void reset() {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
@@ -114,10 +154,25 @@ namespace dsp::channel {
         }
 
     protected:
+        void configureInput() {
+            if (!_channel) {
+                xlator.setOffset(-_offset, _inSamplerate);
+                resamp.setInSamplerate(_inSamplerate);
+                return;
+            }
+            double chanSamplerate = _channel->setMinSamplerate(getRequiredSamplerate());
+            xlator.setOffset(-_channel->setOffset(_offset), chanSamplerate);
+            resamp.setInSamplerate(chanSamplerate);
+        }
+
+        tap<float> designTaps() {
+            double filterWidth = _bandwidth / 2.0;
+            return taps::cache::lowPass(filterWidth, filterWidth * 0.1, _outSamplerate);
+        }
+
         void generateTaps() {
             taps::free(ftaps);
-            double filterWidth = _bandwidth / 2.0;
-            ftaps = taps::lowPass(filterWidth, filterWidth * 0.1, _outSamplerate);
+            ftaps = designTaps();
         }
 
         FrequencyXlator xlator;
@@ -130,6 +185,7 @@ namespace dsp::channel {
         double _outSamplerate;
         double _bandwidth;
         double _offset;
+        FFTChannelizer::Channel* _channel = NULL;
 
         std::mutex filterMtx;
     };
@@ -29,6 +29,12 @@ namespace dsp::compression {
 
     using namespace ::dsp::arrays;
 
+    // Zeroes the spectrum bins that only carry noise and sends the rest with a compressed amplitude,
+    // one fftSize slice at a time, delayed by minRecents slices so the noise floor can be averaged.
+    //
+    // Everything is allocated in setSampleRate(): the spectra histories are rings of fftSize bins per
+    // slot and the intermediate results live in scratch buffers reused by every slice. The arithmetic
+    // and its order are those of the dsp::arrays based original, so the output is bit identical.
     class ExperimentalFFTCompressor : public Processor<complex_t, complex_t> {
         using base_type = Processor<complex_t, complex_t>;
     public:
@@ -39,15 +45,23 @@ namespace dsp::compression {
         double lossRate = 1.0;
 
         Arg<FFTPlan> fftPlan;
-        std::shared_ptr<std::vector<complex_t>> inArray;
         std::vector<float> fftWindow;
 
         std::vector<complex_t> inputBuffer;
 
         const int minRecents = 10;
-        std::vector<ComplexArray> cleanFreqDomain;
-        std::vector<FloatArray> cleanMagnitudes;
-        std::vector<FloatArray> windowedMagnitudes;
+        const int magnitudeSlots = 2 * minRecents + 1;
+
+        // Unwindowed spectra waiting to be sent, minRecents slots
+        std::vector<complex_t> cleanFreqDomain;
+        int cleanHead = 0;
+        int cleanCount = 0;
+
+        // Power spectra averaged for the noise floor, magnitudeSlots slots each
+        std::vector<float> cleanMagnitudes;
+        std::vector<float> windowedMagnitudes;
+        int magnitudeHead = 0;
+        int magnitudeCount = 0;
 
         float hzTick;
         int smallTick;
@@ -71,15 +85,31 @@ namespace dsp::compression {
                 fftSize = sampleRate * sliceMsec / 1000;
                 fftSize = pow(2, floor(log2(fftSize)));
                 fftPlan = allocateFFTWPlan(false, fftSize);
-                inArray = std::make_shared<std::vector<dsp::complex_t>>(fftSize);
 
                 fftWindow.resize(fftSize);
                 for (int i = 0; i < fftSize; i++) { fftWindow[i] = blackmanWindowElement(i+5, fftSize+10); }
 
-
                 hzTick = ((float) sampleRate) / fftSize;
                 smallTick = signalWidth / hzTick;
                 largeTick = smallTick * 10;
+
+                // Histories of the previous rate can't be averaged with the new slices
+                cleanFreqDomain.assign((size_t)minRecents * fftSize, { 0, 0 });
+                cleanMagnitudes.assign((size_t)magnitudeSlots * fftSize, 0);
+                windowedMagnitudes.assign((size_t)magnitudeSlots * fftSize, 0);
+                cleanHead = cleanCount = 0;
+                magnitudeHead = magnitudeCount = 0;
+
+                windowedSpectrum.assign(fftSize, 0);
+                clearSpectrum.assign(fftSize, 0);
+                mvar.assign(fftSize, 0);
+                noiseFloor.assign(fftSize, 0);
+                mask.assign(fftSize, 0);
+                scratchA.assign(fftSize, 0);
+                scratchB.assign(fftSize, 0);
+                percentileScratch.assign(std::max<int>(fftSize, percentileTargetPoints), 0);
+                inputBuffer.reserve(2 * fftSize);
+
                 sharedDataLock.lock();
                 noiseFigure.clear();
                 sharedDataLock.unlock();
@@ -106,52 +136,97 @@ namespace dsp::compression {
             return enabled;
         }
 
-        int iteration = 0;
-
         const int noiseNPoints = 16;
-        std::vector<float> noiseFigure; // mean, variance, mean, variance, mean, variance..
+        static constexpr int noiseSlices = 30;
+        std::vector<float> noiseFigure; // noise floor in dB at the center of each of the noiseSlices slices
         std::mutex sharedDataLock;
         float prevAllowance = 0;
 
-        // returns noise floor
-        FloatArray filterSignal(FloatArray windowedMags, FloatArray clearMags, dsp::complex_t *unfiltered) {
-            //
-            auto mvar = dsp::arrays::movingVariance(windowedMags, noiseNPoints);
-            auto newAllowance = lossRate * percentile::percentile_sampling(*clone(mvar), .15);
-            auto allowance = newAllowance * 0.1 + prevAllowance * 0.9;
-            prevAllowance = allowance;
+        // Same as arrays::centeredSma(), into a caller provided buffer that must not alias in
+        static void centeredSma(const float* in, int limit, int winsize, float* out) {
+            float total = 0;
+            int win2 = winsize / 2;
+            for (int i = 0; i < winsize; i++) {
+                total += in[i];
+            }
+            for (int i = winsize; i < limit; i++) {
+                out[i - win2] = total / winsize;
+                total += in[i] - in[i - winsize];
+            }
+            for (int i = 0; i < winsize - win2; i++) {
+                out[i] = out[winsize - win2];
+            }
+            for (int i = limit - win2; i < limit; i++) {
+                out[i] = out[limit - win2 - 1];
+            }
+        }
+
+        // Same as percentile::percentile_sampling() on a copy of arr, without allocating the copy
+        float percentileSampling(const float* arr, double p) {
+            int n = fftSize;
+            float* data = percentileScratch.data();
+            if (n > 2 * percentileTargetPoints) {
+                float step = (n - 1) / (float)percentileTargetPoints;
+                for (int z = 0; z < percentileTargetPoints; z++) {
+                    data[z] = arr[(int)std::floor(step * z)];
+                }
+                n = percentileTargetPoints;
+            }
+            else {
+                std::copy(arr, arr + n, data);
+            }
+            double k = (n - 1) * p;
+            return percentile::kthSmallest(data, 0, n - 1, (int)k);
+        }
 
-            auto cma = centeredSma(windowedMags, largeTick);
+        // Zeroes the noise bins of unfiltered and, unless transmitting, leaves the noise floor in noiseFloor
+        void filterSignal(const float* windowedMags, const float* clearMags, dsp::complex_t *unfiltered) {
+            float* a = scratchA.data();
+            float* b = scratchB.data();
 
+            // Moving variance
+            centeredSma(windowedMags, fftSize, noiseNPoints, a);
+            volk_32f_x2_subtract_32f(b, windowedMags, a, fftSize);
+            volk_32f_x2_multiply_32f(b, b, b, fftSize);
+            centeredSma(b, fftSize, noiseNPoints, mvar.data());
 
-            for (int i = 0; i < fftSize; i++) {
-                if (mvar->at(i) > allowance) {
-                    cma->at(i) = 0;
+            auto newAllowance = lossRate * percentileSampling(mvar.data(), .15);
+            auto allowance = newAllowance * 0.1 + prevAllowance * 0.9;
+            prevAllowance = allowance;
+
+            float* nf = noiseFloor.data();
+            float* m = mask.data();
+            std::fill(mask.begin(), mask.end(), 0.0f);
+            if (!txMode) {
+                // The noise floor only picks the signal bins, for tx assume no signals at all
+                centeredSma(windowedMags, fftSize, largeTick, a);
+                for (int i = 0; i < fftSize; i++) {
+                    if (mvar[i] > allowance) {
+                        a[i] = 0;
+                    }
                 }
-            }
-            dsp::math::linearInterpolateHoles(cma->data(), cma->size());
+                dsp::math::linearInterpolateHoles(a, fftSize);
 
-            cma = centeredSma(cma, largeTick);          // cleared noise floor.
-            auto cmax = centeredSma(cma, 5*largeTick);          // cleared noise floor.
-            auto diff = subeach(cma, cmax);
-            for (int i = 0; i < fftSize; i++) {
-                diff->at(i) = fabs(diff->at(i));
-            }
-            auto cmaxAllow = percentile::percentile_sampling(*clone(diff), .15);
-            for (int i = 0; i < fftSize; i++) {
-                if (diff->at(i)  > cmaxAllow) {
-                    cma->at(i) = 0;
+                centeredSma(a, fftSize, largeTick, nf);
+                centeredSma(nf, fftSize, 5*largeTick, b);
+                for (int i = 0; i < fftSize; i++) {
+                    a[i] = fabsf(nf[i] - b[i]);
                 }
-            }
-            dsp::math::linearInterpolateHoles(cma->data(), cma->size());
-            cma = centeredSma(cma, largeTick);          // cleared noise floor.
+                auto cmaxAllow = percentileSampling(a, .15);
+                for (int i = 0; i < fftSize; i++) {
+                    if (a[i] > cmaxAllow) {
+                        nf[i] = 0;
+                    }
+                }
+                dsp::math::linearInterpolateHoles(nf, fftSize);
+                centeredSma(nf, fftSize, largeTick, b);
+                std::swap(noiseFloor, scratchB);
+                nf = noiseFloor.data();
+                b = scratchB.data();
 
-            auto mask = npzeros(fftSize);
-            if (!txMode) {
-                // for rx mode, add good signals to mask, for tx assume no signals at all. Mask will be used to filter signal.
                 for (int i = 0; i < fftSize; i++) {
-                    if (clearMags->at(i) > cma->at(i) + allowance) {     // allowance = normal noise variance
-                        mask->at(i) = 1;
+                    if (clearMags[i] > nf[i] + allowance) {     // allowance = normal noise variance
+                        m[i] = 1;
                     }
                 }
             }
@@ -160,34 +235,27 @@ namespace dsp::compression {
                 int to = maskedFrequencies[i+1];
                 int tickFrom = fftSize/2 + from / hzTick;
                 int tickTo = fftSize/2 + to / hzTick;
-                for (int j = tickFrom; j < tickTo; j++) {
-                    if (j >= 0 && j < fftSize) {
-                        mask->at(j) = 1;
-                    }
+                for (int j = std::max<int>(tickFrom, 0); j < std::min<int>(tickTo, fftSize); j++) {
+                    m[j] = 1;
                 }
             }
-            mask = centeredSma(mask, signalWidth / 8);      // add some around the signal
-            int nfiltered = 0;
+            centeredSma(m, fftSize, signalWidth / 8, b);      // add some around the signal
             for (int i = 0; i < fftSize; i++) {
-                if (mask->at(i) == 0) {
+                if (b[i] == 0) {
                     unfiltered[i] = {0, 0};
-                    nfiltered++;
                 }
             }
-//            flog::info("compressor: filtered {} of {}", nfiltered, fftSize);
-            return cma;
         }
 
-        int zz = 0;
-
-        std::vector<float> estimateNoise(FloatArray noiseFloor) {
-            int nslices = 30;
-            int slice = fftSize / nslices;
-            auto rv = std::vector<float>(nslices);
-            for(int i=0; i<nslices; i++) {
-                rv[i] = 7 + noiseFloor->at(i * slice + slice/2); // 7db is due to averaging, probably
+        void estimateNoise() {
+            int slice = fftSize / noiseSlices;
+            float estimate[noiseSlices];
+            for(int i=0; i<noiseSlices; i++) {
+                estimate[i] = 7 + noiseFloor[i * slice + slice/2]; // 7db is due to averaging, probably
             }
-            return rv;
+            sharedDataLock.lock();
+            noiseFigure.assign(estimate, estimate + noiseSlices);
+            sharedDataLock.unlock();
         }
 
         bool txMode = false;
@@ -201,231 +269,63 @@ namespace dsp::compression {
                 return 0;
             }
 
-            inArray->clear();
-            inArray->insert(inArray->begin(), inputBuffer.begin(), inputBuffer.begin() + fftSize);
-            inputBuffer.erase(inputBuffer.begin(), inputBuffer.begin() + fftSize);
-            auto out = fftPlan->npfftfft(inArray);
-            swapfft(out);
-            cleanFreqDomain.emplace_back(clone(out));
+            auto fftIn = fftPlan->getInput();
+            auto fftOut = fftPlan->getOutput();
 
-            auto spectrumOut = npzeros(fftSize);
-            volk_32fc_s32f_power_spectrum_32f(spectrumOut->data(), (const lv_32fc_t *) out->data(), fftSize, fftSize);
+            std::copy(inputBuffer.begin(), inputBuffer.begin() + fftSize, fftIn->begin());
+            fftPlan->npfftfft(fftIn);
+            swapfft(fftOut);
+            std::copy(fftOut->begin(), fftOut->end(), cleanSlot(cleanCount));
+            cleanCount++;
+
+            float* cleanMags = NULL;
+            float* windowedMags = NULL;
             if (!txMode) {
-                cleanMagnitudes.emplace_back(spectrumOut);
+                if (magnitudeCount == magnitudeSlots) { dropOldestMagnitudes(); }
+                cleanMags = magnitudeSlot(cleanMagnitudes, magnitudeCount);
+                windowedMags = magnitudeSlot(windowedMagnitudes, magnitudeCount);
+                magnitudeCount++;
+                volk_32fc_s32f_power_spectrum_32f(cleanMags, (const lv_32fc_t *) fftOut->data(), fftSize, fftSize);
             }
 
             // applying window to get windowed windowedSpectrum
-            volk_32fc_32f_multiply_32fc((lv_32fc_t*)inArray->data(), (lv_32fc_t*)inArray->data(), fftWindow.data(), fftSize);
-            out = fftPlan->npfftfft(inArray);
-            swapfft(out);
-            auto windowedSpectrumOut = npzeros(fftSize);
-            volk_32fc_s32f_power_spectrum_32f(windowedSpectrumOut->data(), (const lv_32fc_t *) out->data(), fftSize, fftSize);
+            volk_32fc_32f_multiply_32fc((lv_32fc_t*)fftIn->data(), (const lv_32fc_t*)inputBuffer.data(), fftWindow.data(), fftSize);
+            inputBuffer.erase(inputBuffer.begin(), inputBuffer.begin() + fftSize);
             if (!txMode) {
-                windowedMagnitudes.emplace_back(windowedSpectrumOut);
+                fftPlan->npfftfft(fftIn);
+                swapfft(fftOut);
+                volk_32fc_s32f_power_spectrum_32f(windowedMags, (const lv_32fc_t *) fftOut->data(), fftSize, fftSize);
             }
 
-            if (cleanFreqDomain.size() < minRecents) {
+            if (cleanCount < minRecents) {
                 return 0;
             }
 
-            std::copy(cleanFreqDomain[0]->begin(), cleanFreqDomain[0]->end(), this->out.writeBuf);
-
-            auto windowedSpectrum = npzeros(fftSize);
-            for (int r = 0; r < windowedMagnitudes.size(); r++) {
-                windowedSpectrum = addeach(windowedSpectrum, windowedMagnitudes[r]);
-            }
-            windowedSpectrum = div(windowedSpectrum, windowedMagnitudes.size());
-
-            auto clearSpectrum = npzeros(fftSize);
-            for (int r = 0; r < cleanMagnitudes.size(); r++) {
-                clearSpectrum = addeach(clearSpectrum, cleanMagnitudes[r]);
-            }
-            clearSpectrum = div(clearSpectrum, cleanMagnitudes.size());
+            std::copy(cleanSlot(0), cleanSlot(0) + fftSize, this->out.writeBuf);
 
-            std::vector<dsp::complex_t> noise(fftSize, {0, 0});
+            averageMagnitudes(windowedMagnitudes, windowedSpectrum.data());
+            averageMagnitudes(cleanMagnitudes, clearSpectrum.data());
 
             if (lossRate > 0) {
-                auto nf = filterSignal(windowedSpectrum, clearSpectrum, this->out.writeBuf); // result is filtered writebuf
+                filterSignal(windowedSpectrum.data(), clearSpectrum.data(), this->out.writeBuf); // result is filtered writebuf
                 if (!txMode) {
-                    auto newNoiseFigure = estimateNoise(nf); // i/q variance estimate, output is in noise figure.
-                    sharedDataLock.lock();
-                    noiseFigure = newNoiseFigure;
-                    sharedDataLock.unlock();
+                    estimateNoise(); // i/q variance estimate, output is in noise figure.
                 }
             }
             auto unfiltered = this->out.writeBuf;
             for(int i=0; i<fftSize; i++) {
                 // make amplitude logarithmic, for better for 8bit scaling
-                if (unfiltered[i].re == 0 && unfiltered[i].im == 0) {
-
-                } else {
+                if (unfiltered[i].re != 0 || unfiltered[i].im != 0) {
                     auto amp = unfiltered[i].amplitude();
                     auto namp = sqrt(sqrt(amp));
                     unfiltered[i] *= (namp / amp);
                 }
             }
 
-            if (fftSize < 16000 && false) {
-                uint8_t  buf[30000];
-                dsp::complex_t tbuf[30000];
-                int cnt = SampleStreamCompressor::process(fftSize, PCM_TYPE_I8, unfiltered, buf);
-                int ocnt = SampleStreamDecompressor::process(cnt, buf, tbuf);
-                float maxdelta = 0;
-                for(int q=0; q<fftSize; q++) {
-                    auto delta = (tbuf[q] - unfiltered[q]).amplitude();
-                    if (delta > maxdelta) {
-                        maxdelta = delta;
-                    }
-                }
-                flog::info("ocnt = {}  maxerr={}", ocnt, maxdelta);
-            }
-
-
-            // averaged windowedSpectrum ready, normalized around 0. Calculating noise floor
-
-//            auto smallSma = centeredSma(windowedSpectrum, smallTick);
-//            auto largeSma = centeredSma(windowedSpectrum, largeTick);
-//            auto mask = npzeros(fftSize);
-//            int rawNoiseCount = 0;
-//            auto sdata = windowedSpectrum->data();;
-//            auto sigmaskdata = mask->data();
-//            for(int i=1; i<fftSize-1; i++) {
-//                if (sdata[i] * sdata[i-1] < 0 && sdata[i] * sdata[i+1] < 0) {
-//                    // noikse
-//                    rawNoiseCount++;
-//                } else {
-//                    sigmaskdata[i] = 1.0;
-//                }
-//            }
-//            for(int i=0; i<fftSize-2; i++) {
-//                if (sigmaskdata[i] == 0 && sigmaskdata[i+2] == 0 && sigmaskdata[i+1] != 0) {
-//                    sigmaskdata[i+1] = 0;       // remove singular signals, which are not.
-//                    rawNoiseCount++;
-//                }
-//            }
-//
-//            int noiseCount = 0;
-//            int sliceSize = fftSize / noiseNPoints;
-//
-//            if (rawNoiseCount > 30 * noiseNPoints) {
-//                auto spectrumVars = npzeros(noiseNPoints);  // variances
-//                for (int p = 0; p < noiseNPoints; p++) {
-//                    float sum = 0;
-//                    int cnt = 0;
-//                    for (int q = 0; q < sliceSize; q++) {
-//                        if (sigmaskdata[q + p * sliceSize] == 0) {
-//                            double dbl = sdata[q + p * sliceSize];
-//                            sum += dbl * dbl;
-//                            cnt++;
-//                        }
-//                    }
-//                    if (cnt == 0) {
-//                        cnt = 1; // value will be 0
-//                    }
-//                    spectrumVars->at(p) = sum / cnt;
-//                }
-//
-//                math::linearInterpolateHoles(spectrumVars->data(), spectrumVars->size());
-//                spectrumVars->emplace_back(spectrumVars->back()); // duplicate last item.
-//                spectrumVars = centeredSma(spectrumVars, 5);
-//
-//
-//                // build noise figure.
-//
-//                auto iMean = npzeros(noiseNPoints);
-//                auto qMean = npzeros(noiseNPoints);
-//                auto iDev = npzeros(noiseNPoints);
-//                auto qDev = npzeros(noiseNPoints);
-//                char logg[10000] = {0};
-//                for (int p = 0; p < noiseNPoints; p++) {
-//                    dsp::complex_t iqSum = {0, 0};
-//                    int cnt = 0;
-//                    for (int q = 0; q < sliceSize; q++) {
-//                        int srcIndex = q + p * sliceSize;
-//                        if (smallSma->at(srcIndex) < spectrumVars->at(p) * lossRate && lossRate > 0) {
-//                            iqSum += this->out.writeBuf[srcIndex];
-//                            cnt++;
-//                        }
-//                    }
-//                    sprintf(logg + strlen(logg), "%d: cnt1=%d", p, cnt);
-//                    if (cnt == 0) {
-//                        cnt = 1;
-//                    }
-//                    dsp::complex_t mean = {iqSum.re / cnt, iqSum.im / cnt};
-//                    iMean->at(p) = mean.re;
-//                    qMean->at(p) = mean.im;
-//
-//                    dsp::complex_t iqVar = {0, 0};
-//                    cnt = 0;
-//                    for (int q = 0; q < sliceSize; q++) {
-//                        int srcIndex = q + p * sliceSize;
-//                        if (smallSma->at(srcIndex) < spectrumVars->at(p) * lossRate && lossRate > 0) {
-//                            auto dd = this->out.writeBuf[q + p * sliceSize] - mean;
-//                            iqVar += {dd.re * dd.re, dd.im * dd.im};
-//                            cnt++;
-//                        }
-//                    }
-//                    sprintf(logg + strlen(logg), " cnt2=%d iqv=%f+i*%f .", cnt, iqVar.re, iqVar.im);
-//                    if (cnt == 0) {
-//                        cnt = 1;
-//                    }
-//                    dsp::complex_t iqDev = {sqrt(iqVar.re / cnt), sqrt(iqVar.im / cnt)};
-//                    iDev->at(p) = iqDev.re;
-//                    qDev->at(p) = iqDev.im;
-//                }
-////                flog::info("comp: {}", logg);
-//                math::linearInterpolateHoles(iMean->data(), iMean->size());
-//                math::linearInterpolateHoles(qMean->data(), qMean->size());
-//                math::linearInterpolateHoles(iDev->data(), iDev->size());
-//                math::linearInterpolateHoles(qDev->data(), qDev->size());
-//                iMean = centeredSma(iMean, 5);
-//                qMean = centeredSma(qMean, 5);
-//                iDev = centeredSma(iDev, 5);
-//                qDev = centeredSma(qDev, 5);
-//
-//                if (lossRate > 0) {
-//                    sharedDataLock.lock();
-//                    noiseFigure.clear();
-//                    for (int p = 0; p < noiseNPoints; p++) {
-//                        dsp::complex_t iqMean = {iMean->at(p), qMean->at(p)};
-//                        dsp::complex_t iqDev = {iDev->at(p), qDev->at(p)};
-//                        if (isnan(iqMean.im) || isnan(iqMean.re) || isnan(iqDev.im) || isnan(iqDev.re)) {
-//                            flog::info("noise figure is nan: {} {} {} {}", iqMean.im, iqMean.re, iqDev.im, iqDev.re);
-//                        }
-//                        noiseFigure.emplace_back(iqMean);
-//                        noiseFigure.emplace_back(iqDev);
-//                    }
-//                    sharedDataLock.unlock();
-//                }
-//
-//                for(int i=0; i<fftSize; i++) {
-//                    if (smallSma->at(i) < spectrumVars->at(i / sliceSize) * lossRate && lossRate > 0) {
-//                        // remove signals below the noise level.
-//                        this->out.writeBuf[i] = {0, 0};
-//                        noiseCount++;
-//                    }
-//                }
-//
-//            }
-
-
-//            flog::info("RawNoiseCount={} NoiseCount={} ", rawNoiseCount, noiseCount);
-
-            iteration++;
-            if (iteration == -10) {
-                FILE *t = fopen("/tmp/arr.bin", "wb");
-                if (t) {
-                    for (int r = 0; r < minRecents; r++) {
-                        fwrite(cleanFreqDomain[r].get()->data(), sizeof(dsp::complex_t), fftSize, t);
-                    }
-                    fclose(t);
-                }
-            }
-
-            cleanFreqDomain.erase(cleanFreqDomain.begin() + 0);
-            if (cleanMagnitudes.size() > minRecents * 2) {
-                cleanMagnitudes.erase(cleanMagnitudes.begin() + 0);
-                windowedMagnitudes.erase(windowedMagnitudes.begin() + 0);
+            cleanHead = (cleanHead + 1) % minRecents;
+            cleanCount--;
+            if (magnitudeCount > minRecents * 2) {
+                dropOldestMagnitudes();
             }
 
             return fftSize;
@@ -453,11 +353,50 @@ namespace dsp::compression {
                 if (outCount) {
                     if (!base_type::out.swap(outCount)) { return -1; }
                 }
-//                flog::info("experimental FFT compr: inCount={} outCount={} bufSize={}", count, outCount, (int)inputBuffer.size());
                 return outCount;
             }
         }
 
+    private:
+        static constexpr int percentileTargetPoints = 100;
+
+        // Scratch, fftSize each
+        std::vector<float> windowedSpectrum;
+        std::vector<float> clearSpectrum;
+        std::vector<float> mvar;
+        std::vector<float> noiseFloor;
+        std::vector<float> mask;
+        std::vector<float> scratchA;
+        std::vector<float> scratchB;
+        std::vector<float> percentileScratch;
+
+        // n-th oldest entry
+        complex_t* cleanSlot(int n) {
+            return &cleanFreqDomain[(size_t)((cleanHead + n) % minRecents) * fftSize];
+        }
+
+        float* magnitudeSlot(std::vector<float>& ring, int n) {
+            return &ring[(size_t)((magnitudeHead + n) % magnitudeSlots) * fftSize];
+        }
+
+        void dropOldestMagnitudes() {
+            magnitudeHead = (magnitudeHead + 1) % magnitudeSlots;
+            magnitudeCount--;
+        }
 
+        // Mean of the history, summed oldest first from zero then scaled like arrays::div(). Done a few
+        // cache lines at a time so the partial sums stay in L1 while the slots stream past.
+        void averageMagnitudes(std::vector<float>& ring, float* out) {
+            const int chunk = 1024;
+            float scale = 1.0 / (float)magnitudeCount;
+            for (int offset = 0; offset < fftSize; offset += chunk) {
+                int count = std::min<int>(chunk, fftSize - offset);
+                std::fill(out + offset, out + offset + count, 0.0f);
+                for (int r = 0; r < magnitudeCount; r++) {
+                    volk_32f_x2_add_32f(out + offset, out + offset, magnitudeSlot(ring, r) + offset, count);
+                }
+                volk_32f_s32f_multiply_32f(out + offset, out + offset, scale, count);
+            }
+        }
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,286 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <type_traits>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace dsp::compression::lossless {
+    // Lossless codec for interleaved integer samples (IQ pairs, or any 1-2 channel int8/int16 audio).
+    //
+    // Each channel is predicted from its own history with the best of three fixed polynomial predictors
+    // (none, delta, second order), chosen per block, and the residuals are Rice coded with a parameter
+    // fitted to the block. Receiver noise rarely uses the full sample width, this recovers the unused
+    // bits where generic compressors find no repeated patterns to work with.
+    //
+    // Layout: Header, then for every block and channel a 2 bit predictor order, a 5 bit Rice parameter
+    // and the residuals, as one MSB first bitstream. A buffer whose coded size would reach its raw size
+    // is stored raw as a whole instead, flagged in the header.
+
+    static constexpr int BLOCK_SIZE = 256;
+
+#pragma pack(push, 1)
+    struct Header {
+        uint32_t frames;
+        uint8_t channels;
+        uint8_t sampleBytes;
+        uint8_t raw;
+        uint8_t reserved;
+    };
+#pragma pack(pop)
+
+    // Quotients from ESCAPE_QUOTIENT up are sent as ESCAPE_QUOTIENT zeros and the value on RAW_BITS bits
+    static constexpr int ESCAPE_QUOTIENT = 24;
+    static constexpr int RAW_BITS = 20;
+    static constexpr int MAX_RICE_PARAM = 18;
+
+    // Worst case output size, coding falls back to raw for the whole buffer as soon as the bitstream
+    // reaches the raw size, which can overshoot by at most one block
+    inline int maxEncodedSize(int frames, int channels, int sampleBytes) {
+        int worstBlock = channels * (1 + (BLOCK_SIZE * (ESCAPE_QUOTIENT + RAW_BITS) + 7) / 8);
+        return sizeof(Header) + (frames * channels * sampleBytes) + worstBlock + 8;
+    }
+
+    inline int clz64(uint64_t v) {
+#ifdef _MSC_VER
+        unsigned long idx;
+        return _BitScanReverse64(&idx, v) ? (63 - (int)idx) : 64;
+#else
+        return v ? __builtin_clzll(v) : 64;
+#endif
+    }
+
+    inline uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+    inline int32_t unzigzag(uint32_t u) { return (int32_t)(u >> 1) ^ -(int32_t)(u & 1); }
+
+    class BitWriter {
+    public:
+        BitWriter(uint8_t* out) : out(out) {}
+
+        // n <= 32
+        inline void put(uint32_t value, int n) {
+            acc = (acc << n) | value;
+            bits += n;
+            if (bits >= 32) {
+                bits -= 32;
+                uint32_t word = (uint32_t)(acc >> bits);
+                out[pos++] = word >> 24;
+                out[pos++] = word >> 16;
+                out[pos++] = word >> 8;
+                out[pos++] = word;
+            }
+        }
+
+        inline void putRice(uint32_t u, int k) {
+            uint32_t q = u >> k;
+            if (q < ESCAPE_QUOTIENT) {
+                put(1, q + 1);
+                if (k) { put(u & ((1u << k) - 1), k); }
+            }
+            else {
+                put(0, ESCAPE_QUOTIENT);
+                put(u, RAW_BITS);
+            }
+        }
+
+        // Pads to a byte boundary and returns the number of bytes written
+        int finish() {
+            while (bits >= 8) {
+                bits -= 8;
+                out[pos++] = acc >> bits;
+            }
+            if (bits) {
+                out[pos++] = acc << (8 - bits);
+                bits = 0;
+            }
+            return pos;
+        }
+
+        int bytes() { return pos + ((bits + 7) >> 3); }
+
+    private:
+        uint8_t* out;
+        int pos = 0;
+        uint64_t acc = 0;
+        int bits = 0;
+    };
+
+    // Reads ahead a whole 64 bit word at a time so a symbol costs one load, a count leading zeros and shifts
+    class BitReader {
+    public:
+        BitReader(const uint8_t* in, int size) : in(in), size(size) {}
+
+        // At least 57 valid bits, MSB aligned, zeros past the end
+        inline uint64_t peek() {
+            size_t byte = bitPos >> 3;
+            uint64_t w;
+            if (byte + 8 <= (size_t)size) {
+                w = ((uint64_t)in[byte] << 56) | ((uint64_t)in[byte + 1] << 48) | ((uint64_t)in[byte + 2] << 40) | ((uint64_t)in[byte + 3] << 32) |
+                    ((uint64_t)in[byte + 4] << 24) | ((uint64_t)in[byte + 5] << 16) | ((uint64_t)in[byte + 6] << 8) | (uint64_t)in[byte + 7];
+            }
+            else {
+                w = 0;
+                for (int i = 0; i < 8; i++) {
+                    w = (w << 8) | ((byte + i < (size_t)size) ? in[byte + i] : 0);
+                }
+            }
+            return w << (bitPos & 7);
+        }
+
+        inline uint32_t get(int n) {
+            uint32_t v = (uint32_t)(peek() >> (64 - n));
+            bitPos += n;
+            return v;
+        }
+
+        inline uint32_t getRice(int k) {
+            uint64_t w = peek();
+            int q = clz64(w);
+            if (q < ESCAPE_QUOTIENT) {
+                int len = q + 1 + k;
+                uint32_t low = k ? (uint32_t)(w >> (64 - len)) & ((1u << k) - 1) : 0;
+                bitPos += len;
+                return ((uint32_t)q << k) | low;
+            }
+            bitPos += ESCAPE_QUOTIENT + RAW_BITS;
+            return (uint32_t)(w >> (64 - ESCAPE_QUOTIENT - RAW_BITS)) & ((1u << RAW_BITS) - 1);
+        }
+
+        bool overrun() { return (bitPos >> 3) > (size_t)size; }
+
+    private:
+        const uint8_t* in;
+        int size;
+        size_t bitPos = 0;
+    };
+
+    // Predictor state of one channel, carried across blocks
+    struct History {
+        int32_t x1 = 0;
+        int32_t x2 = 0;
+    };
+
+    template <class T>
+    inline void encodeChannel(BitWriter& bw, const T* in, int n, int stride, History& hist) {
+        int32_t res[3][BLOCK_SIZE];
+        uint64_t cost[3] = { 0, 0, 0 };
+        int32_t x1 = hist.x1;
+        int32_t x2 = hist.x2;
+        for (int i = 0; i < n; i++) {
+            int32_t x = in[i * stride];
+            res[0][i] = x;
+            res[1][i] = x - x1;
+            res[2][i] = x - 2 * x1 + x2;
+            cost[0] += zigzag(res[0][i]);
+            cost[1] += zigzag(res[1][i]);
+            cost[2] += zigzag(res[2][i]);
+            x2 = x1;
+            x1 = x;
+        }
+        hist.x1 = x1;
+        hist.x2 = x2;
+
+        int order = (int)(std::min_element(cost, cost + 3) - cost);
+
+        // k ~ log2(mean) - 1, close to the optimum for geometric residuals
+        int k = 0;
+        while (k < MAX_RICE_PARAM && ((uint64_t)n << (k + 1)) <= cost[order]) { k++; }
+
+        bw.put((order << 5) | k, 7);
+        const int32_t* r = res[order];
+        for (int i = 0; i < n; i++) {
+            bw.putRice(zigzag(r[i]), k);
+        }
+    }
+
+    template <class T>
+    inline void decodeChannel(BitReader& br, T* out, int n, int stride, History& hist) {
+        uint32_t head = br.get(7);
+        int order = head >> 5;
+        int k = head & 0x1F;
+        // Prediction is a * x[n-1] + b * x[n-2]
+        static const int32_t coeffs[4][2] = { { 0, 0 }, { 1, 0 }, { 2, -1 }, { 2, -1 } };
+        int32_t a = coeffs[order][0];
+        int32_t b = coeffs[order][1];
+        int32_t x1 = hist.x1;
+        int32_t x2 = hist.x2;
+        for (int i = 0; i < n; i++) {
+            int32_t x = a * x1 + b * x2 + unzigzag(br.getRice(k));
+            out[i * stride] = x;
+            x2 = x1;
+            x1 = x;
+        }
+        hist.x1 = x1;
+        hist.x2 = x2;
+    }
+
+    // Returns the encoded size, out must hold maxEncodedSize() bytes
+    template <class T>
+    inline int encode(const T* in, int frames, int channels, uint8_t* out) {
+        static_assert(std::is_same_v<T, int8_t> || std::is_same_v<T, int16_t>, "Only int8 and int16 samples are supported");
+        Header* hdr = (Header*)out;
+        hdr->frames = frames;
+        hdr->channels = channels;
+        hdr->sampleBytes = sizeof(T);
+        hdr->raw = 0;
+        hdr->reserved = 0;
+
+        int rawSize = frames * channels * sizeof(T);
+        BitWriter bw(&out[sizeof(Header)]);
+        History hist[2];
+        for (int offset = 0; offset < frames; offset += BLOCK_SIZE) {
+            int n = std::min<int>(BLOCK_SIZE, frames - offset);
+            for (int c = 0; c < channels; c++) {
+                encodeChannel<T>(bw, &in[offset * channels + c], n, channels, hist[c]);
+            }
+
+            // Incompressible, e.g. saturated or full scale white noise
+            if (bw.bytes() >= rawSize) {
+                hdr->raw = 1;
+                memcpy(&out[sizeof(Header)], in, rawSize);
+                return sizeof(Header) + rawSize;
+            }
+        }
+        return sizeof(Header) + bw.finish();
+    }
+
+    // Number of frames in an encoded buffer, or -1 if it is not a valid one for T
+    template <class T>
+    inline int frameCount(const uint8_t* in, int size) {
+        if (size < (int)sizeof(Header)) { return -1; }
+        const Header* hdr = (const Header*)in;
+        if (hdr->sampleBytes != sizeof(T) || hdr->channels < 1 || hdr->channels > 2) { return -1; }
+        return hdr->frames;
+    }
+
+    // Returns the number of frames decoded, or -1 if the data is invalid or larger than maxFrames
+    template <class T>
+    inline int decode(const uint8_t* in, int size, T* out, int maxFrames) {
+        int frames = frameCount<T>(in, size);
+        if (frames < 0 || frames > maxFrames) { return -1; }
+        const Header* hdr = (const Header*)in;
+        int channels = hdr->channels;
+        const uint8_t* data = &in[sizeof(Header)];
+        int dataSize = size - sizeof(Header);
+
+        if (hdr->raw) {
+            int rawSize = frames * channels * sizeof(T);
+            if (dataSize < rawSize) { return -1; }
+            memcpy(out, data, rawSize);
+            return frames;
+        }
+
+        BitReader br(data, dataSize);
+        History hist[2];
+        for (int offset = 0; offset < frames; offset += BLOCK_SIZE) {
+            int n = std::min<int>(BLOCK_SIZE, frames - offset);
+            for (int c = 0; c < channels; c++) {
+                decodeChannel<T>(br, &out[offset * channels + c], n, channels, hist[c]);
+            }
+        }
+        return br.overrun() ? -1 : frames;
+    }
+}
@@ -1,9 +1,19 @@
 #pragma once
+#include <math.h>
 
 namespace dsp::compression {
     enum PCMType {
         PCM_TYPE_I8,
         PCM_TYPE_I16,
-        PCM_TYPE_F32
+        PCM_TYPE_F32,
+        PCM_TYPE_BFP8   // Int8 with a shared exponent per sub-block
     };
-}
\ No newline at end of file
+
+    // Complex samples sharing one exponent in PCM_TYPE_BFP8
+    static constexpr int BFP_BLOCK_SIZE = 128;
+
+    // PCM_TYPE_BFP8 exponents are in quarter octaves
+    inline float bfpScale(int exp) {
+        return exp2f((float)exp * 0.25f);
+    }
+}
@@ -44,6 +44,12 @@ namespace dsp::compression {
                 return 8 + (count * sizeof(complex_t));
             }
 
+            // Block floating point, the scaler field carries the sub-block size
+            if (pcmType == PCMType::PCM_TYPE_BFP8) {
+                *scaler = BFP_BLOCK_SIZE;
+                return 8 + encodeBFP8(count, in, (uint8_t*)dataBuf);
+            }
+
             // Find maximum value
             uint32_t maxIdx; // in case count = 0
             volk_32f_index_max_32u(&maxIdx, (float*)in, count * 2);
@@ -63,6 +69,30 @@ namespace dsp::compression {
             return count;
         }
 
+        // Layout: one int8 exponent per sub-block, then the int8 I/Q pairs of all sub-blocks.
+        // Every sub-block is scaled by the quarter octave step just above its peak magnitude so a
+        // single strong impulse only costs resolution in its own sub-block.
+        static int encodeBFP8(int count, const complex_t* in, uint8_t* out) {
+            int blocks = (count + BFP_BLOCK_SIZE - 1) / BFP_BLOCK_SIZE;
+            int8_t* exps = (int8_t*)out;
+            int8_t* data = (int8_t*)&out[blocks];
+            for (int b = 0; b < blocks; b++) {
+                int offset = b * BFP_BLOCK_SIZE;
+                int n = std::min<int>(BFP_BLOCK_SIZE, count - offset);
+
+                // Largest magnitude bounds both components
+                uint32_t maxIdx;
+                volk_32fc_index_max_32u(&maxIdx, (lv_32fc_t*)&in[offset], n);
+                float maxVal = in[offset + maxIdx].amplitude();
+                int exp = (maxVal > 0.0f) ? (int)ceilf(4.0f * log2f(maxVal)) : -128;
+                exp = std::clamp<int>(exp, -128, 127);
+                exps[b] = exp;
+
+                volk_32f_s32f_convert_8i(&data[offset * 2], (float*)&in[offset], 128.0f / bfpScale(exp), n * 2);
+            }
+            return blocks + (count * 2);
+        }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -29,10 +29,33 @@ namespace dsp::compression {
                 volk_8i_s32f_convert_32f((float*)out, (int8_t*)dataBuf, 128.0f / scaler, outCount * 2);
                 return outCount;
             }
+            else if (sampleType == PCMType::PCM_TYPE_BFP8) {
+                return decodeBFP8(count - 8, (int)scaler, (const uint8_t*)dataBuf, out);
+            }
             
             return 0;
         }
 
+        // See SampleStreamCompressor::encodeBFP8 for the layout
+        static int decodeBFP8(int size, int blockSize, const uint8_t* in, complex_t* out) {
+            if (blockSize <= 0) { return 0; }
+
+            // The sample count isn't sent, recover it from the payload size
+            auto encodedSize = [=](int c) { return (c + blockSize - 1) / blockSize + (c * 2); };
+            int outCount = (int)(((int64_t)size * blockSize) / (2 * blockSize + 1));
+            while (encodedSize(outCount + 1) <= size) { outCount++; }
+            int blocks = (outCount + blockSize - 1) / blockSize;
+
+            const int8_t* exps = (const int8_t*)in;
+            const int8_t* data = (const int8_t*)&in[blocks];
+            for (int b = 0; b < blocks; b++) {
+                int offset = b * blockSize;
+                int n = std::min<int>(blockSize, outCount - offset);
+                volk_8i_s32f_convert_32f((float*)&out[offset], &data[offset * 2], 128.0f / bfpScale(exps[b]), n * 2);
+            }
+            return outCount;
+        }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -59,6 +59,8 @@ namespace dsp::correction {
             return count;
         }
 
+        DEFAULT_FUSABLE_PROC
+
         virtual int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -5,6 +5,7 @@
 #include "../convert/mono_to_stereo.h"
 #include "../filter/fir.h"
 #include "../taps/low_pass.h"
+#include "../taps/tap_cache.h"
 
 namespace dsp::demod {
     template <class T>
@@ -34,7 +35,7 @@ namespace dsp::demod {
             carrierAgc.init(NULL, 1.0, agcAttack, agcDecay, 10e6, 10.0, INFINITY);
             audioAgc.init(NULL, 1.0, agcAttack, agcDecay, 10e6, 10.0, INFINITY);
             dcBlock.init(NULL, dcBlockRate);
-            lpfTaps = taps::lowPass(bandwidth / 2.0, (bandwidth / 2.0) * 0.1, samplerate);
+            lpfTaps = taps::cache::lowPass(bandwidth / 2.0, (bandwidth / 2.0) * 0.1, samplerate);
             lpf.init(NULL, lpfTaps);
 
             if constexpr (std::is_same_v<T, float>) {
@@ -62,7 +63,7 @@ namespace dsp::demod {
             _bandwidth = bandwidth;
             std::lock_guard<std::mutex> lck2(lpfMtx);
             taps::free(lpfTaps);
-            lpfTaps = taps::lowPass(_bandwidth / 2.0, (_bandwidth / 2.0) * 0.1, _samplerate);
+            lpfTaps = taps::cache::lowPass(_bandwidth / 2.0, (_bandwidth / 2.0) * 0.1, _samplerate);
             lpf.setTaps(lpfTaps);
         }
 
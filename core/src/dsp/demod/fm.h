@@ -5,6 +5,7 @@
 #include "../taps/low_pass.h"
 #include "../taps/high_pass.h"
 #include "../taps/band_pass.h"
+#include "../taps/tap_cache.h"
 #include "../convert/mono_to_stereo.h"
 
 namespace dsp::demod {
@@ -127,13 +128,13 @@ namespace dsp::demod {
 
             // Generate filter depending on low and high pass settings
             if (_lowPass && _highPass) {
-                filterTaps = dsp::taps::bandPass<float>(300.0, _bandwidth / 2.0, 100.0, _samplerate);
+                filterTaps = dsp::taps::cache::bandPass(300.0, _bandwidth / 2.0, 100.0, _samplerate);
             }
             else if (_highPass) {
                 filterTaps = dsp::taps::highPass(300.0, 100.0, _samplerate);
             }
             else if (_lowPass) {
-                filterTaps = dsp::taps::lowPass(_bandwidth / 2.0, (_bandwidth / 2.0) * 0.1, _samplerate);
+                filterTaps = dsp::taps::cache::lowPass(_bandwidth / 2.0, (_bandwidth / 2.0) * 0.1, _samplerate);
             }
             else {
                 loadDummyTaps();
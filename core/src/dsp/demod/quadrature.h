@@ -3,8 +3,15 @@
 #include "../math/fast_atan2.h"
 #include "../math/hz_to_rads.h"
 #include "../math/normalize_phase.h"
+#include <algorithm>
+#include <volk/volk.h>
 
 namespace dsp::demod {
+    // FM discriminator: out[n] = arg(x[n] * conj(x[n-1])) / deviation.
+    //
+    // The conjugate product and the atan2 run through volk over whole blocks, so the polynomial
+    // SSE/AVX2/NEON kernels are picked at runtime by volk's CPU detection. The difference angle
+    // is already within (-pi, pi], no unwrapping pass is needed.
     class Quadrature : public Processor<complex_t, float> {
         using base_type = Processor<complex_t, float>;
     public:
@@ -14,9 +21,16 @@ namespace dsp::demod {
 
         Quadrature(stream<complex_t>* in, double deviation, double samplerate) { init(in, deviation, samplerate); }
 
-        
+        ~Quadrature() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(productBuf);
+        }
+
         virtual void init(stream<complex_t>* in, double deviation) {
+            _deviation = deviation;
             _invDeviation = 1.0 / deviation;
+            if (!productBuf) { productBuf = buffer::alloc<complex_t>(STREAM_BUFFER_SIZE); }
             base_type::init(in);
         }
 
@@ -27,28 +41,48 @@ namespace dsp::demod {
         void setDeviation(double deviation) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            _deviation = deviation;
             _invDeviation = 1.0 / deviation;
         }
 
         void setDeviation(double deviation, double samplerate) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            _invDeviation = 1.0 / ::dsp::math::hzToRads(deviation, samplerate);
+            _deviation = ::dsp::math::hzToRads(deviation, samplerate);
+            _invDeviation = 1.0 / _deviation;
+        }
+
+        inline int process(int count, const complex_t* in, float* out) {
+            for (int done = 0; done < count;) {
+                int n = std::min<int>(count - done, STREAM_BUFFER_SIZE);
+                productBuf[0] = complex_t(in[done]) * last.conj();
+                if (n > 1) {
+                    volk_32fc_x2_multiply_conjugate_32fc((lv_32fc_t*)&productBuf[1], (const lv_32fc_t*)&in[done + 1], (const lv_32fc_t*)&in[done], n - 1);
+                }
+                volk_32fc_s32f_atan2_32f(&out[done], (const lv_32fc_t*)productBuf, _deviation, n);
+                last = in[done + n - 1];
+                done += n;
+            }
+            return count;
         }
 
-        inline int process(int count, complex_t* in, float* out) {
+        // Per sample atan2f and phase unwrapping, kept as the reference for process()
+        inline int processScalar(int count, const complex_t* in, float* out) {
+            if (count <= 0) { return count; }
+            float phase = last.phase();
             for (int i = 0; i < count; i++) {
                 float cphase = in[i].phase();
                 out[i] = math::normalizePhase(cphase - phase) * _invDeviation;
                 phase = cphase;
             }
+            last = in[count - 1];
             return count;
         }
 
         void reset() {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            phase = 0.0f;
+            last = { 1.0f, 0.0f };
         }
 
         int run() {
@@ -63,7 +97,9 @@ namespace dsp::demod {
         }
 
     protected:
+        float _deviation;
         float _invDeviation;
-        float phase = 0.0f;
+        complex_t last = { 1.0f, 0.0f };
+        complex_t* productBuf = NULL;
     };
 }
\ No newline at end of file
@@ -28,8 +28,10 @@ namespace dsp::filter {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
+            if (base_type::useFFT) { base_type::ols.saveHistory(base_type::delay.history()); }
             _decimation = decimation;
             offset = 0;
+            base_type::updateEngine();
             base_type::tempStart();
         }
 
@@ -43,30 +45,42 @@ namespace dsp::filter {
         }
 
         inline int process(int count, const D* in, D* out) {
-            // Copy data to work buffer
-            memcpy(base_type::bufStart, in, count * sizeof(D));
+            if constexpr (OverlapSave<D, T>::supported) {
+                if (base_type::useFFT) {
+                    // Filter at the full rate into the output, then keep every _decimation-th sample in place
+                    base_type::ols.process(count, in, out);
+                    int outCount = 0;
+                    for (; offset < count; offset += _decimation) {
+                        out[outCount++] = out[offset];
+                    }
+                    offset -= count;
+                    return outCount;
+                }
+            }
 
             // Do convolution
             int outCount = 0;
+            base_type::delay.begin(in, count, out, count / _decimation + 1);
             for (; offset < count; offset += _decimation) {
+                const D* win = base_type::delay.window(offset);
                 if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[outCount++], &base_type::buffer[offset], base_type::_taps.taps, base_type::_taps.size);
+                    volk_32f_x2_dot_prod_32f(&out[outCount++], win, base_type::_taps.taps, base_type::_taps.size);
                 }
                 if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&base_type::buffer[offset], base_type::_taps.taps, base_type::_taps.size);
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)win, base_type::_taps.taps, base_type::_taps.size);
                 }
                 if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
-                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&base_type::buffer[offset], (lv_32fc_t*)base_type::_taps.taps, base_type::_taps.size);
+                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)win, (lv_32fc_t*)base_type::_taps.taps, base_type::_taps.size);
                 }
             }
             offset -= count;
-
-            // Move unused data
-            memmove(base_type::buffer, &base_type::buffer[count], (base_type::_taps.size - 1) * sizeof(D));
+            base_type::delay.end();
 
             return outCount;
         }
 
+        DEFAULT_FUSABLE_PROC
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -82,6 +96,8 @@ namespace dsp::filter {
         }
 
     protected:
+        int directTapCount() override { return base_type::_taps.size / _decimation; }
+
         int _decimation;
         int offset = 0;
     };
@@ -1,6 +1,8 @@
 #pragma once
 #include "../processor.h"
 #include "../taps/tap.h"
+#include "../buffer/delay_line.h"
+#include "overlap_save.h"
 #include <utils/flog.h>
 
 namespace dsp::filter {
@@ -15,17 +17,12 @@ namespace dsp::filter {
         ~FIR() {
             if (!base_type::_block_init) { return; }
             base_type::stop();
-            buffer::free(buffer);
         }
 
         virtual void init(stream<D>* in, tap<T>& taps) {
             _taps = taps;
-
-            // Allocate and clear buffer
-            buffer = buffer::alloc<D>(STREAM_BUFFER_SIZE + 64000);
-            bufStart = &buffer[_taps.size - 1];
-            buffer::clear<D>(buffer, _taps.size - 1);
-//            spdlog::info("FIR: Allocated buffer of size {0} at {1}", STREAM_BUFFER_SIZE + 64000, (void*)buffer);
+            delay.setTapCount(_taps.size);
+            updateEngine();
 
             base_type::init(in);
         }
@@ -35,21 +32,14 @@ namespace dsp::filter {
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
 
-            int oldTC = _taps.size;
-            _taps = taps;
+            // The FFT engine keeps its own copy of the history
+            if (useFFT) { ols.saveHistory(delay.history()); }
 
-            // Update start of buffer
-            bufStart = &buffer[_taps.size - 1];
+            // Keep the existing history to make the transition seemless
+            _taps = taps;
+            delay.setTapCount(_taps.size);
+            updateEngine();
 
-            // Move existing data to make transition seemless
-            if (_taps.size < oldTC) {
-                memmove(buffer, &buffer[oldTC - _taps.size], (_taps.size - 1) * sizeof(D));
-            }
-            else if (_taps.size > oldTC) {
-                memmove(&buffer[_taps.size - oldTC], buffer, (oldTC - 1) * sizeof(D));
-                buffer::clear<D>(buffer, _taps.size - oldTC);
-            }
-            
             base_type::tempStart();
         }
 
@@ -57,33 +47,42 @@ namespace dsp::filter {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
-            buffer::clear<D>(buffer, _taps.size - 1);
+            delay.clear();
+            if (useFFT) { ols.loadHistory(delay.history()); }
             base_type::tempStart();
         }
 
+        bool isUsingFFT() { return useFFT; }
+
         inline int process(int count, const D* in, D* out) {
-            // Copy data to work buffer
-            memcpy(bufStart, in, count * sizeof(D));
+            if constexpr (OverlapSave<D, T>::supported) {
+                if (useFFT) {
+                    ols.process(count, in, out);
+                    if (Processor<D, D>::out.outputHook) {
+                        Processor<D, D>::out.outputHook(out, count);
+                    }
+                    return count;
+                }
+            }
 
             // Do convolution
+            delay.begin(in, count, out, count);
             for (int i = 0; i < count; i++) {
+                const D* win = delay.window(i);
                 if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[i], &buffer[i], _taps.taps, _taps.size);
+                    volk_32f_x2_dot_prod_32f(&out[i], win, _taps.taps, _taps.size);
                 } else if constexpr ((std::is_same_v<D, complex_t>) && std::is_same_v<T, float>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], _taps.taps, _taps.size);
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)win, _taps.taps, _taps.size);
                 } else  if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && (std::is_same_v<T, complex_t>)) {
-                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], (lv_32fc_t*)_taps.taps, _taps.size);
+                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)win, (lv_32fc_t*)_taps.taps, _taps.size);
                 } else if constexpr (std::is_same_v<D, stereo_t> && std::is_same_v<T, float_t>) {
-                  volk_32f_x2_dot_prod_32f(&out[i].l, &buffer[i].l, _taps.taps, _taps.size);
-                  volk_32f_x2_dot_prod_32f(&out[i].r, &buffer[i].r, _taps.taps, _taps.size);
+                  volk_32f_x2_dot_prod_32f(&out[i].l, &win->l, _taps.taps, _taps.size);
+                  volk_32f_x2_dot_prod_32f(&out[i].r, &win->r, _taps.taps, _taps.size);
                 } else {
                   static_assert((D)0, "type error"); // compile-time error
                 }
             }
-
-            // Move unused data
-            auto nmove = (_taps.size - 1) * sizeof(D);
-            memmove(buffer, &buffer[count], nmove);
+            delay.end();
 
             if (Processor<D, D>::out.outputHook) {
                 Processor<D, D>::out.outputHook(out, count);
@@ -91,6 +90,8 @@ namespace dsp::filter {
             return count;
         }
 
+        DEFAULT_FUSABLE_PROC
+
         virtual int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -103,8 +104,24 @@ namespace dsp::filter {
         }
 
     protected:
+        // Taps computed per output sample by the direct convolution
+        virtual int directTapCount() { return _taps.size; }
+
+        // Pick the convolution method, the history must be up to date in the delay line
+        void updateEngine() {
+            if constexpr (OverlapSave<D, T>::supported) {
+                useFFT = (directTapCount() >= fftConvolutionThreshold);
+                if (useFFT) {
+                    ols.setTaps(_taps);
+                    ols.loadHistory(delay.history());
+                }
+            }
+        }
+
         tap<T> _taps;
-        D* buffer;
-        D* bufStart;
+        buffer::DelayLine<D> delay;
+
+        OverlapSave<D, T> ols;
+        bool useFFT = false;
     };
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+#include <type_traits>
+#include "../taps/tap.h"
+#include "utils/arrays.h"
+
+namespace dsp::filter {
+    // Tap count (per output sample) from which FIR filters use FFT convolution, see bench/fir_crossover.h
+    inline int fftConvolutionThreshold = 64;
+
+    // Overlap-save FFT convolution engine with the same input/output relation as FIR::process().
+    //
+    // Blocks of new samples are appended to the last tapCount - 1 input samples, transformed,
+    // multiplied by the response of the taps and transformed back. A block can be shorter than
+    // the FFT allows, so every input sample produces one output sample without added latency.
+    template <class D, class T>
+    class OverlapSave {
+    public:
+        // Stereo samples are filtered like complex ones, real taps act on both channels independently
+        static constexpr bool supported = (std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) &&
+                                          (std::is_same_v<T, float> || (std::is_same_v<D, complex_t> && std::is_same_v<T, complex_t>));
+
+        void setTaps(const tap<T>& taps) {
+            tapCount = taps.size;
+            int size = MIN_FFT_SIZE;
+            while (size < 4 * tapCount) { size <<= 1; }
+            if (size != fftSize) {
+                fftSize = size;
+                fwdPlan = arrays::allocateFFTWPlan(false, fftSize);
+                bwdPlan = arrays::allocateFFTWPlan(true, fftSize);
+                response.resize(fftSize);
+            }
+            blockSize = fftSize - tapCount + 1;
+
+            // FIR::process() correlates the history with the taps, that's a convolution with the reversed taps
+            complex_t* fin = fwdPlan->getInput()->data();
+            buffer::clear(fin, fftSize);
+            for (int i = 0; i < tapCount; i++) {
+                if constexpr (std::is_same_v<T, float>) {
+                    fin[tapCount - 1 - i] = { taps.taps[i], 0.0f };
+                }
+                else {
+                    fin[tapCount - 1 - i] = taps.taps[i];
+                }
+            }
+            arrays::npfftfft(fwdPlan->getInput(), fwdPlan);
+            memcpy(response.data(), fwdPlan->getOutput()->data(), fftSize * sizeof(complex_t));
+            buffer::clear(fin, fftSize);
+        }
+
+        // Load/store the last tapCount - 1 input samples
+        void loadHistory(const D* history) {
+            memcpy(fwdPlan->getInput()->data(), history, (tapCount - 1) * sizeof(D));
+        }
+
+        void saveHistory(D* history) {
+            memcpy(history, fwdPlan->getInput()->data(), (tapCount - 1) * sizeof(D));
+        }
+
+        inline int process(int count, const D* in, D* out) {
+            complex_t* fin = fwdPlan->getInput()->data();
+            complex_t* bin = bwdPlan->getInput()->data();
+            int hist = tapCount - 1;
+
+            for (int i = 0; i < count;) {
+                // What is after the new samples doesn't matter, it only affects discarded outputs
+                int n = std::min<int>(blockSize, count - i);
+                memcpy(&fin[hist], &in[i], n * sizeof(D));
+
+                arrays::npfftfft(fwdPlan->getInput(), fwdPlan);
+                volk_32fc_x2_multiply_32fc((lv_32fc_t*)bin, (lv_32fc_t*)fwdPlan->getOutput()->data(), (lv_32fc_t*)response.data(), fftSize);
+                arrays::npfftfft(bwdPlan->getInput(), bwdPlan);
+
+                // Copy out before the history update, in and out may be the same buffer
+                memcpy(&out[i], &bwdPlan->getOutput()->data()[hist], n * sizeof(D));
+                memmove(fin, &fin[n], hist * sizeof(complex_t));
+                i += n;
+            }
+            return count;
+        }
+
+        int getFFTSize() { return fftSize; }
+
+    protected:
+        static constexpr int MIN_FFT_SIZE = 256;
+
+        int tapCount = 0;
+        int fftSize = 0;
+        int blockSize = 0;
+        arrays::Arg<arrays::FFTPlan> fwdPlan;
+        arrays::Arg<arrays::FFTPlan> bwdPlan;
+        std::vector<complex_t> response;
+    };
+}
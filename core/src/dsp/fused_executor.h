@@ -0,0 +1,83 @@
+#pragma once
+#include <vector>
+#include "processor.h"
+
+namespace dsp {
+    // Runs a linear sequence of fusable processors inline on a single thread.
+    //
+    // Instead of every link owning a worker thread and handing each buffer over through a
+    // stream swap, the executor reads its input once and calls processInline() of each link
+    // back to back, ping-ponging between its output buffer and a scratch buffer.
+    // The links must not be started while they are owned by an executor.
+    template <class T>
+    class FusedExecutor : public Processor<T, T> {
+        using base_type = Processor<T, T>;
+    public:
+        FusedExecutor() {}
+
+        FusedExecutor(stream<T>* in) { init(in); }
+
+        ~FusedExecutor() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(scratch);
+        }
+
+        void init(stream<T>* in) {
+            scratch = buffer::alloc<T>(STREAM_BUFFER_SIZE);
+            base_type::init(in);
+        }
+
+        void setLinks(const std::vector<Processor<T, T>*>& links) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            for (auto& ln : links) {
+                if (!ln->isFusable()) {
+                    throw std::runtime_error("[FusedExecutor] Tried to fuse a block that isn't fusable");
+                }
+            }
+            _links = links;
+            base_type::tempStart();
+        }
+
+        bool isPoolable() override { return true; }
+
+        static bool canFuse(const std::vector<Processor<T, T>*>& links) {
+            if (links.empty()) { return false; }
+            for (auto& ln : links) {
+                if (!ln->isFusable()) { return false; }
+            }
+            return true;
+        }
+
+        int process(int count, T* in, T* out) {
+            // Pick the first buffer so that the last link always ends up writing to `out`
+            int n = _links.size();
+            for (int i = 0; i < n && count > 0; i++) {
+                T* dst = ((n - 1 - i) & 1) ? scratch : out;
+                count = _links[i]->processInline(count, in, dst);
+                in = dst;
+            }
+            return count;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            // A decimating link may not produce anything for this buffer
+            base_type::_in->flush();
+            if (outCount > 0) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return count;
+        }
+
+    protected:
+        std::vector<Processor<T, T>*> _links;
+        T* scratch;
+    };
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "../processor.h"
+#include <volk/volk.h>
 
 namespace dsp::loop {
     template <class T>
@@ -10,6 +11,12 @@ namespace dsp::loop {
 
         AGC(stream<T>* in, double setPoint, double attack, double decay, double maxGain, double maxOutputAmp, double initGain = 1.0) { init(in, setPoint, attack, decay, maxGain, maxOutputAmp, initGain); }
 
+        ~AGC() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(gainBuf);
+        }
+
         void init(stream<T>* in, double setPoint, double attack, double decay, double maxGain, double maxOutputAmp, double initGain = 1.0) {
             _setPoint = setPoint;
             _attack = attack;
@@ -22,6 +29,7 @@ namespace dsp::loop {
             _startEnvelope = 0;
             _frozen.store(false);
             amp = _setPoint / _initGain;
+            if (!gainBuf) { gainBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE); }
             base_type::init(in);
         }
 
@@ -82,62 +90,23 @@ namespace dsp::loop {
             _frozen.store(b);
         }
 
+        // Envelope and gain application are block-wide volk kernels, only the one-pole smoother
+        // runs sample by sample over the precomputed amplitudes.
         inline int process(int count, T* in, T* out) {
-            float envelope = 1.0f;
             if (_attack <= 0) {
                 std::copy(in, in + count, out);
                 return count;
             }
-            for (int i = 0; i < count; i++) {
-                // Get signal amplitude
-                float inAmp, gain = 1.0;
-                if constexpr (std::is_same_v<T, complex_t>) {
-                    inAmp = in[i].amplitude();
-                }
-                if constexpr (std::is_same_v<T, float>) {
-                    inAmp = fabsf(in[i]);
-                }
-
-                // Update average amplitude
-                if (inAmp != 0.0f) {
-                    if (!_frozen.load()) {
-                        auto namp = (inAmp > amp) ? ((amp * _invAttack) + (inAmp * _attack)) : ((amp * _invDecay) + (inAmp * _decay));
-                        if (!isnan(namp)) {
-                            amp = namp;
-                            gain = std::min<float>(_setPoint / amp, _maxGain);
-                        }
-                    }
-                }
-                else {
-                    gain = 1.0f;
-                }
-
-                // If clipping is detected look ahead and correct
-                if (false && inAmp*gain > _maxOutputAmp) {
-                    float maxAmp = 0;
-                    for (int j = i; j < count; j++) {
-                        if constexpr (std::is_same_v<T, complex_t>) {
-                            inAmp = in[j].amplitude();
-                        }
-                        if constexpr (std::is_same_v<T, float>) {
-                            inAmp = fabsf(in[j]);
-                        }
-                        if (inAmp > maxAmp) { maxAmp = inAmp; }
-                    }
-                    amp = maxAmp;
-                    gain = std::min<float>(_setPoint / amp, _maxGain);
-                }
-
-                if (_startEnvelope < _totalEnvelopeLength) {
-                    envelope = _startEnvelope / (float)_totalEnvelopeLength;
-                }
-                _startEnvelope++;
-                // Scale output by gain
-                out[i] = in[i] * gain * envelope;
+            for (int done = 0; done < count;) {
+                int n = std::min<int>(count - done, STREAM_BUFFER_SIZE);
+                processBlock(n, &in[done], &out[done]);
+                done += n;
             }
             return count;
         }
 
+        DEFAULT_FUSABLE_PROC
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -150,6 +119,49 @@ namespace dsp::loop {
         }
 
     protected:
+        inline void processBlock(int count, T* in, T* out) {
+            // Get signal amplitudes
+            if constexpr (std::is_same_v<T, complex_t>) {
+                volk_32fc_magnitude_32f(gainBuf, (lv_32fc_t*)in, count);
+            }
+            if constexpr (std::is_same_v<T, float>) {
+                for (int i = 0; i < count; i++) { gainBuf[i] = fabsf(in[i]); }
+            }
+
+            // Update average amplitude and turn each amplitude into its gain, in place
+            if (!_frozen.load()) {
+                for (int i = 0; i < count; i++) {
+                    float inAmp = gainBuf[i];
+                    float gain = 1.0f;
+                    if (inAmp != 0.0f) {
+                        bool rising = inAmp > amp;
+                        float namp = (amp * (rising ? _invAttack : _invDecay)) + (inAmp * (rising ? _attack : _decay));
+                        if (!isnan(namp)) {
+                            amp = namp;
+                            gain = std::min<float>(_setPoint / amp, _maxGain);
+                        }
+                    }
+                    gainBuf[i] = gain;
+                }
+            }
+            else {
+                std::fill(gainBuf, gainBuf + count, 1.0f);
+            }
+
+            // Fade in after init/reset
+            for (int i = 0; i < count && _startEnvelope < _totalEnvelopeLength; i++) {
+                gainBuf[i] *= _startEnvelope++ / (float)_totalEnvelopeLength;
+            }
+
+            // Scale output by gain
+            if constexpr (std::is_same_v<T, complex_t>) {
+                volk_32fc_32f_multiply_32fc((lv_32fc_t*)out, (lv_32fc_t*)in, gainBuf, count);
+            }
+            if constexpr (std::is_same_v<T, float>) {
+                volk_32f_x2_multiply_32f(out, in, gainBuf, count);
+            }
+        }
+
         float _setPoint;
         float _attack;
         float _invAttack;
@@ -163,6 +175,7 @@ namespace dsp::loop {
         std::atomic_bool _frozen;
 
         float amp = 1.0;
+        float* gainBuf = NULL;
 
     };
 }
\ No newline at end of file
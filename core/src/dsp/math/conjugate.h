@@ -14,6 +14,8 @@ namespace dsp::math {
             return count;
         }
 
+        DEFAULT_FUSABLE_PROC
+
         virtual int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
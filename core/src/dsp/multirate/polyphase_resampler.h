@@ -1,6 +1,7 @@
 #pragma once
 #include "../processor.h"
 #include "../taps/tap.h"
+#include "../buffer/delay_line.h"
 #include "polyphase_bank.h"
 
 namespace dsp::multirate {
@@ -15,7 +16,6 @@ namespace dsp::multirate {
         ~PolyphaseResampler() {
             if (!base_type::_block_init) { return; }
             base_type::stop();
-            buffer::free(buffer);
             freePolyphaseBank(phases);
         }
 
@@ -27,10 +27,8 @@ namespace dsp::multirate {
             // Build filter bank
             phases = buildPolyphaseBank(_interp, _taps);
 
-            // Allocate delay buffer
-            buffer = buffer::alloc<T>(STREAM_BUFFER_SIZE + 64000);
-            bufStart = &buffer[phases.tapsPerPhase - 1];
-            buffer::clear<T>(buffer, phases.tapsPerPhase - 1);
+            // Allocate delay line
+            delay.setTapCount(phases.tapsPerPhase);
 
             base_type::init(in);
         }
@@ -49,8 +47,8 @@ namespace dsp::multirate {
             freePolyphaseBank(phases);
             phases = buildPolyphaseBank(_interp, _taps);
 
-            // Reset buffer
-            bufStart = &buffer[phases.tapsPerPhase - 1];
+            // Reset delay line
+            delay.setTapCount(phases.tapsPerPhase);
             reset();
 
             base_type::tempStart();
@@ -60,7 +58,7 @@ namespace dsp::multirate {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
-            buffer::clear<T>(buffer, phases.tapsPerPhase - 1);
+            delay.clear();
             phase = 0;
             offset = 0;
             base_type::tempStart();
@@ -69,16 +67,17 @@ namespace dsp::multirate {
         inline int process(int count, const T* in, T* out) {
             int outCount = 0;
 
-            // Copy input to buffer
-            memcpy(bufStart, in, count * sizeof(T));
+            // Upper bound of the output count, to detect in-place processing
+            delay.begin(in, count, out, (int)(((long long)count * _interp) / _decim) + 1);
 
             while (offset < count) {
                 // Do convolution
+                const T* win = delay.window(offset);
                 if constexpr (std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[outCount++], &buffer[offset], phases.phases[phase], phases.tapsPerPhase);
+                    volk_32f_x2_dot_prod_32f(&out[outCount++], win, phases.phases[phase], phases.tapsPerPhase);
                 }
                 if constexpr (std::is_same_v<T, complex_t> || std::is_same_v<T, stereo_t>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&buffer[offset], phases.phases[phase], phases.tapsPerPhase);
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)win, phases.phases[phase], phases.tapsPerPhase);
                 }
 
                 // Increment phase
@@ -91,13 +90,13 @@ namespace dsp::multirate {
                 phase = phase % _interp;
             }
             offset -= count;
-
-            // Move delay
-            memmove(buffer, &buffer[count], (phases.tapsPerPhase - 1) * sizeof(T));
+            delay.end();
 
             return outCount;
         }
 
+        DEFAULT_FUSABLE_PROC
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -119,8 +118,7 @@ namespace dsp::multirate {
         PolyphaseBank<float> phases;
         int phase = 0;
         int offset = 0;
-        T* buffer;
-        T* bufStart;
+        buffer::DelayLine<T> delay;
 
     };
 }
\ No newline at end of file
@@ -66,6 +66,8 @@ namespace dsp::multirate {
             return count;
         }
 
+        DEFAULT_FUSABLE_PROC
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
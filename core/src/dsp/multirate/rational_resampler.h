@@ -7,6 +7,7 @@
 #include "polyphase_resampler.h"
 #include "power_decimator.h"
 #include "../taps/low_pass.h"
+#include "../taps/tap_cache.h"
 #include "../window/nuttall.h"
 
 namespace dsp::multirate {
@@ -103,6 +104,8 @@ namespace dsp::multirate {
             return count;
         }
 
+        DEFAULT_FUSABLE_PROC
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -163,8 +166,7 @@ namespace dsp::multirate {
             double tapBandwidth = std::min<double>(_inSamplerate, _outSamplerate) / 2.0;
             double tapTransWidth = tapBandwidth * 0.1;
             taps::free(rtaps);
-            rtaps = taps::lowPass(tapBandwidth, tapTransWidth, tapSamplerate);
-            for (int i = 0; i < rtaps.size; i++) { rtaps.taps[i] *= (float)interp; }
+            rtaps = taps::cache::lowPass(tapBandwidth, tapTransWidth, tapSamplerate, false, interp);
             resamp.setRatio(interp, decim, rtaps);
 
 //            printf("[Resamp] predec: %d, interp: %d, decim: %d, inacc: %lf%%, taps: %d\n", predecRatio, interp, decim, error, rtaps.size);
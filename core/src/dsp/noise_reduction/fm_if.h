@@ -76,6 +76,8 @@ namespace dsp::noise_reduction {
             return count;
         }
 
+        DEFAULT_FUSABLE_PROC
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -1,5 +1,6 @@
 #pragma once
 #include "../processor.h"
+#include <volk/volk.h>
 
 namespace dsp::noise_reduction {
     class NoiseBlanker : public Processor<complex_t, complex_t> {
@@ -9,10 +10,17 @@ namespace dsp::noise_reduction {
 
         NoiseBlanker(stream<complex_t>* in, double rate, double level) { init(in, rate, level); }
 
+        ~NoiseBlanker() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(gainBuf);
+        }
+
         void init(stream<complex_t>* in, double rate, double level) {
             _rate = rate;
             _invRate = 1.0f - _rate;
             _level = level;
+            if (!gainBuf) { gainBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE); }
             base_type::init(in);
         }
 
@@ -36,26 +44,33 @@ namespace dsp::noise_reduction {
         }
 
         inline int process(int count, complex_t* in, complex_t* out) {
-            for (int i = 0; i < count; i++) {
-                // Get signal amplitude
-                float inAmp = in[i].amplitude();
-
-                // Update average amplitude
-                float gain = 1.0f;
-                if (inAmp != 0.0f) {
-                    amp = (amp * _invRate) + (inAmp * _rate);
-                    float excess = inAmp / amp;
-                    if (excess > _level) {
-                        gain = 1.0f / excess;
+            for (int done = 0; done < count;) {
+                int n = std::min<int>(count - done, STREAM_BUFFER_SIZE);
+
+                // Get signal amplitudes
+                volk_32fc_magnitude_32f(gainBuf, (lv_32fc_t*)&in[done], n);
+
+                // Update average amplitude and turn each amplitude into its gain, in place
+                for (int i = 0; i < n; i++) {
+                    float inAmp = gainBuf[i];
+                    float gain = 1.0f;
+                    if (inAmp != 0.0f) {
+                        amp = (amp * _invRate) + (inAmp * _rate);
+                        float excess = inAmp / amp;
+                        gain = (excess > _level) ? (1.0f / excess) : 1.0f;
                     }
+                    gainBuf[i] = gain;
                 }
-                
+
                 // Scale output by gain
-                out[i] = in[i] * gain;
+                volk_32fc_32f_multiply_32fc((lv_32fc_t*)&out[done], (lv_32fc_t*)&in[done], gainBuf, n);
+                done += n;
             }
             return count;
         }
 
+        DEFAULT_FUSABLE_PROC
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -73,6 +88,7 @@ namespace dsp::noise_reduction {
         float _level;
 
         float amp = 1.0;
+        float* gainBuf = NULL;
 
     };
 }
\ No newline at end of file
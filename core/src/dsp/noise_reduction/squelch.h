@@ -70,6 +70,8 @@ namespace dsp::noise_reduction {
 
         //DEFAULT_PROC_RUN();
 
+        DEFAULT_FUSABLE_PROC
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -38,10 +38,24 @@
 #define DEFAULT_PROC_RUN            OVERRIDE_PROC_RUN(process(count, base_type::_in->readBuf, base_type::out.writeBuf))
 #define DEFAULT_MULTIRATE_PROC_RUN  OVERRIDE_MULTIRATE_PROC_RUN(process(count, base_type::_in->readBuf, base_type::out.writeBuf))
 
+// These macros declare a block as fusable, meaning that a FusedExecutor can call its process function
+// inline instead of running the block on its own thread. The expression must return the output count.
+
+#define OVERRIDE_FUSABLE_PROC(exp)\
+    bool isFusable() { return true; }\
+    int processFused(int count, typename base_type::input_type* in, typename base_type::output_type* out) {\
+        return exp;\
+    }
+
+#define DEFAULT_FUSABLE_PROC        OVERRIDE_FUSABLE_PROC(process(count, in, out))
+
 namespace dsp {
     template <class I, class O>
     class Processor : public block {
     public:
+        using input_type = I;
+        using output_type = O;
+
         Processor() {
             out.origin = "process.out";
         }
@@ -99,9 +113,23 @@ namespace dsp {
 
         virtual int run() = 0;
 
+        // Whether the block can be run inline by a FusedExecutor, see OVERRIDE_FUSABLE_PROC
+        virtual bool isFusable() { return false; }
+
+        // Fusable blocks follow the standard run() pattern, so they can also go to the pooled scheduler
+        bool isPoolable() override { return isFusable(); }
+
+        // Process a buffer on the calling thread, serialized with the block's control functions
+        int processInline(int count, I* in, O* out) {
+            std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+            return processFused(count, in, out);
+        }
+
         stream<O> out = "processor.out";
 
     protected:
+        virtual int processFused(int count, I* in, O* out) { return -1; }
+
         stream<I>* _in;
     };
 }
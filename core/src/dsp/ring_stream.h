@@ -0,0 +1,234 @@
+#pragma once
+#include <thread>
+#include <vector>
+#include "stream.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace dsp {
+    inline void cpuRelax() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+#endif
+    }
+
+    // Lock-free single-producer/single-consumer stream.
+    //
+    // Keeps the writeBuf/swap/read/flush contract of dsp::stream but is backed by a ring
+    // of `depth` buffers instead of a single double-buffer. The writer only blocks when all
+    // slots are still held by the reader, so neighbouring blocks no longer run in lockstep.
+    // Waiting is adaptive: spin a little, then yield, then park on a condition variable.
+    // Since it is a dsp::stream<T>, it can be passed anywhere a stream pointer is expected
+    // (setInput(), Splitter::bindStream(), ...).
+    template <class T>
+    class ring_stream : public stream<T> {
+        using base_type = stream<T>;
+    public:
+        ring_stream(int depth = 4) {
+            init(depth);
+        }
+
+        ring_stream(const char* origin, int depth = 4) : ring_stream(depth) {
+            this->origin = origin;
+        }
+
+        ~ring_stream() {
+            freeExtraSlots();
+        }
+
+        void setBufferSize(int samples) override {
+            freeExtraSlots();
+            base_type::setBufferSize(samples);
+            bufferSize = samples;
+            allocSlots();
+        }
+
+        bool swap(int size) override {
+            if (writerStop) { return false; }
+            uint64_t w = writeIdx.load(std::memory_order_relaxed);
+            sizes[w % slots.size()] = size;
+
+            // Publish the block to the reader
+            writeIdx.store(w + 1, std::memory_order_seq_cst);
+            wake(readerParked, rdyMtx, rdyCV);
+            base_type::notifyReader();
+
+            // Wait for the next slot to be released by the reader
+            uint64_t waited = waitFor(writerSpin, writerParked, swapMtx, swapCV, [this, w] {
+                return (w + 1 - readIdx) < slots.size() || writerStop;
+            });
+            if (waited) { stats::chargeOutputWait(waited); }
+            if (writerStop) { return false; }
+
+            base_type::writeBuf = slots[(w + 1) % slots.size()];
+            return true;
+        }
+
+        int read() override {
+            uint64_t waited = waitFor(readerSpin, readerParked, rdyMtx, rdyCV, [this] {
+                return readIdx.load(std::memory_order_relaxed) < writeIdx || readerStop;
+            });
+            if (waited) { stats::chargeInputWait(waited); }
+            if (readerStop) { return -1; }
+
+            uint64_t r = readIdx.load(std::memory_order_relaxed);
+            base_type::readBuf = slots[r % slots.size()];
+            holding = true;
+            int rv = sizes[r % slots.size()];
+            if (base_type::debugTraffic) {
+                flog::info("reading ring stream {}: return {} samples", base_type::origin, rv);
+            }
+            return rv;
+        }
+
+        bool isDataReady() override {
+            return readIdx.load(std::memory_order_relaxed) < writeIdx.load(std::memory_order_acquire);
+        }
+
+        void flush() override {
+            // Flushing without a block held (eg. after a failed read) is a no-op, same as stream
+            if (!holding) { return; }
+            holding = false;
+            readIdx.fetch_add(1, std::memory_order_seq_cst);
+            wake(writerParked, swapMtx, swapCV);
+            base_type::notifyWriter();
+        }
+
+        // A swap won't block if the slot after the one being written is free
+        bool canWrite() override {
+            return (writeIdx.load(std::memory_order_relaxed) + 1 - readIdx.load(std::memory_order_acquire)) < slots.size();
+        }
+
+        void stopWriter() override {
+            writerStop.store(true, std::memory_order_seq_cst);
+            std::lock_guard<std::mutex> lck(swapMtx);
+            swapCV.notify_all();
+        }
+
+        void clearWriteStop() override {
+            writerStop.store(false);
+        }
+
+        void stopReader() override {
+            readerStop.store(true, std::memory_order_seq_cst);
+            std::lock_guard<std::mutex> lck(rdyMtx);
+            rdyCV.notify_all();
+        }
+
+        void clearReadStop() override {
+            readerStop.store(false);
+        }
+
+        // Number of blocks written but not yet released by the reader
+        int backlog() {
+            return (int)(writeIdx.load(std::memory_order_acquire) - readIdx.load(std::memory_order_acquire));
+        }
+
+        int depth() {
+            return slots.size();
+        }
+
+    private:
+        void init(int depth) {
+            if (depth < 2) { depth = 2; }
+            slotCount = depth;
+            allocSlots();
+        }
+
+        // Slot 0 and 1 are the buffers allocated by stream itself, only the extra ones are owned here
+        void allocSlots() {
+            slots.clear();
+            slots.push_back(base_type::writeBuf0);
+            slots.push_back(base_type::readBuf0);
+            for (int i = 2; i < slotCount; i++) {
+                T* buf = buffer::alloc<T>(bufferSize);
+                if (!buf) { abort(); }
+                slots.push_back(buf);
+            }
+            sizes.assign(slotCount, 0);
+            writeIdx = 0;
+            readIdx = 0;
+            holding = false;
+            base_type::writeBuf = slots[0];
+            base_type::readBuf = slots[1];
+        }
+
+        void freeExtraSlots() {
+            for (int i = 2; i < slots.size(); i++) {
+                buffer::free(slots[i]);
+            }
+            slots.resize(std::min<int>(slots.size(), 2));
+        }
+
+        // The predicates use seq_cst loads so that they pair with wake(), a waiter that
+        // published `parked` either sees the new index or gets notified.
+        // Returns the time spent waiting in nanoseconds, 0 if the predicate already held.
+        template <class Pred>
+        uint64_t waitFor(int& spinLimit, std::atomic_bool& parked, std::mutex& mtx, std::condition_variable& cv, Pred pred) {
+            if (pred()) { return 0; }
+            uint64_t start = stats::nowNs();
+
+            // Spin, the budget grows when spinning pays off and shrinks when we end up parking
+            for (int i = 0; i < spinLimit; i++) {
+                if (pred()) {
+                    if (spinLimit < MAX_SPIN && i > spinLimit / 2) { spinLimit += spinLimit / 8 + 1; }
+                    return stats::nowNs() - start;
+                }
+                cpuRelax();
+            }
+            if (spinLimit > MIN_SPIN) { spinLimit -= spinLimit / 4; }
+            for (int i = 0; i < YIELD_COUNT; i++) {
+                if (pred()) { return stats::nowNs() - start; }
+                std::this_thread::yield();
+            }
+
+            // Park
+            std::unique_lock<std::mutex> lck(mtx);
+            parked.store(true, std::memory_order_seq_cst);
+            cv.wait(lck, pred);
+            parked.store(false, std::memory_order_relaxed);
+            return stats::nowNs() - start;
+        }
+
+        // Spinning is pointless when the other side can't be running at the same time
+        static int initialSpin() {
+            return (std::thread::hardware_concurrency() > 1) ? 64 : 0;
+        }
+
+        static void wake(std::atomic_bool& parked, std::mutex& mtx, std::condition_variable& cv) {
+            if (!parked.load(std::memory_order_seq_cst)) { return; }
+            { std::lock_guard<std::mutex> lck(mtx); }
+            cv.notify_one();
+        }
+
+        static constexpr int MIN_SPIN = 8;
+        static constexpr int MAX_SPIN = 1024;
+        static constexpr int YIELD_COUNT = 4;
+
+        int slotCount;
+        int bufferSize = STREAM_BUFFER_SIZE;
+        std::vector<T*> slots;
+        std::vector<int> sizes;
+
+        // Each of these is only touched by either the writer or the reader
+        bool holding = false;
+        int writerSpin = initialSpin();
+        int readerSpin = initialSpin();
+
+        std::atomic<uint64_t> writeIdx = 0;
+        std::atomic<uint64_t> readIdx = 0;
+        std::atomic_bool writerStop = false;
+        std::atomic_bool readerStop = false;
+
+        std::atomic_bool writerParked = false;
+        std::atomic_bool readerParked = false;
+        std::mutex swapMtx;
+        std::condition_variable swapCV;
+        std::mutex rdyMtx;
+        std::condition_variable rdyCV;
+    };
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "../sink.h"
+#include "../shared_stream.h"
 
 namespace dsp::routing {
     template <class T>
@@ -24,6 +25,7 @@ namespace dsp::routing {
             base_type::tempStop();
             base_type::registerOutput(stream);
             streams.push_back(stream);
+            updateSharedStreams();
             base_type::tempStart();
         }
 
@@ -41,11 +43,16 @@ namespace dsp::routing {
                 throw std::runtime_error("[Splitter] Tried to unbind stream to that isn't bound");
             }
 
-            // Add to the list
+            // Remove from the list
             base_type::tempStop();
             streams.erase(sit);
             base_type::unregisterOutput(stream);
+            updateSharedStreams();
             base_type::tempStart();
+
+            // Don't keep references to our buffers around
+            auto shared = dynamic_cast<shared_stream<T>*>(stream);
+            if (shared) { shared->clear(); }
         }
 
         std::function<void(T*, int)> hook;
@@ -54,6 +61,8 @@ namespace dsp::routing {
             this->hook = _hook;
         }
 
+        bool isPoolable() override { return true; }
+
         long long workedCount = 0; // this is to enable cascade stop Reader.
 
         int run() {
@@ -71,7 +80,18 @@ namespace dsp::routing {
 
             workedCount += count;
 
-            for (const auto& stream : streams) {
+            // All shared streams get the same block, copied only once
+            if (!sharedStreams.empty()) {
+                auto blk = pool->copy(base_type::_in->readBuf, count);
+                for (const auto& stream : sharedStreams) {
+                    if (!stream->publish(blk)) {
+                        base_type::_in->flush();
+                        return -1;
+                    }
+                }
+            }
+
+            for (const auto& stream : plainStreams) {
                 memcpy(stream->writeBuf, base_type::_in->readBuf, count * sizeof(T));
 //                flog::info("Splitter {} flushing to {}", origin, stream->origin);
                 if (!stream->swap(count)) {
@@ -92,7 +112,24 @@ namespace dsp::routing {
         }
 
     protected:
+        void updateSharedStreams() {
+            plainStreams.clear();
+            sharedStreams.clear();
+            for (const auto& stream : streams) {
+                auto shared = dynamic_cast<shared_stream<T>*>(stream);
+                if (shared) {
+                    sharedStreams.push_back(shared);
+                }
+                else {
+                    plainStreams.push_back(stream);
+                }
+            }
+        }
+
         std::vector<stream<T>*> streams;
+        std::vector<stream<T>*> plainStreams;
+        std::vector<shared_stream<T>*> sharedStreams;
+        std::shared_ptr<shared_buffer_pool<T>> pool = shared_buffer_pool<T>::create();
 
     };
 }
\ No newline at end of file
@@ -0,0 +1,268 @@
+#include "scheduler.h"
+#include "block.h"
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_set>
+#include <condition_variable>
+#include <utils/flog.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace dsp::scheduler {
+    enum State {
+        IDLE,
+        QUEUED,
+        RUNNING,
+        RUNNING_NOTIFIED
+    };
+
+    struct Worker {
+        std::mutex mtx;
+        std::deque<block*> tasks;
+    };
+
+    struct Pool {
+        std::vector<Worker*> workers;
+
+        // Protects the set of attached blocks, held shared by everything that dereferences a block
+        std::shared_mutex registryMtx;
+        std::unordered_set<block*> registered;
+
+        std::atomic_int pending = 0;
+        std::atomic_int sleeping = 0;
+        std::atomic_uint nextWorker = 0;
+        std::mutex idleMtx;
+        std::condition_variable idleCV;
+    };
+
+    static Config activeConfig;
+
+    // Never freed, the workers live as long as the process
+    static Pool* pool = NULL;
+    static thread_local int workerId = -1;
+
+    static void push(block* blk) {
+        // Keep tasks spawned by a worker local to it, they're likely to share cache with what just ran
+        int id = (workerId >= 0) ? workerId : (pool->nextWorker++ % pool->workers.size());
+        {
+            std::lock_guard<std::mutex> lck(pool->workers[id]->mtx);
+            pool->workers[id]->tasks.push_back(blk);
+        }
+        pool->pending++;
+        if (pool->sleeping.load()) {
+            { std::lock_guard<std::mutex> lck(pool->idleMtx); }
+            pool->idleCV.notify_one();
+        }
+    }
+
+    static block* pop(int id) {
+        // Own queue first (LIFO), then steal the oldest task from the others
+        {
+            Worker* w = pool->workers[id];
+            std::lock_guard<std::mutex> lck(w->mtx);
+            if (!w->tasks.empty()) {
+                block* blk = w->tasks.back();
+                w->tasks.pop_back();
+                pool->pending--;
+                return blk;
+            }
+        }
+        int count = pool->workers.size();
+        for (int i = 1; i < count; i++) {
+            Worker* w = pool->workers[(id + i) % count];
+            std::lock_guard<std::mutex> lck(w->mtx);
+            if (!w->tasks.empty()) {
+                block* blk = w->tasks.front();
+                w->tasks.pop_front();
+                pool->pending--;
+                return blk;
+            }
+        }
+        return NULL;
+    }
+
+    static void execute(block* blk) {
+        {
+            std::shared_lock<std::shared_mutex> lck(pool->registryMtx);
+            if (!pool->registered.count(blk)) { return; }
+            int expected = QUEUED;
+            if (!blk->schedState.compare_exchange_strong(expected, RUNNING)) { return; }
+        }
+
+        if (blk->isRunnable()) {
+            stats::setCurrentBlock(&blk->counters);
+            blk->measuredRun();
+            stats::setCurrentBlock(NULL);
+        }
+
+        std::shared_lock<std::shared_mutex> lck(pool->registryMtx);
+        while (true) {
+            // Block was removed while running, remove() is waiting for us to leave RUNNING
+            if (!pool->registered.count(blk)) {
+                blk->schedState = IDLE;
+                return;
+            }
+
+            // Requeue instead of looping so that other blocks get their turn
+            if (blk->isRunnable()) {
+                blk->schedState = QUEUED;
+                push(blk);
+                return;
+            }
+
+            int expected = RUNNING;
+            if (blk->schedState.compare_exchange_strong(expected, IDLE)) { return; }
+
+            // Got notified while running, check again
+            blk->schedState = RUNNING;
+        }
+    }
+
+    static void workerLoop(int id) {
+        workerId = id;
+        SetThreadName("dsp_pool:" + std::to_string(id));
+
+        const auto& affinity = activeConfig.cpuAffinity;
+        if (!affinity.empty()) {
+            int cpu = affinity[id % affinity.size()];
+#if defined(_WIN32)
+            SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+#elif defined(__linux__) && !defined(__ANDROID__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+        }
+
+        while (true) {
+            block* blk = pop(id);
+            if (blk) {
+                execute(blk);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lck(pool->idleMtx);
+            pool->sleeping++;
+            pool->idleCV.wait(lck, [] { return pool->pending.load() > 0; });
+            pool->sleeping--;
+        }
+    }
+
+    void configure(const Config& config) {
+        if (pool) {
+            flog::warn("DSP scheduler already configured, ignoring new configuration");
+            return;
+        }
+        activeConfig = config;
+        if (!config.enabled) { return; }
+
+        pool = new Pool();
+        int count = config.workers;
+        if (count <= 0) { count = std::max<int>(1, std::thread::hardware_concurrency()); }
+
+        for (int i = 0; i < count; i++) {
+            pool->workers.push_back(new Worker());
+        }
+        for (int i = 0; i < count; i++) {
+            std::thread(workerLoop, i).detach();
+        }
+        flog::info("DSP scheduler started with {} workers", count);
+    }
+
+    bool isEnabled() {
+        return pool != NULL;
+    }
+
+    void add(block* blk) {
+        {
+            std::unique_lock<std::shared_mutex> lck(pool->registryMtx);
+            pool->registered.insert(blk);
+            blk->schedState = IDLE;
+            for (auto& in : blk->inputs) {
+                if (in) { in->readerBlock = blk; }
+            }
+            for (auto& out : blk->outputs) {
+                out->writerBlock = blk;
+            }
+        }
+
+        // Data may already be waiting
+        std::shared_lock<std::shared_mutex> lck(pool->registryMtx);
+        int expected = IDLE;
+        if (blk->isRunnable() && blk->schedState.compare_exchange_strong(expected, QUEUED)) {
+            push(blk);
+        }
+    }
+
+    void remove(block* blk) {
+        {
+            std::unique_lock<std::shared_mutex> lck(pool->registryMtx);
+            pool->registered.erase(blk);
+            for (auto& in : blk->inputs) {
+                if (in && in->readerBlock == blk) { in->readerBlock = NULL; }
+            }
+            for (auto& out : blk->outputs) {
+                if (out->writerBlock == blk) { out->writerBlock = NULL; }
+            }
+        }
+
+        // Wait for a run() in progress to complete. It can't block since it only gets called when runnable
+        while (blk->schedState == RUNNING || blk->schedState == RUNNING_NOTIFIED) {
+            std::this_thread::yield();
+        }
+
+        // Drop stale queue entries
+        std::unique_lock<std::shared_mutex> lck(pool->registryMtx);
+        for (auto& w : pool->workers) {
+            std::lock_guard<std::mutex> lck2(w->mtx);
+            auto it = std::remove(w->tasks.begin(), w->tasks.end(), blk);
+            pool->pending -= std::distance(it, w->tasks.end());
+            w->tasks.erase(it, w->tasks.end());
+        }
+        blk->schedState = IDLE;
+    }
+
+    void notify(untyped_stream* stream, bool reader) {
+        if (!pool) { return; }
+        std::shared_lock<std::shared_mutex> lck(pool->registryMtx);
+        block* blk = reader ? stream->readerBlock.load() : stream->writerBlock.load();
+        if (!blk || !pool->registered.count(blk) || !blk->isRunnable()) { return; }
+
+        int state = blk->schedState.load();
+        while (true) {
+            if (state == IDLE) {
+                if (blk->schedState.compare_exchange_weak(state, QUEUED)) {
+                    push(blk);
+                    return;
+                }
+            }
+            else if (state == RUNNING) {
+                if (blk->schedState.compare_exchange_weak(state, RUNNING_NOTIFIED)) { return; }
+            }
+            else {
+                return;
+            }
+        }
+    }
+
+    void applyRealtimePriority() {
+        int prio = activeConfig.rtPriority;
+        if (prio <= 0) { return; }
+#if defined(_WIN32)
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#else
+        sched_param param;
+        param.sched_priority = std::min<int>(prio, sched_get_priority_max(SCHED_FIFO));
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) {
+            flog::warn("Could not set realtime priority {} for {}", prio, GetThreadName());
+        }
+#endif
+    }
+}
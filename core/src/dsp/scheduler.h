@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+
+namespace dsp {
+    class block;
+    class untyped_stream;
+
+    // Pooled block scheduler.
+    //
+    // Instead of one thread per block, poolable blocks are run as tasks on a fixed set of worker
+    // threads with work stealing. A block is only queued once all of its inputs have data and all
+    // of its outputs can be swapped, so its run() never blocks a worker. Blocks that are not
+    // poolable, or marked realtime, keep their dedicated thread.
+    namespace scheduler {
+        struct Config {
+            bool enabled = false;
+            int workers = 0; // 0 means one per core
+            std::vector<int> cpuAffinity;
+            int rtPriority = 0; // 0 means don't change the priority of realtime threads
+        };
+
+        // Must be called before any block is started
+        void configure(const Config& config);
+        bool isEnabled();
+
+        void add(block* blk);
+        void remove(block* blk);
+        void notify(untyped_stream* stream, bool reader);
+
+        // Give the calling thread realtime priority, if configured
+        void applyRealtimePriority();
+    }
+}
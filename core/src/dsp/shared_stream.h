@@ -0,0 +1,256 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <vector>
+#include "stream.h"
+
+namespace dsp {
+    // Immutable block of samples, shared by every reader it was published to
+    template <class T>
+    struct shared_buffer {
+        T* data;
+        int size;
+    };
+
+    // Recycles the sample buffers of shared_buffer once the last reader released them.
+    // Buffers are sized to the blocks copied into them and at most `maxFree` are kept around,
+    // so a burst of queued blocks doesn't stay allocated once the readers caught up.
+    // Buffers released after the pool is gone are simply freed.
+    template <class T>
+    class shared_buffer_pool : public std::enable_shared_from_this<shared_buffer_pool<T>> {
+    public:
+        static std::shared_ptr<shared_buffer_pool> create(int maxFree = 4) {
+            return std::shared_ptr<shared_buffer_pool>(new shared_buffer_pool(maxFree));
+        }
+
+        ~shared_buffer_pool() {
+            for (auto& fb : freeBufs) { buffer::free(fb.data); }
+        }
+
+        // Copy `count` samples into a pooled buffer
+        std::shared_ptr<const shared_buffer<T>> copy(const T* data, int count) {
+            FreeBuffer fb = { NULL, 0 };
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                for (int i = freeBufs.size() - 1; i >= 0; i--) {
+                    if (freeBufs[i].capacity < count) { continue; }
+                    fb = freeBufs[i];
+                    freeBufs.erase(freeBufs.begin() + i);
+                    break;
+                }
+            }
+            if (!fb.data) {
+                fb.capacity = std::max<int>(count, 1);
+                fb.data = buffer::alloc<T>(fb.capacity);
+                if (!fb.data) { abort(); }
+            }
+            memcpy(fb.data, data, count * sizeof(T));
+
+            std::weak_ptr<shared_buffer_pool> owner = this->shared_from_this();
+            int capacity = fb.capacity;
+            return std::shared_ptr<const shared_buffer<T>>(new shared_buffer<T>{ fb.data, count }, [owner, capacity](const shared_buffer<T>* sb) {
+                auto pool = owner.lock();
+                if (!pool || !pool->recycle(sb->data, capacity)) {
+                    buffer::free(sb->data);
+                }
+                delete sb;
+            });
+        }
+
+    private:
+        struct FreeBuffer {
+            T* data;
+            int capacity;
+        };
+
+        shared_buffer_pool(int maxFree) {
+            _maxFree = std::max<int>(maxFree, 1);
+        }
+
+        bool recycle(T* data, int capacity) {
+            std::lock_guard<std::mutex> lck(mtx);
+            if ((int)freeBufs.size() >= _maxFree) { return false; }
+            freeBufs.push_back({ data, capacity });
+            return true;
+        }
+
+        std::mutex mtx;
+        std::vector<FreeBuffer> freeBufs;
+        int _maxFree;
+    };
+
+    enum DropPolicy {
+        DROP_POLICY_BLOCK,  // The writer waits for the reader, same as dsp::stream
+        DROP_POLICY_OLDEST, // Discard the oldest queued block
+        DROP_POLICY_NEWEST  // Discard the block being published
+    };
+
+    // Stream whose reader gets refcounted shared_buffer blocks instead of its own copy.
+    //
+    // A writer that fans out to several readers (see routing::Splitter) copies its data once
+    // and publishes the same block to all of them. Each reader queues up to `backlog` blocks,
+    // when full the drop policy decides whether the writer waits or a block is discarded, so
+    // that a slow reader doesn't have to stall the others.
+    // readBuf points into the shared block and must not be modified by the reader.
+    // Plain swap() still works and costs one copy into the stream's own pool.
+    template <class T>
+    class shared_stream : public stream<T> {
+        using base_type = stream<T>;
+    public:
+        shared_stream(int backlog = 4, DropPolicy policy = DROP_POLICY_BLOCK) {
+            _backlog = std::max<int>(backlog, 1);
+            _policy = policy;
+        }
+
+        shared_stream(const char* origin, int backlog = 4, DropPolicy policy = DROP_POLICY_BLOCK) : shared_stream(backlog, policy) {
+            this->origin = origin;
+        }
+
+        void setBacklog(int backlog, DropPolicy policy) {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                _backlog = std::max<int>(backlog, 1);
+                _policy = policy;
+            }
+            writerCV.notify_all();
+        }
+
+        bool publish(const std::shared_ptr<const shared_buffer<T>>& blk) {
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+                if (writerStop) { return false; }
+                if ((int)queue.size() >= _backlog) {
+                    if (_policy == DROP_POLICY_OLDEST) {
+                        droppedSamples += queue.front()->size;
+                        queue.pop_front();
+                        dropped++;
+                    }
+                    else if (_policy == DROP_POLICY_NEWEST) {
+                        droppedSamples += blk->size;
+                        dropped++;
+                        return true;
+                    }
+                    else {
+                        uint64_t waitStart = stats::nowNs();
+                        writerCV.wait(lck, [this] { return (int)queue.size() < _backlog || writerStop; });
+                        stats::chargeOutputWait(stats::nowNs() - waitStart);
+                        if (writerStop) { return false; }
+                    }
+                }
+                queue.push_back(blk);
+            }
+            readerCV.notify_all();
+            base_type::notifyReader();
+            return true;
+        }
+
+        bool swap(int size) override {
+            if (!pool) { pool = shared_buffer_pool<T>::create(); }
+            return publish(pool->copy(base_type::writeBuf, size));
+        }
+
+        int read() override {
+            std::unique_lock<std::mutex> lck(mtx);
+            if (queue.empty() && !readerStop) {
+                uint64_t waitStart = stats::nowNs();
+                readerCV.wait(lck, [this] { return !queue.empty() || readerStop; });
+                stats::chargeInputWait(stats::nowNs() - waitStart);
+            }
+            if (readerStop) { return -1; }
+
+            current = queue.front();
+            queue.pop_front();
+            base_type::readBuf = current->data;
+            if (base_type::debugTraffic) {
+                flog::info("reading shared stream {}: return {} samples", base_type::origin, current->size);
+            }
+            return current->size;
+        }
+
+        void flush() override {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                if (!current) { return; }
+                current.reset();
+                base_type::readBuf = base_type::readBuf0;
+            }
+            writerCV.notify_all();
+            base_type::notifyWriter();
+        }
+
+        bool isDataReady() override {
+            std::lock_guard<std::mutex> lck(mtx);
+            return !queue.empty();
+        }
+
+        bool canWrite() override {
+            std::lock_guard<std::mutex> lck(mtx);
+            return _policy != DROP_POLICY_BLOCK || (int)queue.size() < _backlog;
+        }
+
+        void stopWriter() override {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                writerStop = true;
+            }
+            writerCV.notify_all();
+        }
+
+        void clearWriteStop() override {
+            std::lock_guard<std::mutex> lck(mtx);
+            writerStop = false;
+        }
+
+        void stopReader() override {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                readerStop = true;
+            }
+            readerCV.notify_all();
+        }
+
+        void clearReadStop() override {
+            std::lock_guard<std::mutex> lck(mtx);
+            readerStop = false;
+        }
+
+        // Drop all queued blocks, eg. when the stream gets unbound from its writer
+        void clear() {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                queue.clear();
+            }
+            writerCV.notify_all();
+        }
+
+        int backlog() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return queue.size();
+        }
+
+        // Number of blocks discarded by the drop policy since creation
+        uint64_t getDropped() {
+            return dropped;
+        }
+
+        // Number of samples in those blocks
+        uint64_t getDroppedSamples() {
+            return droppedSamples;
+        }
+
+    private:
+        std::mutex mtx;
+        std::condition_variable readerCV;
+        std::condition_variable writerCV;
+        std::deque<std::shared_ptr<const shared_buffer<T>>> queue;
+        std::shared_ptr<const shared_buffer<T>> current;
+        std::shared_ptr<shared_buffer_pool<T>> pool;
+
+        int _backlog;
+        DropPolicy _policy;
+        bool readerStop = false;
+        bool writerStop = false;
+        std::atomic<uint64_t> dropped = 0;
+        std::atomic<uint64_t> droppedSamples = 0;
+    };
+}
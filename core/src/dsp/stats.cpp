@@ -0,0 +1,114 @@
+#include "stats.h"
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+#include <json.hpp>
+
+using nlohmann::json;
+
+namespace dsp::stats {
+    struct Entry {
+        std::string name;
+        uintptr_t id;
+    };
+
+    static std::mutex registryMtx;
+    static std::unordered_map<BlockCounters*, Entry> registry;
+    static thread_local BlockCounters* current = NULL;
+
+    BlockCounters* currentBlock() {
+        return current;
+    }
+
+    void setCurrentBlock(BlockCounters* counters) {
+        current = counters;
+    }
+
+    void registerBlock(BlockCounters* counters, const std::string& name, const void* id) {
+        std::lock_guard<std::mutex> lck(registryMtx);
+        registry[counters] = Entry{ name, (uintptr_t)id };
+    }
+
+    void unregisterBlock(BlockCounters* counters) {
+        std::lock_guard<std::mutex> lck(registryMtx);
+        registry.erase(counters);
+    }
+
+    std::vector<BlockSnapshot> snapshot() {
+        std::vector<BlockSnapshot> snaps;
+        std::lock_guard<std::mutex> lck(registryMtx);
+        snaps.reserve(registry.size());
+        for (auto& [c, e] : registry) {
+            BlockSnapshot s;
+            s.name = e.name;
+            s.id = e.id;
+            s.runs = c->runs.load(std::memory_order_relaxed);
+            s.samples = c->samples.load(std::memory_order_relaxed);
+            s.busyNs = c->busyNs.load(std::memory_order_relaxed);
+            s.inputWaitNs = c->inputWaitNs.load(std::memory_order_relaxed);
+            s.outputWaitNs = c->outputWaitNs.load(std::memory_order_relaxed);
+            snaps.push_back(s);
+        }
+        return snaps;
+    }
+
+    std::string toJson(size_t maxSize) {
+        auto snaps = snapshot();
+        std::sort(snaps.begin(), snaps.end(), [](const BlockSnapshot& a, const BlockSnapshot& b) { return a.busyNs > b.busyNs; });
+
+        json j;
+        j["timestampNs"] = nowNs();
+        j["blocks"] = json::array();
+        for (const auto& s : snaps) {
+            json b;
+            b["name"] = s.name;
+            b["id"] = s.id;
+            b["runs"] = s.runs;
+            b["samples"] = s.samples;
+            b["busyNs"] = s.busyNs;
+            b["inputWaitNs"] = s.inputWaitNs;
+            b["outputWaitNs"] = s.outputWaitNs;
+            j["blocks"].push_back(b);
+        }
+        std::string out = j.dump();
+
+        // Drop whole entries rather than ever cutting the document
+        size_t omitted = 0;
+        while (maxSize && out.size() > maxSize && !j["blocks"].empty()) {
+            j["blocks"].erase(j["blocks"].size() - 1);
+            j["omitted"] = ++omitted;
+            out = j.dump();
+        }
+        return out;
+    }
+
+    const std::vector<BlockRates>& RateMeter::update() {
+        uint64_t now = nowNs();
+        if (now - lastTime < periodNs) { return rates; }
+
+        auto snaps = snapshot();
+        std::unordered_map<uintptr_t, const BlockSnapshot*> prev;
+        for (const auto& s : last) { prev[s.id] = &s; }
+
+        // Blocks that just started only show up on the next update
+        rates.clear();
+        double elapsed = (double)(now - lastTime);
+        for (const auto& s : snaps) {
+            auto it = prev.find(s.id);
+            if (it == prev.end() || !lastTime) { continue; }
+            const BlockSnapshot* p = it->second;
+            BlockRates r;
+            r.name = s.name;
+            r.id = s.id;
+            r.samplerate = (double)(s.samples - p->samples) * 1e9 / elapsed;
+            r.busy = (double)(s.busyNs - p->busyNs) / elapsed;
+            r.inputWait = (double)(s.inputWaitNs - p->inputWaitNs) / elapsed;
+            r.outputWait = (double)(s.outputWaitNs - p->outputWaitNs) / elapsed;
+            rates.push_back(r);
+        }
+
+        last = std::move(snaps);
+        lastTime = now;
+        return rates;
+    }
+}
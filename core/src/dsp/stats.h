@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace dsp {
+    // Per-block runtime statistics.
+    //
+    // Every running block owns a set of counters that its worker updates with relaxed atomics,
+    // time spent blocked in a stream read or swap is charged to the block running on the calling
+    // thread. Readers take snapshots and derive rates from the difference between two of them.
+    namespace stats {
+        struct BlockCounters {
+            std::atomic<uint64_t> runs = 0;
+            std::atomic<uint64_t> samples = 0;
+            std::atomic<uint64_t> busyNs = 0;
+            std::atomic<uint64_t> inputWaitNs = 0;
+            std::atomic<uint64_t> outputWaitNs = 0;
+        };
+
+        struct BlockSnapshot {
+            std::string name;
+            uintptr_t id;
+            uint64_t runs;
+            uint64_t samples;
+            uint64_t busyNs;
+            uint64_t inputWaitNs;
+            uint64_t outputWaitNs;
+        };
+
+        struct BlockRates {
+            std::string name;
+            uintptr_t id;
+            double samplerate;
+            // Fractions of the wall time
+            double busy;
+            double inputWait;
+            double outputWait;
+        };
+
+        inline uint64_t nowNs() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // Counters of the block running on the calling thread, or NULL
+        BlockCounters* currentBlock();
+        void setCurrentBlock(BlockCounters* counters);
+
+        inline void chargeInputWait(uint64_t ns) {
+            BlockCounters* c = currentBlock();
+            if (c) { c->inputWaitNs.fetch_add(ns, std::memory_order_relaxed); }
+        }
+
+        inline void chargeOutputWait(uint64_t ns) {
+            BlockCounters* c = currentBlock();
+            if (c) { c->outputWaitNs.fetch_add(ns, std::memory_order_relaxed); }
+        }
+
+        void registerBlock(BlockCounters* counters, const std::string& name, const void* id);
+        void unregisterBlock(BlockCounters* counters);
+
+        std::vector<BlockSnapshot> snapshot();
+
+        // Cumulative counters of all running blocks as a JSON document. With a size limit, the least busy
+        // blocks are left out until the document fits and "omitted" counts them.
+        std::string toJson(size_t maxSize = 0);
+
+        // Turns successive snapshots into rates, refreshed at most once per period
+        class RateMeter {
+        public:
+            RateMeter(int periodMs = 1000) : periodNs((uint64_t)periodMs * 1000000) {}
+
+            const std::vector<BlockRates>& update();
+
+        private:
+            uint64_t periodNs;
+            uint64_t lastTime = 0;
+            std::vector<BlockSnapshot> last;
+            std::vector<BlockRates> rates;
+        };
+    }
+}
@@ -7,6 +7,8 @@
 #include <condition_variable>
 //#include <volk/volk.h>
 #include "buffer/buffer.h"
+#include "scheduler.h"
+#include "stats.h"
 
 // 1MSample buffer
 #define STREAM_BUFFER_SIZE 1000000
@@ -24,6 +26,21 @@ namespace dsp {
         virtual void clearWriteStop() {}
         virtual void stopReader() {}
         virtual void clearReadStop() {}
+        virtual bool isDataReady() { return false; }
+        virtual bool canWrite() { return true; }
+
+        // Blocks attached to the pooled scheduler, notified whenever the stream becomes readable/writable
+        std::atomic<block*> readerBlock = nullptr;
+        std::atomic<block*> writerBlock = nullptr;
+
+    protected:
+        inline void notifyReader() {
+            if (readerBlock.load(std::memory_order_acquire)) { scheduler::notify(this, true); }
+        }
+
+        inline void notifyWriter() {
+            if (writerBlock.load(std::memory_order_acquire)) { scheduler::notify(this, false); }
+        }
     };
 
 
@@ -86,7 +103,11 @@ namespace dsp {
             {
                 // Wait to either swap or stop
                 std::unique_lock<std::mutex> lck(swapMtx);
-                swapCV.wait(lck, [this] { return (canSwap || writerStop); });
+                if (!canSwap && !writerStop) {
+                    uint64_t waitStart = stats::nowNs();
+                    swapCV.wait(lck, [this] { return (canSwap || writerStop); });
+                    stats::chargeOutputWait(stats::nowNs() - waitStart);
+                }
 
                 // If writer was stopped, abandon operation
                 if (writerStop) { return false; }
@@ -105,6 +126,7 @@ namespace dsp {
                 dataReady = true;
             }
             rdyCV.notify_all();
+            notifyReader();
 
             return true;
         }
@@ -115,7 +137,11 @@ namespace dsp {
 //                flog::info("stream::read:: called on from merger.out..");
 //            }
             std::unique_lock<std::mutex> lck(rdyMtx);
-            rdyCV.wait(lck, [this] { return (dataReady || readerStop); });
+            if (!dataReady && !readerStop) {
+                uint64_t waitStart = stats::nowNs();
+                rdyCV.wait(lck, [this] { return (dataReady || readerStop); });
+                stats::chargeInputWait(stats::nowNs() - waitStart);
+            }
 
 
             auto rv = readerStop ? -1 : dataSize;
@@ -150,6 +176,12 @@ namespace dsp {
             }
 
             swapCV.notify_all();
+            notifyWriter();
+        }
+
+        virtual bool canWrite() {
+            std::lock_guard<std::mutex> lck(swapMtx);
+            return canSwap;
         }
 
         virtual void stopWriter() {
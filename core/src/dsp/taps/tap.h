@@ -1,4 +1,5 @@
 #pragma once
+#include <memory>
 #include <volk/volk.h>
 #include "../buffer/buffer.h"
 
@@ -8,6 +9,10 @@ namespace dsp {
     public:
         T* taps = NULL;
         unsigned int size = 0;
+
+        // Set when the taps are shared (see tap_cache.h). They must then be treated as read-only,
+        // and stay alive as long as any copy of this tap holds them.
+        std::shared_ptr<void> shared;
     };
 
     namespace taps {
@@ -21,6 +26,12 @@ namespace dsp {
 
         template<class T>
         inline void free(tap<T>& taps) {
+            if (taps.shared) {
+                taps.shared.reset();
+                taps.taps = NULL;
+                taps.size = 0;
+                return;
+            }
             if (!taps.taps) { return; }
             buffer::free(taps.taps);
             taps.taps = NULL;
@@ -0,0 +1,122 @@
+#include "tap_cache.h"
+#include "../types.h"
+#include "windowed_sinc.h"
+#include "estimate_tap_count.h"
+#include "../math/hz_to_rads.h"
+#include <assert.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace dsp::taps::cache {
+    enum FilterType {
+        FILTER_TYPE_LOW_PASS,
+        FILTER_TYPE_BAND_PASS
+    };
+
+    // Both filter types use a Nuttall window, the window is implied by the type
+    struct Key {
+        FilterType type;
+        int count;
+        double omega;
+        double modOmega;
+        double gain;
+
+        bool operator==(const Key& b) const {
+            return type == b.type && count == b.count && omega == b.omega && modOmega == b.modOmega && gain == b.gain;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            size_t h = std::hash<int>()(k.type);
+            for (size_t v : { std::hash<int>()(k.count), std::hash<double>()(k.omega), std::hash<double>()(k.modOmega), std::hash<double>()(k.gain) }) {
+                h ^= v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+            }
+            return h;
+        }
+    };
+
+    struct Entry {
+        Key key;
+        tap<float> taps;
+    };
+
+    static std::mutex mtx;
+    static std::list<Entry> lru; // Most recently used first
+    static std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    static size_t capacity = 1 << 22;
+    static size_t totalTaps = 0;
+    static uint64_t hits = 0;
+    static uint64_t misses = 0;
+
+    static void evict() {
+        // Always keep the most recent entry, even if it alone is over capacity
+        while (totalTaps > capacity && lru.size() > 1) {
+            Entry& e = lru.back();
+            totalTaps -= e.taps.size;
+            index.erase(e.key);
+            lru.pop_back();
+        }
+    }
+
+    static tap<float> get(const Key& key) {
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            auto it = index.find(key);
+            if (it != index.end()) {
+                lru.splice(lru.begin(), lru, it->second);
+                hits++;
+                return it->second->taps;
+            }
+            misses++;
+        }
+
+        // Design outside of the lock so other lookups aren't held up by it
+        float* data = buffer::alloc<float>(key.count);
+        nuttallWindowedSinc(data, key.count, key.omega, key.gain, key.type == FILTER_TYPE_BAND_PASS, key.modOmega);
+        tap<float> taps;
+        taps.taps = data;
+        taps.size = key.count;
+        taps.shared = std::shared_ptr<void>(data, buffer::free);
+
+        std::lock_guard<std::mutex> lck(mtx);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            // Designed by another thread in the meantime
+            lru.splice(lru.begin(), lru, it->second);
+            return it->second->taps;
+        }
+        lru.push_front(Entry{ key, taps });
+        index[key] = lru.begin();
+        totalTaps += taps.size;
+        evict();
+        return taps;
+    }
+
+    tap<float> lowPass(double cutoff, double transWidth, double sampleRate, bool oddTapCount, double gain) {
+        int count = estimateTapCount(transWidth, sampleRate);
+        if (oddTapCount && !(count % 2)) { count++; }
+        return get(Key{ FILTER_TYPE_LOW_PASS, count, math::hzToRads(cutoff, sampleRate), 0.0, gain });
+    }
+
+    tap<float> bandPass(double bandStart, double bandStop, double transWidth, double sampleRate, bool oddTapCount) {
+        assert(bandStop > bandStart);
+        int count = estimateTapCount(transWidth, sampleRate);
+        if (oddTapCount && !(count % 2)) { count++; }
+        double omega = math::hzToRads((bandStop - bandStart) / 2.0, sampleRate);
+        double modOmega = math::hzToRads((bandStart + bandStop) / 2.0, sampleRate);
+        return get(Key{ FILTER_TYPE_BAND_PASS, count, omega, modOmega, 1.0 });
+    }
+
+    void setCapacity(size_t maxTaps) {
+        std::lock_guard<std::mutex> lck(mtx);
+        capacity = maxTaps;
+        evict();
+    }
+
+    Stats getStats() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return Stats{ hits, misses, lru.size(), totalTaps };
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "tap.h"
+
+namespace dsp::taps {
+    // Process-wide LRU cache of designed filters.
+    //
+    // Blocks that redesign their filter on every bandwidth or samplerate change (VFOs, resamplers,
+    // demodulators) get back shared, read-only taps, so identical settings share a single array
+    // and repeated settings (slider drags, bookmark hops) skip the design. The returned taps are
+    // released with taps::free() like any other, and stay valid while any copy still holds them,
+    // even after being evicted from the cache.
+    namespace cache {
+        struct Stats {
+            uint64_t hits;
+            uint64_t misses;
+            size_t entries;
+            size_t taps;
+        };
+
+        // Same as taps::lowPass(), with the taps scaled by `gain`
+        tap<float> lowPass(double cutoff, double transWidth, double sampleRate, bool oddTapCount = false, double gain = 1.0);
+
+        // Same as taps::bandPass<float>()
+        tap<float> bandPass(double bandStart, double bandStop, double transWidth, double sampleRate, bool oddTapCount = false);
+
+        // Maximum number of taps kept by the cache across all entries
+        void setCapacity(size_t maxTaps);
+
+        Stats getStats();
+    }
+}
@@ -3,6 +3,7 @@
 #include "../math/sinc.h"
 #include "../math/hz_to_rads.h"
 #include "../window/nuttall.h"
+#include <algorithm>
 
 namespace dsp::taps {
     template<class T, typename Func>
@@ -36,4 +37,49 @@ namespace dsp::taps {
     inline tap<T> windowedSinc(int count, double cutoff, double samplerate, Func window, double norm = 1.0) {
         return windowedSinc<T>(count, math::hzToRads(cutoff, samplerate), window, norm);
     }
+
+    // windowedSinc<float>() with a Nuttall window, multiplied by 2 * cos(modOmega * n) when
+    // `modulate` is set to shift it into a band pass. Instead of a sin/cos call per tap and term, each block of taps
+    // rotates the block's starting angles by a per-offset table (angle addition), which leaves an
+    // inner loop of plain multiply-adds the compiler can vectorize.
+    inline void nuttallWindowedSinc(float* out, int count, double omega, double norm = 1.0, bool modulate = false, double modOmega = 0.0) {
+        const int BLOCK = 64;
+        const double coefs[] = { 0.355768, -0.487396, 0.144232, -0.012604 };
+        double half = (double)count / 2.0;
+        double corr = norm * omega / DB_M_PI;
+        double winStep = 2.0 * DB_M_PI / (double)count;
+
+        // cos/sin of j * step for the sinc, the three window harmonics and the modulation
+        const double steps[5] = { omega, winStep, 2.0 * winStep, 3.0 * winStep, modOmega };
+        double tc[5][BLOCK], ts[5][BLOCK];
+        for (int k = 0; k < 5; k++) {
+            for (int j = 0; j < BLOCK; j++) {
+                tc[k][j] = cos(steps[k] * (double)j);
+                ts[k][j] = sin(steps[k] * (double)j);
+            }
+        }
+
+        double t0 = 0.5 - half;  // sinc time of tap 0
+        double n0 = t0 - half;   // window position of tap 0
+        for (int b = 0; b < count; b += BLOCK) {
+            int m = std::min<int>(BLOCK, count - b);
+            double ac[5], as[5];
+            ac[0] = cos(((double)b + t0) * omega);
+            as[0] = sin(((double)b + t0) * omega);
+            for (int k = 1; k < 5; k++) {
+                ac[k] = cos(((double)b + n0) * steps[k]);
+                as[k] = sin(((double)b + n0) * steps[k]);
+            }
+            for (int j = 0; j < m; j++) {
+                double x = ((double)(b + j) + t0) * omega;
+                double sinx = as[0] * tc[0][j] + ac[0] * ts[0][j];
+                double sinc = (x == 0.0) ? 1.0 : (sinx / x);
+                double win = coefs[0] + coefs[1] * (ac[1] * tc[1][j] - as[1] * ts[1][j])
+                                      + coefs[2] * (ac[2] * tc[2][j] - as[2] * ts[2][j])
+                                      + coefs[3] * (ac[3] * tc[3][j] - as[3] * ts[3][j]);
+                double mod = modulate ? 2.0 * (ac[4] * tc[4][j] - as[4] * ts[4][j]) : 1.0;
+                out[b + j] = sinc * win * mod * corr;
+            }
+        }
+    }
 }
\ No newline at end of file
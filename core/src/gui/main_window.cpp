@@ -1233,6 +1233,33 @@ void MainWindow::drawDebugMenu() {
         ImGui::Checkbox("Show log", &logWindow);
         ImGui::Text("ImGui version: %s", ImGui::GetVersion());
 
+        if (ImGui::TreeNode("DSP blocks")) {
+            const auto& rates = dspRates.update();
+            if (ImGui::BeginTable("dsp_stats_table", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchProp)) {
+                ImGui::TableSetupColumn("Block");
+                ImGui::TableSetupColumn("MS/s");
+                ImGui::TableSetupColumn("Busy");
+                ImGui::TableSetupColumn("Wait in");
+                ImGui::TableSetupColumn("Wait out");
+                ImGui::TableHeadersRow();
+                for (const auto& r : rates) {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextUnformatted(r.name.c_str());
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%.3f", r.samplerate / 1e6);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.1f%%", r.busy * 100.0);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%.1f%%", r.inputWait * 100.0);
+                    ImGui::TableSetColumnIndex(4);
+                    ImGui::Text("%.1f%%", r.outputWait * 100.0);
+                }
+                ImGui::EndTable();
+            }
+            ImGui::TreePop();
+        }
+
         // ImGui::Checkbox("Bypass buffering", &sigpath::iqFrontEnd.inputBuffer.bypass);
 
         // ImGui::Text("Buffering: %d", (sigpath::iqFrontEnd.inputBuffer.writeCur - sigpath::iqFrontEnd.inputBuffer.readCur + 32) % 32);
@@ -100,6 +100,7 @@ protected:
     int tuningMode = tuner::TUNER_MODE_NORMAL;
 
     dsp::stream<dsp::complex_t> dummyStream;
+    dsp::stats::RateMeter dspRates;
     bool demoWindow = false;
     int selectedWindow = 0;
 
@@ -20,6 +20,7 @@ namespace sourcemenu {
 
     bool iqCorrection = false;
     bool invertIQ = false;
+    bool vfoChannelizer = false;
     utils::LatLng operatorLatLng = utils::LatLng::invalid();
     char operatorCallsignRaw[30];
     utils::CTY::Callsign callsignFound;
@@ -183,6 +184,7 @@ namespace sourcemenu {
         std::string selectedOffset = core::configManager.conf["selectedOffset"];
         iqCorrection = core::configManager.conf["iqCorrection"];
         invertIQ = core::configManager.conf["invertIQ"];
+        vfoChannelizer = core::configManager.conf["vfoChannelizer"];
 
         std::string opcs = core::configManager.conf["operatorCallsign"];
         std::copy(opcs.begin(), opcs.end(), operatorCallsignRaw);
@@ -218,6 +220,7 @@ namespace sourcemenu {
         // Update frontend settings
         sigpath::iqFrontEnd.setDCBlocking(iqCorrection);
         sigpath::iqFrontEnd.setInvertIQ(invertIQ);
+        sigpath::iqFrontEnd.setChannelizerEnabled(vfoChannelizer);
         sigpath::iqFrontEnd.setDecimation(decimations.value(decimId));
         selectOffsetByName(selectedOffset);
 
@@ -342,6 +345,13 @@ namespace sourcemenu {
             core::configManager.release(true);
         }
 
+        if (ImGui::Checkbox("Shared VFO channelizer##_sdrpp_vfo_chan", &vfoChannelizer)) {
+            sigpath::iqFrontEnd.setChannelizerEnabled(vfoChannelizer);
+            core::configManager.acquire();
+            core::configManager.conf["vfoChannelizer"] = vfoChannelizer;
+            core::configManager.release(true);
+        }
+
         ImGui::LeftLabel("Offset mode");
         ImGui::SetNextItemWidth(itemWidth - ImGui::GetCursorPosX() - 2.0f*(lineHeight + 1.5f*spacing));
         if (ImGui::Combo("##_sdrpp_offset", &offsetId, offsets.txt)) {
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ImGui {
+    // Lock-free single-producer/single-consumer queue of raw FFT lines.
+    //
+    // The DSP thread writes power spectra straight into a slot (acquire/publish) and never waits
+    // on the render thread. When every slot is still queued, the line goes to a scratch buffer
+    // and is dropped, so a slow frame costs waterfall lines instead of stalling the IQ pipeline.
+    // The render thread drains the queue with front/pop.
+    class FFTLineQueue {
+    public:
+        static const int SLOTS = 64;
+
+        FFTLineQueue() : slots(SLOTS), sizes(SLOTS, 0) {}
+
+        // Producer side. Returns a buffer of at least `size` floats to fill with one line.
+        float* acquire(int size) {
+            uint64_t w = writeIdx.load(std::memory_order_relaxed);
+            full = (w - readIdx.load(std::memory_order_acquire)) >= SLOTS;
+            std::vector<float>& buf = full ? scratch : slots[w % SLOTS];
+            if ((int)buf.size() < size) { buf.resize(size); }
+            pending = size;
+            return buf.data();
+        }
+
+        // Producer side. Hands the line filled after acquire() over to the consumer.
+        void publish() {
+            if (full) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            uint64_t w = writeIdx.load(std::memory_order_relaxed);
+            sizes[w % SLOTS] = pending;
+            writeIdx.store(w + 1, std::memory_order_release);
+        }
+
+        // Consumer side. Returns the oldest queued line, or NULL when the queue is empty.
+        float* front(int& size) {
+            uint64_t r = readIdx.load(std::memory_order_relaxed);
+            if (r == writeIdx.load(std::memory_order_acquire)) { return NULL; }
+            size = sizes[r % SLOTS];
+            return slots[r % SLOTS].data();
+        }
+
+        // Consumer side. Releases the line returned by front().
+        void pop() {
+            readIdx.store(readIdx.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // Number of lines dropped because the consumer fell behind.
+        uint64_t getDropped() {
+            return dropped.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::vector<std::vector<float>> slots;
+        std::vector<int> sizes;
+        std::vector<float> scratch;
+        std::atomic<uint64_t> writeIdx = 0;
+        std::atomic<uint64_t> readIdx = 0;
+        std::atomic<uint64_t> dropped = 0;
+
+        // Producer-only state between acquire() and publish()
+        bool full = false;
+        int pending = 0;
+    };
+}
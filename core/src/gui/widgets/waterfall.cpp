@@ -97,65 +97,6 @@ inline void printAndScale(double freq, char* buf) {
     }
 }
 
-inline void doZoom(int offset, int width, int inSize, int outSize, float* in, float* out) {
-    // NOTE: REMOVE THAT SHIT, IT'S JUST A HACKY FIX
-    if (width > 524288) {
-        width = 524288;
-    }
-    if (offset < 0) {
-        flog::warn("Offset is negative: {}", offset);
-        offset = 0;
-    }
-
-    float factor = (float)width / (float)outSize;
-
-    int sFactor = (int)ceilf(factor);
-    float id = offset;
-    float maxVal, maxVal1, maxVal2, maxVal3, maxVal4, maxVal5, maxVal6, maxVal7, maxVal8, maxVal9, maxVal10, maxVal11, maxVal12, maxVal13, maxVal14, maxVal15;
-    int sId;
-    for (int i = 0; i < outSize; i++) {
-        maxVal = -INFINITY;
-        maxVal1 = -INFINITY;
-        maxVal2 = -INFINITY;
-        maxVal3 = -INFINITY;
-        maxVal4 = -INFINITY;
-        maxVal5 = -INFINITY;
-        maxVal6 = -INFINITY;
-        maxVal7 = -INFINITY;
-        // more than 8 is not worth it
-        sId = (int)id;
-        int uFactor = (sId + sFactor > inSize) ? inSize - sId : sFactor;
-
-        constexpr int N = 8;
-        auto uFactorN = (((int)uFactor) / N) * N;
-        int j;
-        for (j = 0; j < uFactorN; j+=N) {
-            maxVal = std::max<float>(maxVal, in[sId + j]);
-            maxVal1 = std::max<float>(maxVal1, in[sId + j + 1]);
-            maxVal2 = std::max<float>(maxVal2, in[sId + j + 2]);
-            maxVal3 = std::max<float>(maxVal3, in[sId + j + 3]);
-            maxVal4 = std::max<float>(maxVal4, in[sId + j + 4]);
-            maxVal5 = std::max<float>(maxVal5, in[sId + j + 5]);
-            maxVal6 = std::max<float>(maxVal6, in[sId + j + 6]);
-            maxVal7 = std::max<float>(maxVal7, in[sId + j + 7]);
-        }
-        maxVal = std::max<float>(maxVal, maxVal1);
-        maxVal = std::max<float>(maxVal, maxVal2);
-        maxVal = std::max<float>(maxVal, maxVal3);
-        maxVal = std::max<float>(maxVal, maxVal4);
-        maxVal = std::max<float>(maxVal, maxVal5);
-        maxVal = std::max<float>(maxVal, maxVal6);
-        maxVal = std::max<float>(maxVal, maxVal7);
-        for (; j < uFactor; j++) {
-            maxVal = std::max<float>(maxVal, in[sId + j]);
-        }
-
-        out[i] = maxVal;
-        id += factor;
-    }
-}
-
-
 namespace ImGui {
 
     WaterFall::WaterFall() {
@@ -799,7 +740,8 @@ namespace ImGui {
                         auto td = tempdata.data();
                         auto waterfallFbIndexLocal = wfi % totalNumberOfPixels;
                         for (int i = ii; i < ii + cnt; i++) {
-                            doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, &rawFFTs[((i + currentFFTLine) % waterfallHeight) * rawFFTSize], td);
+                            int line = (i + currentFFTLine) % waterfallHeight;
+                            zoomPyramid.zoom(drawDataStart, drawDataSize, dataWidth, &rawFFTs[line * rawFFTSize], &rawFFTPyramids[line * zoomPyramid.size()], td);
                             for (int j = 0; j < dataWidth; j++) {
                                 auto pixel = (std::clamp<float>(td[j], waterfallMin, waterfallMax) - waterfallMin) / dataRange;
                                 if (waterfallFbIndexLocal >= totalNumberOfPixels) {
@@ -979,6 +921,17 @@ namespace ImGui {
         // Nothing to see here...
     }
 
+    // Rotate a ring of `rows` rows so that row `first` becomes row 0
+    static void rotateRows(float* buf, int rowSize, int rows, int first) {
+        if (buf == NULL || rowSize == 0) { return; }
+        float* temp = new float[first * rowSize];
+        int moveCount = rows - first;
+        memcpy(temp, buf, first * rowSize * sizeof(float));
+        memmove(buf, &buf[first * rowSize], moveCount * rowSize * sizeof(float));
+        memcpy(&buf[moveCount * rowSize], temp, first * rowSize * sizeof(float));
+        delete[] temp;
+    }
+
     void WaterFall::onResize() {
         MEASURE_LOCK_GUARD(latestFFTMtx);
         MEASURE_LOCK_GUARD1(smoothingBufMtx);
@@ -1015,18 +968,16 @@ namespace ImGui {
             if (rawFFTs != NULL) {
                 if (currentFFTLine != 0) {
                     //flog::info("onresize: currentFFTLine={} rawFFTSize={}", currentFFTLine, rawFFTSize);
-                    float* tempWF = new float[currentFFTLine * rawFFTSize];
-                    int moveCount = lastWaterfallHeight - currentFFTLine;
-                    memcpy(tempWF, rawFFTs, currentFFTLine * rawFFTSize * sizeof(float));
-                    memmove(rawFFTs, &rawFFTs[currentFFTLine * rawFFTSize], moveCount * rawFFTSize * sizeof(float));
-                    memcpy(&rawFFTs[moveCount * rawFFTSize], tempWF, currentFFTLine * rawFFTSize * sizeof(float));
-                    delete[] tempWF;
+                    rotateRows(rawFFTs, rawFFTSize, lastWaterfallHeight, currentFFTLine);
+                    rotateRows(rawFFTPyramids, zoomPyramid.size(), lastWaterfallHeight, currentFFTLine);
                 }
                 currentFFTLine = 0;
-                rawFFTs = (float*)realloc(rawFFTs, waterfallHeight * rawFFTSize * sizeof(float));
+                rawFFTs = (float*)realloc(rawFFTs, std::max<int>(1, waterfallHeight) * rawFFTSize * sizeof(float));
+                rawFFTPyramids = (float*)realloc(rawFFTPyramids, std::max<int>(1, waterfallHeight * zoomPyramid.size()) * sizeof(float));
             }
             else {
-                rawFFTs = (float*)malloc(waterfallHeight * rawFFTSize * sizeof(float));
+                rawFFTs = (float*)malloc(std::max<int>(1, waterfallHeight) * rawFFTSize * sizeof(float));
+                rawFFTPyramids = (float*)malloc(std::max<int>(1, waterfallHeight * zoomPyramid.size()) * sizeof(float));
             }
             // ==============
         }
@@ -1115,6 +1066,8 @@ namespace ImGui {
             onResize();
         }
 
+        drainFFTQueue();
+
         //window->DrawList->AddRectFilled(widgetPos, widgetEndPos, IM_COL32( 0, 0, 0, 255 ));
         ImU32 bg = ImGui::ColorConvertFloat4ToU32(gui::themeManager.waterfallBg);
         window->DrawList->AddRectFilled(widgetPos, widgetEndPos, bg);
@@ -1166,31 +1119,57 @@ namespace ImGui {
     }
 
     float* WaterFall::getFFTBuffer() {
-        if (rawFFTs == NULL) { return NULL; }
-        MEASURE_LOCK(buf_mtx);
-        if (waterfallVisible && waterfallHeight != 0) {
-            currentFFTLine--;
-            fftLines++;
-            currentFFTLine = ((currentFFTLine + waterfallHeight) % waterfallHeight);
-            fftLines = std::min<float>(fftLines, waterfallHeight);
-            return &rawFFTs[currentFFTLine * rawFFTSize];
-        }
-        return rawFFTs;
+        int size = fftQueueLineSize.load(std::memory_order_relaxed);
+        if (size <= 0) { return NULL; }
+        return fftQueue.acquire(size);
     }
 
-    /**
-     * rawFFTs -> (doZoom) -> lastFFT -> (palletizing) -> waterfallFb[current]
-     */
     void WaterFall::pushFFT() {
+        if (fftQueueLineSize.load(std::memory_order_relaxed) <= 0) { return; }
+        fftQueue.publish();
+    }
+
+    uint64_t WaterFall::getDroppedFFTLines() {
+        return fftQueue.getDropped();
+    }
+
+    // Runs on the render thread with buf_mtx held
+    void WaterFall::drainFFTQueue() {
         if (rawFFTs == NULL) { return; }
         MEASURE_LOCK_GUARD(latestFFTMtx);
+        int size;
+        float* line;
+        while ((line = fftQueue.front(size)) != NULL) {
+            // Lines queued before an FFT size change no longer fit the history
+            if (size == rawFFTSize) {
+                if (waterfallVisible && waterfallHeight != 0) {
+                    currentFFTLine--;
+                    fftLines++;
+                    currentFFTLine = ((currentFFTLine + waterfallHeight) % waterfallHeight);
+                    fftLines = std::min<float>(fftLines, waterfallHeight);
+                    memcpy(&rawFFTs[currentFFTLine * rawFFTSize], line, rawFFTSize * sizeof(float));
+                    zoomPyramid.build(line, &rawFFTPyramids[currentFFTLine * zoomPyramid.size()]);
+                }
+                else {
+                    memcpy(rawFFTs, line, rawFFTSize * sizeof(float));
+                }
+                processFFTLine();
+            }
+            fftQueue.pop();
+        }
+    }
 
+    /**
+     * fftQueue -> rawFFTs/rawFFTPyramids -> (zoom) -> lastFFT -> (palletizing) -> waterfallFb[current]
+     */
+    void WaterFall::processFFTLine() {
         double offsetRatio = viewOffset / (wholeBandwidth / 2.0);
         int drawDataSize = (viewBandwidth / wholeBandwidth) * rawFFTSize;
         int drawDataStart = (((double)rawFFTSize / 2.0) * (offsetRatio + 1)) - (drawDataSize / 2);
 
-        if (waterfallVisible) {
-            doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, &rawFFTs[currentFFTLine * rawFFTSize], latestFFT);
+        // A collapsed waterfall keeps no history, the line sits in row 0 of rawFFTs without a pyramid
+        if (waterfallVisible && waterfallHeight != 0) {
+            zoomPyramid.zoom(drawDataStart, drawDataSize, dataWidth, &rawFFTs[currentFFTLine * rawFFTSize], &rawFFTPyramids[currentFFTLine * zoomPyramid.size()], latestFFT);
 
             waterfallHeadSectionHeight++;
             if (waterfallHeadSectionHeight > waterfallMaxSectionHeight) {
@@ -1251,8 +1230,6 @@ namespace ImGui {
                 latestFFTHold[i] = std::max<float>(latestFFT[i], latestFFTHold[i] - fftHoldSpeed);
             }
         }
-
-        buf_mtx.unlock();
     }
 
     inline void WaterFall::setTextureStatus(int index, int value) {
@@ -1481,8 +1458,12 @@ namespace ImGui {
         else {
             rawFFTs = (float*)malloc(rawFFTSize * wfSize * sizeof(float));
         }
+        zoomPyramid.init(rawFFTSize);
+        rawFFTPyramids = (float*)realloc(rawFFTPyramids, std::max<int>(1, zoomPyramid.size() * wfSize) * sizeof(float));
         fftLines = 0;
         memset(rawFFTs, 0, rawFFTSize * waterfallHeight * sizeof(float));
+        memset(rawFFTPyramids, 0, zoomPyramid.size() * waterfallHeight * sizeof(float));
+        fftQueueLineSize = rawFFTSize;
         updateWaterfallFb();
     }
 
@@ -1732,6 +1713,7 @@ namespace ImGui {
         size_t length = waterfallHeight * rawFFTSize * sizeof(float);
         flog::info("rawFFTS: {}, length {}", (void*)rawFFTs, (int)length);
         memset(rawFFTs, 0, length);
+        memset(rawFFTPyramids, 0, waterfallHeight * zoomPyramid.size() * sizeof(float));
         updateWaterfallFb();
     }
 
@@ -1773,6 +1755,9 @@ namespace ImGui {
         if (rawFFTs) {
             free(rawFFTs);
         }
+        if (rawFFTPyramids) {
+            free(rawFFTPyramids);
+        }
         if (latestFFT != NULL) {
             delete[] latestFFT;
         }
@@ -3,6 +3,8 @@
 #include <vector>
 #include <mutex>
 #include <gui/widgets/bandplan.h>
+#include <gui/widgets/fft_line_queue.h>
+#include <gui/widgets/waterfall_zoom.h>
 #include <imgui/imgui.h>
 #include <imgui/imgui_internal.h>
 #include <utils/event.h>
@@ -96,6 +98,7 @@ namespace ImGui {
         void draw();
         float* getFFTBuffer();
         void pushFFT();
+        uint64_t getDroppedFFTLines();
 
         void updatePallette(float colors[][3], int colorCount);
         void updatePalletteFromArray(float* colors, int colorCount);
@@ -267,6 +270,9 @@ namespace ImGui {
         void changeTexturePixels(int textureIndex, const uint8_t* pixels) const;
         void drawWaterfallImages();
 
+        void drainFFTQueue();
+        void processFFTLine();
+
         void updateAllVFOs(bool checkRedrawRequired = false);
         bool calculateVFOSignalInfo(float* fftLine, WaterfallVFO* vfo, float& strength, float& snr);
 
@@ -319,12 +325,18 @@ namespace ImGui {
         //std::vector<std::vector<float>> rawFFTs;
         int rawFFTSize;
         float* rawFFTs = NULL;
+        float* rawFFTPyramids = NULL;  // zoomPyramid.size() floats per rawFFTs line
+        ZoomPyramid zoomPyramid;
         float* latestFFT = NULL;
         float* latestFFTHold = NULL;
         float* smoothingBuf = NULL;
         int currentFFTLine = 0;
         int fftLines = 0;
 
+        // Raw lines from the DSP thread, consumed by draw()
+        FFTLineQueue fftQueue;
+        std::atomic<int> fftQueueLineSize = 0;
+
         uint32_t* waterfallFb;
         float* tempDataForUpdateWaterfallFb;
 
@@ -0,0 +1,167 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#include <volk/volk.h>
+#include <utils/flog.h>
+
+// Reduce `width` FFT bins starting at `offset` to `outSize` display columns, keeping the peak of
+// each column. No GUI dependency so it can be benchmarked headless.
+inline void doZoom(int offset, int width, int inSize, int outSize, float* in, float* out) {
+    // NOTE: REMOVE THAT SHIT, IT'S JUST A HACKY FIX
+    if (width > 524288) {
+        width = 524288;
+    }
+    if (offset < 0) {
+        flog::warn("Offset is negative: {}", offset);
+        offset = 0;
+    }
+
+    float factor = (float)width / (float)outSize;
+
+    int sFactor = (int)ceilf(factor);
+    float id = offset;
+    float maxVal, maxVal1, maxVal2, maxVal3, maxVal4, maxVal5, maxVal6, maxVal7, maxVal8, maxVal9, maxVal10, maxVal11, maxVal12, maxVal13, maxVal14, maxVal15;
+    int sId;
+    for (int i = 0; i < outSize; i++) {
+        maxVal = -INFINITY;
+        maxVal1 = -INFINITY;
+        maxVal2 = -INFINITY;
+        maxVal3 = -INFINITY;
+        maxVal4 = -INFINITY;
+        maxVal5 = -INFINITY;
+        maxVal6 = -INFINITY;
+        maxVal7 = -INFINITY;
+        // more than 8 is not worth it
+        sId = (int)id;
+        int uFactor = (sId + sFactor > inSize) ? inSize - sId : sFactor;
+
+        constexpr int N = 8;
+        auto uFactorN = (((int)uFactor) / N) * N;
+        int j;
+        for (j = 0; j < uFactorN; j+=N) {
+            maxVal = std::max<float>(maxVal, in[sId + j]);
+            maxVal1 = std::max<float>(maxVal1, in[sId + j + 1]);
+            maxVal2 = std::max<float>(maxVal2, in[sId + j + 2]);
+            maxVal3 = std::max<float>(maxVal3, in[sId + j + 3]);
+            maxVal4 = std::max<float>(maxVal4, in[sId + j + 4]);
+            maxVal5 = std::max<float>(maxVal5, in[sId + j + 5]);
+            maxVal6 = std::max<float>(maxVal6, in[sId + j + 6]);
+            maxVal7 = std::max<float>(maxVal7, in[sId + j + 7]);
+        }
+        maxVal = std::max<float>(maxVal, maxVal1);
+        maxVal = std::max<float>(maxVal, maxVal2);
+        maxVal = std::max<float>(maxVal, maxVal3);
+        maxVal = std::max<float>(maxVal, maxVal4);
+        maxVal = std::max<float>(maxVal, maxVal5);
+        maxVal = std::max<float>(maxVal, maxVal6);
+        maxVal = std::max<float>(maxVal, maxVal7);
+        for (; j < uFactor; j++) {
+            maxVal = std::max<float>(maxVal, in[sId + j]);
+        }
+
+        out[i] = maxVal;
+        id += factor;
+    }
+}
+
+// Max pyramid of one FFT line, so any bin range can be reduced in O(log n) instead of O(range).
+//
+// Level 0 holds the max of each 8 bins, every next level the max of two entries of the previous
+// one, down to a single value (about n/4 extra floats per line). The layout depends only on the
+// line size, so one ZoomPyramid describes every line of the waterfall history; the pyramids
+// themselves live in caller-owned memory of size() floats per line.
+class ZoomPyramid {
+public:
+    static const int BASE_SHIFT = 3;
+    static const int BASE = 1 << BASE_SHIFT;
+
+    void init(int inSize) {
+        this->inSize = inSize;
+        levelOffset.clear();
+        levelSize.clear();
+        total = 0;
+        int s = (inSize + BASE - 1) >> BASE_SHIFT;
+        while (s > 0) {
+            levelOffset.push_back(total);
+            levelSize.push_back(s);
+            total += s;
+            if (s == 1) { break; }
+            s = (s + 1) >> 1;
+        }
+        tmpA.resize((inSize + 1) / 2 + 1);
+        tmpB.resize((inSize + 3) / 4 + 1);
+        odd.resize((inSize + 1) / 2 + 1);
+    }
+
+    int size() const { return total; }
+
+    // Build the pyramid of `in` (inSize bins) into `pyr`. Uses internal scratch, call from one thread.
+    void build(const float* in, float* pyr) {
+        if (levelSize.empty()) { return; }
+        maxPairs(in, inSize, tmpA.data());
+        maxPairs(tmpA.data(), (inSize + 1) / 2, tmpB.data());
+        maxPairs(tmpB.data(), (inSize + 3) / 4, pyr);
+        for (int l = 1; l < levelSize.size(); l++) {
+            maxPairs(&pyr[levelOffset[l - 1]], levelSize[l - 1], &pyr[levelOffset[l]]);
+        }
+    }
+
+    // Same columns as doZoom(), but read from the pyramid. Read-only, safe to call from many threads.
+    void zoom(int offset, int width, int outSize, const float* in, const float* pyr, float* out) const {
+        offset = std::max<int>(offset, 0);
+        double factor = (double)width / (double)outSize;
+        int sFactor = (int)ceil(factor);
+        double id = offset;
+        for (int i = 0; i < outSize; i++) {
+            int sId = (int)id;
+            int uFactor = (sId + sFactor > inSize) ? inSize - sId : sFactor;
+            out[i] = rangeMax(in, pyr, sId, sId + uFactor);
+            id += factor;
+        }
+    }
+
+    // Max of bins [begin, end)
+    float rangeMax(const float* in, const float* pyr, int begin, int end) const {
+        float maxVal = -INFINITY;
+        if (end - begin < 2 * BASE) {
+            for (int i = begin; i < end; i++) { maxVal = std::max<float>(maxVal, in[i]); }
+            return maxVal;
+        }
+
+        // Unaligned edges straight from the bins
+        int lo = (begin + BASE - 1) >> BASE_SHIFT;
+        int hi = end >> BASE_SHIFT;
+        for (int i = begin; i < (lo << BASE_SHIFT); i++) { maxVal = std::max<float>(maxVal, in[i]); }
+        for (int i = (hi << BASE_SHIFT); i < end; i++) { maxVal = std::max<float>(maxVal, in[i]); }
+
+        // Aligned middle bottom-up through the levels
+        for (int l = 0; lo < hi; l++) {
+            const float* level = &pyr[levelOffset[l]];
+            if (lo & 1) { maxVal = std::max<float>(maxVal, level[lo++]); }
+            if (hi & 1) { maxVal = std::max<float>(maxVal, level[--hi]); }
+            lo >>= 1;
+            hi >>= 1;
+        }
+        return maxVal;
+    }
+
+private:
+    // out[i] = max(in[2i], in[2i + 1]), with an odd trailing bin passed through
+    void maxPairs(const float* in, int count, float* out) {
+        int pairs = count / 2;
+        if (pairs) {
+            volk_32fc_deinterleave_32f_x2(out, odd.data(), (const lv_32fc_t*)in, pairs);
+            volk_32f_x2_max_32f(out, out, odd.data(), pairs);
+        }
+        if (count & 1) { out[pairs] = in[count - 1]; }
+    }
+
+    int inSize = 0;
+    int total = 0;
+    std::vector<int> levelOffset;
+    std::vector<int> levelSize;
+    std::vector<float> tmpA;
+    std::vector<float> tmpB;
+    std::vector<float> odd;
+};
@@ -4,6 +4,7 @@
 #include <version.h>
 #include <config.h>
 #include <filesystem>
+#include <deque>
 #include <dsp/types.h>
 #include <utils/wav.h>
 #include <signal_path/signal_path.h>
@@ -13,7 +14,10 @@
 #include <dsp/buffer/prebuffer.h>
 #include <dsp/buffer/packer.h>
 #include "dsp/compression/experimental_fft_compressor.h"
+#include "dsp/compression/lossless_iq.h"
 #include "dsp/sink/handler_sink.h"
+#include "dsp/routing/splitter.h"
+#include "dsp/stats.h"
 #include "dsp/loop/agc.h"
 #include "dsp/multirate/rational_resampler.h"
 #include <zstd.h>
@@ -26,61 +30,612 @@
 #define PBKDF2_SHA256_IMPLEMENTATION
 #include "utils/pbkdf2_sha256.h"
 
+// Baseband packets queued per client before the oldest ones get dropped, so a slow link can't stall the radio
+#define CLIENT_BASEBAND_BACKLOG     64
+
+// IQ blocks buffered in front of each encoder
+#define ENCODER_INPUT_BACKLOG       8
+
+// Encoded blocks waiting for the compression thread
+#define COMPRESSION_BACKLOG         8
+
+// Streaming ZSTD: highest level the adaptive control may pick, and the window kept across packets
+#define STREAM_MAX_LEVEL            9
+#define STREAM_WINDOW_LOG           22
+
 namespace server {
+    typedef std::shared_ptr<const std::vector<uint8_t>> SharedPacket;
+
+    static const int CLIENT_CAPS_BASEDATA_METADATA = 0x0001;        // wants frequency and samplerate along with each IQ batch (otherwise, network latency decouples freq request from baseband)
+    static const int CLIENT_CAPS_FFT_WANTED = 0x0002;        // not yet done
+
+    // Everything that changes the baseband packets a client receives. Clients with equal settings share an encoder.
+    struct EncoderSettings {
+        int forcedSampleRate = 0;
+        dsp::compression::PCMType pcmType = dsp::compression::PCM_TYPE_I16;
+        int compression = BASEBAND_COMPRESSION_NONE;
+        bool fftCompression = true;
+        double lossRate = 1.0;
+        std::vector<int32_t> maskedFrequencies;
+        bool metadata = false;
+
+        bool operator==(const EncoderSettings& b) const {
+            return forcedSampleRate == b.forcedSampleRate && pcmType == b.pcmType && compression == b.compression &&
+                   fftCompression == b.fftCompression && lossRate == b.lossRate && maskedFrequencies == b.maskedFrequencies &&
+                   metadata == b.metadata;
+        }
+    };
+
+    class BasebandEncoder;
+
+    class ClientSession {
+    public:
+        ClientSession(net::Conn conn) : conn(std::move(conn)) {
+            peerName = this->conn->getPeerName();
+            rbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
+
+            r_pkt_hdr = (PacketHeader*)rbuf;
+            r_pkt_data = &rbuf[sizeof(PacketHeader)];
+            r_cmd_hdr = (CommandHeader*)r_pkt_data;
+            r_cmd_data = &rbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
+
+            writerThread = std::thread(&ClientSession::writeWorker, this);
+        }
+
+        ~ClientSession() {
+            stopWriter();
+            conn->close();
+            delete[] rbuf;
+        }
+
+        void stopWriter() {
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                writerStop = true;
+            }
+            queueCV.notify_all();
+            if (writerThread.joinable()) { writerThread.join(); }
+        }
+
+        // Baseband is dropped oldest first when the client can't keep up, commands are always delivered.
+        // Streamed chunks depend on every chunk before them in the frame, once one is dropped the rest of
+        // the frame is skipped until the encoder starts a new one.
+        void queuePacket(const SharedPacket& pkt, bool baseband, bool streamed = false, bool newFrame = false) {
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                if (writerStop) { return; }
+                if (streamed) {
+                    if (newFrame) { awaitingFrame = false; }
+                    else if (awaitingFrame) { dropped++; return; }
+                }
+                if (baseband && basebandQueued >= CLIENT_BASEBAND_BACKLOG) {
+                    auto it = std::find_if(queue.begin(), queue.end(), [](const QueuedPacket& p) { return p.baseband; });
+                    if (it->streamed) {
+                        dropStreamedUntilFrame(it);
+                        if (awaitingFrame && streamed && !newFrame) { dropped++; return; }
+                    }
+                    else {
+                        queue.erase(it);
+                        basebandQueued--;
+                        dropped++;
+                    }
+                }
+                queue.push_back(QueuedPacket{ pkt, baseband, streamed, newFrame });
+                if (baseband) { basebandQueued++; }
+            }
+            queueCV.notify_one();
+        }
+
+        // True when the client lost streamed chunks and can only resume at a new frame
+        bool needsNewFrame() {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            return awaitingFrame;
+        }
+
+        int getBasebandBacklog() {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            return basebandQueued;
+        }
+
+        // Every packet is built in its own buffer, sessions are sent to from several threads at once
+        void sendCommand(Command cmd, const void* data, int len) {
+            sendCommandPacket(PACKET_TYPE_COMMAND, cmd, data, len);
+        }
+
+        void sendCommandAck(Command cmd, const void* data, int len) {
+            sendCommandPacket(PACKET_TYPE_COMMAND_ACK, cmd, data, len);
+        }
+
+        void sendError(Error err) {
+            std::vector<uint8_t> pkt(sizeof(PacketHeader) + 1);
+            ((PacketHeader*)pkt.data())->type = PACKET_TYPE_ERROR;
+            ((PacketHeader*)pkt.data())->size = pkt.size();
+            pkt[sizeof(PacketHeader)] = err;
+            queuePacket(std::make_shared<const std::vector<uint8_t>>(std::move(pkt)), false);
+        }
+
+        void sendSampleRate(double sampleRate) {
+            sendCommand(COMMAND_SET_SAMPLERATE, &sampleRate, sizeof(double));
+        }
+
+        uint64_t getDropped() {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            return dropped;
+        }
+
+        void sendCommandPacket(PacketType type, Command cmd, const void* data, int len) {
+            std::vector<uint8_t> pkt(sizeof(PacketHeader) + sizeof(CommandHeader) + len);
+            ((PacketHeader*)pkt.data())->type = type;
+            ((PacketHeader*)pkt.data())->size = pkt.size();
+            ((CommandHeader*)&pkt[sizeof(PacketHeader)])->cmd = cmd;
+            if (len) { memcpy(&pkt[sizeof(PacketHeader) + sizeof(CommandHeader)], data, len); }
+            queuePacket(std::make_shared<const std::vector<uint8_t>>(std::move(pkt)), false);
+        }
+
+        net::Conn conn;
+        std::string peerName;
+
+        uint8_t* rbuf = NULL;
+
+        PacketHeader* r_pkt_hdr = NULL;
+        uint8_t* r_pkt_data = NULL;
+        CommandHeader* r_cmd_hdr = NULL;
+        uint8_t* r_cmd_data = NULL;
+
+        // Protected by clientsMtx
+        EncoderSettings settings;
+        BasebandEncoder* encoder = NULL;
+        bool running = false;
+
+        std::string challenge;
+        StartCommandArguments startCommandArguments = {};
+
+    private:
+        struct QueuedPacket {
+            SharedPacket data;
+            bool baseband;
+            bool streamed;
+            bool newFrame;
+        };
+
+        // Drop streamed chunks from the oldest one up to the next queued frame start, if there is none
+        // the client waits for the next one. Must be called with queueMtx held.
+        void dropStreamedUntilFrame(std::deque<QueuedPacket>::iterator oldest) {
+            auto frame = std::find_if(std::next(oldest), queue.end(), [](const QueuedPacket& p) { return p.streamed && p.newFrame; });
+            bool haveFrame = (frame != queue.end());
+            int frameIdx = std::distance(queue.begin(), frame);
+            int pos = 0;
+            for (auto it = queue.begin(); it != queue.end(); pos++) {
+                if (it->streamed && pos < frameIdx) {
+                    basebandQueued--;
+                    dropped++;
+                    it = queue.erase(it);
+                }
+                else {
+                    it++;
+                }
+            }
+            if (!haveFrame) { awaitingFrame = true; }
+        }
+
+        void writeWorker() {
+            while (true) {
+                SharedPacket pkt;
+                {
+                    std::unique_lock<std::mutex> lck(queueMtx);
+                    queueCV.wait(lck, [this] { return !queue.empty() || writerStop; });
+                    if (writerStop) { return; }
+                    pkt = queue.front().data;
+                    if (queue.front().baseband) { basebandQueued--; }
+                    queue.pop_front();
+                }
+                if (!conn->write(pkt->size(), (uint8_t*)pkt->data())) { return; }
+            }
+        }
+
+        std::mutex queueMtx;
+        std::condition_variable queueCV;
+        std::deque<QueuedPacket> queue;
+        int basebandQueued = 0;
+        uint64_t dropped = 0;
+        bool awaitingFrame = false;
+        bool writerStop = false;
+        std::thread writerThread;
+    };
+
+    typedef std::shared_ptr<ClientSession> Session;
+
     dsp::stream<dsp::complex_t> dummyInput("server::dummyInput");
-    dsp::multirate::RationalResampler<dsp::complex_t> forcedResampler;
-    dsp::compression::ExperimentalFFTCompressor fftCompressor;
-    dsp::compression::SampleStreamCompressor comp;
-    dsp::sink::Handler<uint8_t> hnd;
-    net::Conn client;
-    uint8_t* rbuf = NULL;
-    uint8_t* sbuf = NULL;
-    uint8_t* bbuf = NULL;
-
-    PacketHeader* r_pkt_hdr = NULL;
-    uint8_t* r_pkt_data = NULL;
-    CommandHeader* r_cmd_hdr = NULL;
-    uint8_t* r_cmd_data = NULL;
-
-    PacketHeader* s_pkt_hdr = NULL;
-    uint8_t* s_pkt_data = NULL;
-    CommandHeader* s_cmd_hdr = NULL;
-    uint8_t* s_cmd_data = NULL;
-
-    PacketHeader* bb_pkt_hdr = NULL;
-    uint8_t* bb_pkt_data = NULL;
+    dsp::routing::Splitter<dsp::complex_t> splitter;
 
-    SmGui::DrawListElem dummyElem;
+    double sampleRate = 1000000.0;
+    double lastTunedFrequency = 0;
+    double lastCallbackFrequency = -1;
+    std::atomic_bool txMode = false;
+
+    // Resampling, EFFT, PCM conversion and packet encoding for all the clients sharing the same settings.
+    // Each packet is encoded once and queued to every member. ZSTD runs on a thread of its own so the
+    // DSP chain never waits for it.
+    class BasebandEncoder {
+    public:
+        BasebandEncoder(const EncoderSettings& settings) : input("server::encoderInput", ENCODER_INPUT_BACKLOG, dsp::DROP_POLICY_OLDEST) {
+            _settings = settings;
+            forcedResampler.init(&input, sampleRate, getSampleRate());
+            fftCompressor.init(&forcedResampler.out);
+            fftCompressor.setSampleRate(getSampleRate());
+            comp.init(&fftCompressor.out, settings.pcmType);
+            hnd.init(&comp.out, _encoderHandler, this);
+            applySettings(settings);
+
+            bbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
+            bb_pkt_hdr = (PacketHeader*)bbuf;
+            cctx = ZSTD_createCCtx();
+            streamCtx = ZSTD_createCCtx();
+            ZSTD_CCtx_setParameter(streamCtx, ZSTD_c_windowLog, STREAM_WINDOW_LOG);
+            compressionThread = std::thread(&BasebandEncoder::compressionWorker, this);
+
+            comp.start();
+            hnd.start();
+            fftCompressor.start();
+            forcedResampler.start();
+            splitter.bindStream(&input);
+        }
+
+        ~BasebandEncoder() {
+            splitter.unbindStream(&input);
+            forcedResampler.stop();
+            fftCompressor.stop();
+            comp.stop();
+            hnd.stop();
+            {
+                std::lock_guard<std::mutex> lck(jobMtx);
+                compressionStop = true;
+            }
+            jobCV.notify_all();
+            if (compressionThread.joinable()) { compressionThread.join(); }
+            if (input.getDropped() || jobsDropped) {
+                flog::warn("Server encoder dropped {} IQ blocks and {} encoded blocks", (uint64_t)input.getDropped(), (uint64_t)jobsDropped);
+            }
+            ZSTD_freeCCtx(cctx);
+            ZSTD_freeCCtx(streamCtx);
+            delete[] bbuf;
+        }
+
+        // Only called for settings that don't require a new encoder, or when this is the only member
+        void configure(const EncoderSettings& settings) {
+            bool rateChanged = (settings.forcedSampleRate != _settings.forcedSampleRate);
+            {
+                std::lock_guard<std::mutex> lck(membersMtx);
+                _settings = settings;
+                streamNewFrame = true;
+            }
+            applySettings(settings);
+            if (rateChanged) { updateSampleRate(); }
+        }
+
+        void updateSampleRate() {
+            forcedResampler.setRates(sampleRate, getSampleRate());
+            fftCompressor.setSampleRate(getSampleRate());
+        }
 
-    ZSTD_CCtx* cctx;
+        double getSampleRate() {
+            return _settings.forcedSampleRate ? _settings.forcedSampleRate : sampleRate;
+        }
+
+        const EncoderSettings& getSettings() { return _settings; }
+
+        void addMember(const Session& client) {
+            std::lock_guard<std::mutex> lck(membersMtx);
+            members.push_back(client);
+            client->encoder = this;
+
+            // The new member doesn't have the stream window yet
+            streamNewFrame = true;
+        }
+
+        void removeMember(const Session& client) {
+            std::lock_guard<std::mutex> lck(membersMtx);
+            members.erase(std::remove(members.begin(), members.end(), client), members.end());
+            client->encoder = NULL;
+        }
+
+        bool hasMembers() {
+            std::lock_guard<std::mutex> lck(membersMtx);
+            return !members.empty();
+        }
+
+        static void _encoderHandler(uint8_t* data, int count, void* ctx) {
+            ((BasebandEncoder*)ctx)->pushJob(data, count);
+        }
+
+    private:
+        void applySettings(const EncoderSettings& settings) {
+            fftCompressor.setEnabled(settings.fftCompression);
+            fftCompressor.lossRate = settings.lossRate;
+            fftCompressor.setMaskedFrequencies(settings.maskedFrequencies);
+            comp.setPCMType(settings.pcmType);
+        }
+
+        // Called from the DSP thread, buffers are recycled so nothing is allocated once warmed up
+        void pushJob(uint8_t* data, int count) {
+            {
+                std::lock_guard<std::mutex> lck(jobMtx);
+                if (jobs.size() >= COMPRESSION_BACKLOG) {
+                    spareJobs.push_back(std::move(jobs.front()));
+                    jobs.pop_front();
+                    jobsDropped++;
+                }
+                std::vector<uint8_t> buf;
+                if (!spareJobs.empty()) {
+                    buf = std::move(spareJobs.back());
+                    spareJobs.pop_back();
+                }
+                buf.assign(data, data + count);
+                jobs.push_back(std::move(buf));
+            }
+            jobCV.notify_one();
+        }
+
+        void compressionWorker() {
+            while (true) {
+                std::vector<uint8_t> buf;
+                {
+                    std::unique_lock<std::mutex> lck(jobMtx);
+                    jobCV.wait(lck, [this] { return !jobs.empty() || compressionStop; });
+                    if (compressionStop) { return; }
+                    buf = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                encode(buf.data(), buf.size());
+                {
+                    std::lock_guard<std::mutex> lck(jobMtx);
+                    spareJobs.push_back(std::move(buf));
+                }
+            }
+        }
+
+        // Compress one block into the current stream frame, starting a new frame when the settings or
+        // the members changed, or when a member lost chunks. Returns the compressed size or -1.
+        int compressStreamChunk(uint8_t* data, int count, uint8_t* out, int outSize, bool& newFrame) {
+            newFrame = streamNewFrame || !streamStarted;
+            for (auto& client : members) {
+                if (newFrame) { break; }
+                newFrame = client->needsNewFrame();
+            }
+            if (newFrame) {
+                ZSTD_CCtx_reset(streamCtx, ZSTD_reset_session_only);
+                ZSTD_CCtx_setParameter(streamCtx, ZSTD_c_compressionLevel, streamLevel);
+                streamNewFrame = false;
+                streamStarted = true;
+            }
+
+            ZSTD_inBuffer zin = { data, (size_t)count, 0 };
+            ZSTD_outBuffer zout = { out, (size_t)outSize, 0 };
+            size_t remaining;
+            do {
+                remaining = ZSTD_compressStream2(streamCtx, &zout, &zin, ZSTD_e_flush);
+            } while (!ZSTD_isError(remaining) && remaining && zout.pos < zout.size);
+
+            if (ZSTD_isError(remaining) || remaining) {
+                flog::error("Stream compression failed: {}", ZSTD_isError(remaining) ? ZSTD_getErrorName(remaining) : "output full");
+                streamStarted = false;
+                return -1;
+            }
+            return zout.pos;
+        }
+
+        // Once a second, raise the level while the slowest member's link falls behind and there is CPU
+        // to spare, lower it when compression itself becomes the bottleneck or the links have stayed
+        // idle for a while.
+        void adaptStreamLevel() {
+            uint64_t now = dsp::stats::nowNs();
+            if (!statsTime) { statsTime = now; }
+            if (now - statsTime < 1000000000ULL) { return; }
+
+            double cpu = (double)compressNs / (double)(now - statsTime);
+            cpuPermille = std::min<int>(cpu * 1000.0, 65535);
+            int backlog = 0;
+            for (auto& client : members) {
+                backlog = std::max<int>(backlog, client->getBasebandBacklog());
+            }
+            idleSeconds = backlog ? 0 : idleSeconds + 1;
+
+            int level = streamLevel;
+            if (backlog > CLIENT_BASEBAND_BACKLOG / 4 && cpu < 0.5 && level < STREAM_MAX_LEVEL) { level++; }
+            else if ((cpu > 0.8 || (idleSeconds >= 10 && cpu > 0.3)) && level > 1) { level--; idleSeconds = 0; }
+            if (level != streamLevel && _settings.compression == BASEBAND_COMPRESSION_STREAM) {
+                flog::info("Stream compression level {} -> {} (ratio {}, cpu {}%, backlog {})", streamLevel, level,
+                           rawBytes ? (double)rawBytes / (double)std::max<uint64_t>(compressedBytes, 1) : 0.0, (int)(cpu * 100.0), backlog);
+                streamLevel = level;
+                streamNewFrame = true;
+            }
+
+            compressNs = 0;
+            rawBytes = 0;
+            compressedBytes = 0;
+            statsTime = now;
+        }
+
+        // Float and block scaled samples are sent with per packet ZSTD instead
+        static bool isIntegerPCM(uint16_t sampleType) {
+            return sampleType == dsp::compression::PCM_TYPE_I8 || sampleType == dsp::compression::PCM_TYPE_I16;
+        }
+
+        // Keeps the SampleStreamCompressor header and codes its samples
+        void encodeLossless(uint8_t* data, int count) {
+            uint16_t sampleType = *(uint16_t*)&data[2];
+            int headerEnd = sizeof(PacketHeader) + 8;
+            uint8_t* out = &bbuf[headerEnd];
+            int size;
+            if (sampleType == dsp::compression::PCM_TYPE_I16) {
+                size = dsp::compression::lossless::encode<int16_t>((int16_t*)&data[8], (count - 8) / (2 * sizeof(int16_t)), 2, out);
+            }
+            else {
+                size = dsp::compression::lossless::encode<int8_t>((int8_t*)&data[8], (count - 8) / (2 * sizeof(int8_t)), 2, out);
+            }
+            memcpy(&bbuf[sizeof(PacketHeader)], data, 8);
+            bb_pkt_hdr->type = PACKET_TYPE_BASEBAND_LOSSLESS;
+            bb_pkt_hdr->size = headerEnd + size;
+        }
+
+        void encode(uint8_t* data, int count) {
+            std::lock_guard<std::mutex> lck(membersMtx);
+            if (members.empty()) { return; }
+            frameCount++;
+            adaptStreamLevel();
+            uint64_t compressStart = dsp::stats::nowNs();
+            int rawCount = count;
+            bool streamed = false;
+            bool newFrame = false;
+
+            bool tx = txMode;
+            if (tx != lastTxMode) {
+                fftCompressor.setTxMode(tx);
+                lastTxMode = tx;
+            }
+
+            // Compress data if needed and fill out header fields
+            if (_settings.metadata) {
+                bb_pkt_hdr->type = PACKET_TYPE_BASEBAND_WITH_METADATA;
+                StreamMetadata *sm = (StreamMetadata*)&bbuf[sizeof(PacketHeader)];
+                sm->version = 1;
+                sm->size = sizeof(StreamMetadata);
+                sm->frequency = lastCallbackFrequency != -1 ? lastCallbackFrequency : lastTunedFrequency; // for any driver, supporting callback frequency or not.
+                sm->sampleRate = getSampleRate();
+                sm->fftCompressed = fftCompressor.isEnabled();
+                auto dataOffset = sizeof(PacketHeader) + sizeof(StreamMetadata);
+                if (sm->fftCompressed) {
+                    count = ZSTD_compressCCtx(cctx, &bbuf[dataOffset], SERVER_MAX_PACKET_SIZE-dataOffset, data, count, 1);
+                } else {
+                    memcpy(&bbuf[dataOffset], data, count);
+                }
+                bb_pkt_hdr->size = dataOffset + count;
+            } else if (fftCompressor.isEnabled()) {
+                bb_pkt_hdr->type = PACKET_TYPE_BASEBAND_EXPERIMENTAL_FFT;
+                auto dataOffset = sizeof(PacketHeader);
+                count = ZSTD_compressCCtx(cctx, &bbuf[dataOffset], SERVER_MAX_PACKET_SIZE-dataOffset, data, count, 1);
+                bb_pkt_hdr->size = sizeof(PacketHeader) + count;
+            } else if (_settings.compression == BASEBAND_COMPRESSION_STREAM) {
+                bb_pkt_hdr->type = PACKET_TYPE_BASEBAND_ZSTD_STREAM;
+                StreamChunkHeader* ch = (StreamChunkHeader*)&bbuf[sizeof(PacketHeader)];
+                auto dataOffset = sizeof(PacketHeader) + sizeof(StreamChunkHeader);
+                count = compressStreamChunk(data, count, &bbuf[dataOffset], SERVER_MAX_PACKET_SIZE-dataOffset, newFrame);
+                if (count < 0) { return; }
+                ch->flags = newFrame ? STREAM_CHUNK_NEW_FRAME : 0;
+                ch->level = streamLevel;
+                ch->cpuPermille = cpuPermille;
+                bb_pkt_hdr->size = dataOffset + count;
+                streamed = true;
+            } else if (_settings.compression == BASEBAND_COMPRESSION_LOSSLESS && count >= 8 && isIntegerPCM(*(uint16_t*)&data[2])) {
+                encodeLossless(data, count);
+            } else if (_settings.compression) {
+                bb_pkt_hdr->type = PACKET_TYPE_BASEBAND_COMPRESSED;
+                bb_pkt_hdr->size = sizeof(PacketHeader) + (uint32_t)ZSTD_compressCCtx(cctx, &bbuf[sizeof(PacketHeader)], SERVER_MAX_PACKET_SIZE-sizeof(PacketHeader), data, count, 1);
+            } else {
+                bb_pkt_hdr->type = PACKET_TYPE_BASEBAND;
+                bb_pkt_hdr->size = sizeof(PacketHeader) + count;
+                memcpy(&bbuf[sizeof(PacketHeader)], data, count);
+            }
+
+            compressNs += dsp::stats::nowNs() - compressStart;
+            rawBytes += rawCount;
+            compressedBytes += bb_pkt_hdr->size;
+
+            // Queue the same packet to every member
+            auto pkt = std::make_shared<const std::vector<uint8_t>>(bbuf, bbuf + bb_pkt_hdr->size);
+            for (auto& client : members) {
+                client->queuePacket(pkt, true, streamed, newFrame);
+            }
+
+            if (fftCompressor.isEnabled() && frameCount % 20 == 1 && !tx) {
+                fftCompressor.sharedDataLock.lock();
+                int nbytes = fftCompressor.noiseFigure.size() * sizeof(fftCompressor.noiseFigure[0]);
+                std::vector<uint8_t> nf(sizeof(PacketHeader) + sizeof(CommandHeader) + nbytes);
+                memcpy(&nf[sizeof(PacketHeader) + sizeof(CommandHeader)], fftCompressor.noiseFigure.data(), nbytes);
+                fftCompressor.sharedDataLock.unlock();
+                ((PacketHeader*)nf.data())->type = PACKET_TYPE_COMMAND;
+                ((PacketHeader*)nf.data())->size = nf.size();
+                ((CommandHeader*)&nf[sizeof(PacketHeader)])->cmd = COMMAND_EFFT_NOISE_FIGURE;
+                auto nfPkt = std::make_shared<const std::vector<uint8_t>>(std::move(nf));
+                for (auto& client : members) {
+                    client->queuePacket(nfPkt, false);
+                }
+            }
+        }
+
+        dsp::shared_stream<dsp::complex_t> input;
+        dsp::multirate::RationalResampler<dsp::complex_t> forcedResampler;
+        dsp::compression::ExperimentalFFTCompressor fftCompressor;
+        dsp::compression::SampleStreamCompressor comp;
+        dsp::sink::Handler<uint8_t> hnd;
+
+        uint8_t* bbuf = NULL;
+        PacketHeader* bb_pkt_hdr = NULL;
+        ZSTD_CCtx* cctx = NULL;
+
+        // Compression thread
+        std::thread compressionThread;
+        std::mutex jobMtx;
+        std::condition_variable jobCV;
+        std::deque<std::vector<uint8_t>> jobs;
+        std::vector<std::vector<uint8_t>> spareJobs;
+        uint64_t jobsDropped = 0;
+        bool compressionStop = false;
+
+        // Streaming ZSTD state, protected by membersMtx
+        ZSTD_CCtx* streamCtx = NULL;
+        int streamLevel = 1;
+        bool streamStarted = false;
+        bool streamNewFrame = true;
+
+        // Compression cost over the current second
+        uint64_t statsTime = 0;
+        uint64_t compressNs = 0;
+        uint64_t rawBytes = 0;
+        uint64_t compressedBytes = 0;
+        int cpuPermille = 0;
+        int idleSeconds = 0;
+
+        std::mutex membersMtx;
+        std::vector<Session> members;
+        EncoderSettings _settings;
+        int frameCount = 0;
+        bool lastTxMode = false;
+    };
+
+    // Serializes command handling, source control and SmGui rendering
+    std::recursive_mutex uiMtx;
+
+    // Protects the client list, encoders and the per-client settings/encoder assignment
+    std::recursive_mutex clientsMtx;
+    std::vector<Session> clients;
+    std::vector<BasebandEncoder*> encoders;
+
+    // Client that last took control of the transmitter
+    std::mutex txMtx;
+    std::weak_ptr<ClientSession> txClient;
+
+    SmGui::DrawListElem dummyElem;
 
     net::Listener listener;
+    int maxClients = 8;
 
     OptionList<std::string, std::string> sourceList;
     int sourceId = 0;
-    bool running = false;
-    bool compression = false;
-    double sampleRate = 1000000.0;
-    int forcedSampleRate = 0;
+    bool sourceRunning = false;
 
     std::vector<int8_t> authSigningKey;
-    std::string challenge;
-
-    static const int CLIENT_CAPS_BASEDATA_METADATA = 0x0001;        // wants frequency and samplerate along with each IQ batch (otherwise, network latency decouples freq request from baseband)
-    static const int CLIENT_CAPS_FFT_WANTED = 0x0002;        // not yet done
-
-    StartCommandArguments startCommandArguments;
-    double lastTunedFrequency = 0;
-    double lastCallbackFrequency = -1;
-    double lastSampleRate = 0;
 
     bool transmitDataRunning = false;
     bool txPressed = false;
+    int txPrebufferMsec = 0;
     dsp::stream<dsp::complex_t> transmitDataStream;
     dsp::multirate::RationalResampler<dsp::complex_t> txStreamUpsampler;
     dsp::buffer::Prebuffer<dsp::complex_t> transmitPrebufferer;
     dsp::buffer::Packer<dsp::complex_t> transmitPacker;
 
+    void checkTransmitEnd();
+
     int main() {
         flog::info("=====| SERVER MODE |=====");
 #ifdef __linux__
@@ -95,20 +650,12 @@ namespace server {
             flog::info("Computing auth signing key..");
             pbkdf2_sha256(&pbkdf_hmac, (uint8_t *)password.data(), password.length(), (uint8_t*)passwordSalt.data(), passwordSalt.length(), 20000, (uint8_t*)authSigningKey.data(), authSigningKey.size());
         }
+        maxClients = std::max<int>((int)core::args["max-clients"], 1);
 
-            // Init DSP
-        forcedResampler.init(&dummyInput, 1000000, 48000);
-        fftCompressor.init(&forcedResampler.out);
-        fftCompressor.setEnabled(true);
-        comp.init(&fftCompressor.out, dsp::compression::PCM_TYPE_I8);
-        hnd.init(&comp.out, _testServerHandler, NULL);
-        rbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        sbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        bbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        comp.start();
-        hnd.start();
-        fftCompressor.start();
-        forcedResampler.start();
+        // Init DSP, encoders are created as clients start streaming
+        splitter.init(&dummyInput);
+        splitter.setHook([](dsp::complex_t* data, int count) { checkTransmitEnd(); });
+        splitter.start();
 
         if (true) {
             txStreamUpsampler.init(&transmitDataStream, TX_WIRE_SAMPLERATE, 48000);
@@ -122,23 +669,6 @@ namespace server {
         transmitPacker.init(&transmitPrebufferer.out, 2048);
         transmitPacker.start();
 
-        // Initialize headers
-        r_pkt_hdr = (PacketHeader*)rbuf;
-        r_pkt_data = &rbuf[sizeof(PacketHeader)];
-        r_cmd_hdr = (CommandHeader*)r_pkt_data;
-        r_cmd_data = &rbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
-
-        s_pkt_hdr = (PacketHeader*)sbuf;
-        s_pkt_data = &sbuf[sizeof(PacketHeader)];
-        s_cmd_hdr = (CommandHeader*)s_pkt_data;
-        s_cmd_data = &sbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
-
-        bb_pkt_hdr = (PacketHeader*)bbuf;
-        bb_pkt_data = &bbuf[sizeof(PacketHeader)];
-
-        // Initialize compressor
-        cctx = ZSTD_createCCtx();
-
         // Load config
         core::configManager.acquire();
         std::string modulesDir = core::configManager.conf["modulesDirectory"];
@@ -217,12 +747,108 @@ namespace server {
         listener = net::listen(host, port);
         listener->acceptAsync(_clientHandler, NULL);
 
-        flog::info("Ready, listening on {0}:{1}", host, port);
-        while(1) { std::this_thread::sleep_for(std::chrono::milliseconds(100)); }
+        flog::info("Ready, listening on {0}:{1} (up to {2} clients)", host, port, maxClients);
+        while(1) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            reapClients();
+        }
 
         return 0;
     }
 
+    bool anyClientRunning() {
+        std::lock_guard<std::recursive_mutex> lck(clientsMtx);
+        return std::any_of(clients.begin(), clients.end(), [](const Session& c) { return c->running; });
+    }
+
+    // Must be called with clientsMtx held
+    void detachEncoder(const Session& client) {
+        BasebandEncoder* enc = client->encoder;
+        if (!enc) { return; }
+        enc->removeMember(client);
+        if (!enc->hasMembers()) {
+            encoders.erase(std::remove(encoders.begin(), encoders.end(), enc), encoders.end());
+            delete enc;
+        }
+    }
+
+    // Put the client on the encoder matching its settings, sharing an existing one if possible.
+    // Must be called with clientsMtx held.
+    void attachEncoder(const Session& client) {
+        BasebandEncoder* current = client->encoder;
+        if (current && current->getSettings() == client->settings) { return; }
+
+        // Join an encoder that already produces exactly what this client wants
+        auto it = std::find_if(encoders.begin(), encoders.end(), [&](BasebandEncoder* e) { return e != current && e->getSettings() == client->settings; });
+        if (it != encoders.end()) {
+            detachEncoder(client);
+            (*it)->addMember(client);
+            return;
+        }
+
+        // Sole member, reconfigure in place instead of rebuilding the chain
+        if (current) {
+            current->removeMember(client);
+            if (!current->hasMembers()) {
+                current->configure(client->settings);
+                current->addMember(client);
+                return;
+            }
+            current->addMember(client);
+            detachEncoder(client);
+        }
+
+        auto enc = new BasebandEncoder(client->settings);
+        encoders.push_back(enc);
+        enc->addMember(client);
+        flog::info("Server now running {} encoder(s) for {} client(s)", (int)encoders.size(), (int)clients.size());
+    }
+
+    void updateClientSettings(const Session& client, const std::function<void(EncoderSettings&)>& change) {
+        std::lock_guard<std::recursive_mutex> lck(clientsMtx);
+        change(client->settings);
+        if (client->running) { attachEncoder(client); }
+    }
+
+    double clientSampleRate(const Session& client) {
+        std::lock_guard<std::recursive_mutex> lck(clientsMtx);
+        return client->settings.forcedSampleRate ? client->settings.forcedSampleRate : sampleRate;
+    }
+
+    // Drop clients whose connection went away, and stop the source once nobody is streaming
+    void reapClients() {
+        std::vector<Session> dead;
+        {
+            std::lock_guard<std::recursive_mutex> lck(clientsMtx);
+            for (auto& c : clients) {
+                if (!c->conn->isOpen()) { dead.push_back(c); }
+            }
+            if (dead.empty()) { return; }
+            for (auto& c : dead) {
+                clients.erase(std::remove(clients.begin(), clients.end(), c), clients.end());
+            }
+        }
+
+        for (auto& c : dead) {
+            // Wait for a command in progress to finish before touching the encoders
+            c->conn->close();
+            {
+                std::lock_guard<std::recursive_mutex> lck(clientsMtx);
+                detachEncoder(c);
+                c->running = false;
+            }
+            c->stopWriter();
+            flog::info("Client {0} is gone ({1} baseband packets dropped)", c->peerName, (uint64_t)c->getDropped());
+        }
+
+        std::lock_guard<std::recursive_mutex> lck(uiMtx);
+        if (sourceRunning && !anyClientRunning()) {
+            sigpath::sourceManager.stop();
+            sourceRunning = false;
+            flog::error("No client left, stopping SDR.");
+        }
+    }
+
     std::string transmitterStatusToString(Transmitter *transmitter) {
         auto rv = json({});
         rv["normalZone"] = transmitter->getNormalZone();
@@ -235,89 +861,116 @@ namespace server {
         return rv.dump();
     }
 
-    void maybeSendTransmitterState() {
+    void maybeSendTransmitterState(const Session& client) {
         if (sigpath::transmitter) {
             auto state = transmitterStatusToString(sigpath::transmitter);
-            strcpy((char*)s_cmd_data, state.c_str());
-            sendCommand(COMMAND_SET_TRANSMITTER_SUPPORTED, state.length()+1);
+            client->sendCommand(COMMAND_SET_TRANSMITTER_SUPPORTED, state.c_str(), state.length()+1);
         } else {
-            sendCommand(COMMAND_SET_TRANSMITTER_NOT_SUPPORTED, 0);
+            client->sendCommand(COMMAND_SET_TRANSMITTER_NOT_SUPPORTED, NULL, 0);
         }
     }
 
-    void maybeSendChallenge() {
+    void maybeSendChallenge(const Session& client) {
         if (authSigningKey.size() > 0) {
-            challenge = std::to_string(currentTimeMillis());
-            challenge.resize(256 / 8, ' ');
-            memcpy(s_cmd_data, challenge.c_str(), challenge.size());
-            sendCommand(COMMAND_SECURE_CHALLENGE, challenge.size());
+            client->challenge = std::to_string(currentTimeMillis());
+            client->challenge.resize(256 / 8, ' ');
+            client->sendCommand(COMMAND_SECURE_CHALLENGE, client->challenge.c_str(), client->challenge.size());
         }
     }
 
+    void rejectConnection(net::Conn& conn) {
+        // Issue a disconnect command to the client
+        uint8_t buf[sizeof(PacketHeader) + sizeof(CommandHeader)];
+        PacketHeader *tmp_phdr = (PacketHeader *) buf;
+        CommandHeader *tmp_chdr = (CommandHeader *) &buf[sizeof(PacketHeader)];
+        tmp_phdr->size = sizeof(PacketHeader) + sizeof(CommandHeader);
+        tmp_phdr->type = PACKET_TYPE_COMMAND;
+        tmp_chdr->cmd = COMMAND_DISCONNECT;
+        conn->write(tmp_phdr->size, buf);
+
+        // TODO: Find something cleaner
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        conn->close();
+    }
+
     void _clientHandler(net::Conn conn, void* ctx) {
-        // Reject if someone else is already connected
-        if (client && client->isOpen()) {
-            if (running) {
-                flog::info("REJECTED Connection from {0}, another client is already connected.", conn->getPeerName());
-
-                // Issue a disconnect command to the client
-                uint8_t buf[sizeof(PacketHeader) + sizeof(CommandHeader)];
-                PacketHeader *tmp_phdr = (PacketHeader *) buf;
-                CommandHeader *tmp_chdr = (CommandHeader *) &buf[sizeof(PacketHeader)];
-                tmp_phdr->size = sizeof(PacketHeader) + sizeof(CommandHeader);
-                tmp_phdr->type = PACKET_TYPE_COMMAND;
-                tmp_chdr->cmd = COMMAND_DISCONNECT;
-                conn->write(tmp_phdr->size, buf);
-
-                // TODO: Find something cleaner
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-                conn->close();
-
-                // Start another async accept
-                listener->acceptAsync(_clientHandler, NULL);
-                return;
-            } else {
-                // idle existing client is sent away.
-                client->close();
-                client.reset();
+        // When full, make room by sending away an idle client, reject if everyone is streaming
+        Session idle;
+        {
+            std::lock_guard<std::recursive_mutex> lck(clientsMtx);
+            int open = std::count_if(clients.begin(), clients.end(), [](const Session& c) { return c->conn->isOpen(); });
+            if (open >= maxClients) {
+                auto it = std::find_if(clients.begin(), clients.end(), [](const Session& c) { return c->conn->isOpen() && !c->running; });
+                if (it == clients.end()) {
+                    flog::info("REJECTED Connection from {0}, {1} clients are already connected.", conn->getPeerName(), open);
+                    rejectConnection(conn);
+
+                    // Start another async accept
+                    listener->acceptAsync(_clientHandler, NULL);
+                    return;
+                }
+                idle = *it;
             }
         }
+        if (idle) {
+            // idle existing client is sent away, the reaper cleans it up.
+            flog::info("Sending idle client {0} away to make room", idle->peerName);
+            idle->conn->close();
+        }
 
         flog::info("Connection from {0}", conn->getPeerName());
-        client = std::move(conn);
-        client->readAsync(sizeof(PacketHeader), rbuf, _packetHandler, NULL);
+        auto client = std::make_shared<ClientSession>(std::move(conn));
+        {
+            std::lock_guard<std::recursive_mutex> lck(clientsMtx);
+            clients.push_back(client);
+        }
+        client->conn->readAsync(sizeof(PacketHeader), client->rbuf, _packetHandler, client.get());
 
-        // Perform settings reset
-        sigpath::sourceManager.stop();
-        comp.setPCMType(dsp::compression::PCM_TYPE_I16);
-        compression = false;
+        // Perform settings reset, the source keeps running if others are streaming
+        {
+            std::lock_guard<std::recursive_mutex> lck(uiMtx);
+            if (sourceRunning && !anyClientRunning()) {
+                sigpath::sourceManager.stop();
+                sourceRunning = false;
+            }
+        }
 
-        sendSampleRate(forcedSampleRate != 0 ? forcedSampleRate: sampleRate);
+        client->sendSampleRate(clientSampleRate(client));
 
         if (authSigningKey.size() > 0) {
-            maybeSendChallenge();
+            maybeSendChallenge(client);
         }
-        maybeSendTransmitterState();
-
-
-        // TODO: Wait otherwise someone else could connect
+        maybeSendTransmitterState(client);
 
         listener->acceptAsync(_clientHandler, NULL);
     }
 
+    Session findSession(ClientSession* ptr) {
+        std::lock_guard<std::recursive_mutex> lck(clientsMtx);
+        for (auto& c : clients) {
+            if (c.get() == ptr) { return c; }
+        }
+        return NULL;
+    }
+
     void sendTransmitAction() {
+        Session client;
+        {
+            std::lock_guard<std::mutex> lck(txMtx);
+            client = txClient.lock();
+        }
+        if (!client) { return; }
         auto rv = json({});
         rv["transmitStatus"] = (bool)sigpath::transmitter->getTXStatus();;
         auto str = rv.dump();
-        strcpy((char*)s_cmd_data, str.c_str());
-        sendCommand(COMMAND_TRANSMIT_ACTION, str.length()+1); // including zero, for conv.
+        client->sendCommand(COMMAND_TRANSMIT_ACTION, str.c_str(), str.length() + 1); // including zero, for conv.
     }
 
 
     int lastSentTXStatus = 0;
     void setTxStatus(bool transmitFlag) {
-        fftCompressor.setTxMode(transmitFlag);
+        txMode = transmitFlag;
         sigpath::transmitter->setTransmitStatus(transmitFlag);
         int currentTXStatus = sigpath::transmitter->getTXStatus();
         if (currentTXStatus != lastSentTXStatus) {
@@ -326,9 +979,33 @@ namespace server {
         }
     }
 
+    int frameCount = 0;
+    long long frameCountReport = currentTimeMillis();
+
+    // Called for every IQ block from the source
+    void checkTransmitEnd() {
+        frameCount++;
+        long ct = currentTimeMillis();
+        if (ct > frameCountReport + 1000) {
+            flog::info("frame count from hardware: {}", frameCount);
+            frameCount = 0;
+            frameCountReport = ct;
+        }
+        // in main loop, stop TX when buffer has finished or when tx depressed+nobuffer
+        if (sigpath::transmitter) {
+            if (!txPressed && sigpath::transmitter->getTXStatus() == 1 && (!transmitPrebufferer.bufferReached || txPrebufferMsec == 0)) {
+                flog::info("sigpath::transmitter->setTransmitStatus(false): buffer empty, stop transmitting.");
+                transmitPacker.out.stopReader();
+                setTxStatus(false);
+            }
+        }
+    }
+
     wav::ComplexDumper txDump(48000, "/tmp/svr_txaudio_in.raw");
 
     void _packetHandler(int count, uint8_t* buf, void* ctx) {
+        Session client = findSession((ClientSession*)ctx);
+        if (!client) { return; }
         PacketHeader* hdr = (PacketHeader*)buf;
 
         // Read the rest of the data (TODO: CHECK SIZE OR SHIT WILL BE FUCKED + ADD TIMEOUT)
@@ -336,23 +1013,30 @@ namespace server {
         int read = 0;
         int goal = hdr->size - sizeof(PacketHeader);
         while (len < goal) {
-            read = client->read(goal - len, &buf[sizeof(PacketHeader) + len]);
+            read = client->conn->read(goal - len, &buf[sizeof(PacketHeader) + len]);
             if (read < 0) { return; };
             len += read;
         }
 
+        std::lock_guard<std::recursive_mutex> lck(uiMtx);
+
         // Parse and process
         if (hdr->type == PACKET_TYPE_TRANSMIT_DATA && sigpath::transmitter) {
+            {
+                std::lock_guard<std::mutex> lck(txMtx);
+                txClient = client;
+            }
             int nSamples = (hdr->size - sizeof(PacketHeader) - sizeof(float)) / (2*sizeof(int16_t));
             if (nSamples) {
                 if (!transmitDataRunning) {
                     txDump.clear();
                     transmitDataRunning = true;
+                    txPrebufferMsec = client->startCommandArguments.txPrebufferMsec;
                     transmitPacker.out.clearReadStop();
                     transmitPrebufferer.setSampleRate(48000);
                     transmitPrebufferer.clear();
                     transmitPacker.clear();
-                    transmitPrebufferer.setPrebufferMsec(startCommandArguments.txPrebufferMsec);
+                    transmitPrebufferer.setPrebufferMsec(txPrebufferMsec);
                     sigpath::transmitter->setTransmitStream(&transmitPacker.out);
                 }
                 float *fptr = (float *)(buf + sizeof(PacketHeader));
@@ -365,7 +1049,7 @@ namespace server {
                 //txDump.dump(buf + sizeof(PacketHeader), nSamples);
 //                flog::info("received samples for tx data: {}", (int)nSamples);
                 transmitDataStream.swap(nSamples);
-                if (txPressed && sigpath::transmitter->getTXStatus() == 0 && (transmitPrebufferer.bufferReached || startCommandArguments.txPrebufferMsec == 0)) {
+                if (txPressed && sigpath::transmitter->getTXStatus() == 0 && (transmitPrebufferer.bufferReached || txPrebufferMsec == 0)) {
                     flog::info("sigpath::transmitter->setTransmitStatus(true): buffer reached: {} {}",
                                (int) transmitPrebufferer.buffer.size(), (int) transmitPrebufferer.getNeededBufferSize());
                     setTxStatus(true);
@@ -379,102 +1063,22 @@ namespace server {
                 }
 
             }
-            maybeSendTransmitterState();
+            maybeSendTransmitterState(client);
         } else if (hdr->type == PACKET_TYPE_COMMAND && hdr->size >= sizeof(PacketHeader) + sizeof(CommandHeader)) {
             CommandHeader* chdr = (CommandHeader*)&buf[sizeof(PacketHeader)];
-            commandHandler((Command)chdr->cmd, &buf[sizeof(PacketHeader) + sizeof(CommandHeader)], hdr->size - sizeof(PacketHeader) - sizeof(CommandHeader));
+            commandHandler(client, (Command)chdr->cmd, &buf[sizeof(PacketHeader) + sizeof(CommandHeader)], hdr->size - sizeof(PacketHeader) - sizeof(CommandHeader));
         }
         else {
-            sendError(ERROR_INVALID_PACKET);
+            client->sendError(ERROR_INVALID_PACKET);
         }
 
         // Start another async read
-        client->readAsync(sizeof(PacketHeader), rbuf, _packetHandler, NULL);
-    }
-
-    int frameCount = 0;
-    long long frameCountReport = currentTimeMillis();
-
-    void _testServerHandler(uint8_t* data, int count, void* ctx) {
-        frameCount++;
-        long ct = currentTimeMillis();
-        if (ct > frameCountReport + 1000) {
-            flog::info("frame count from hardware: {}", frameCount);
-            frameCount = 0;
-            frameCountReport = ct;
-        }
-        // in main loop, stop TX when buffer has finished or when tx depressed+nobuffer
-        if (sigpath::transmitter) {
-            if (!txPressed && sigpath::transmitter->getTXStatus() == 1 && (!transmitPrebufferer.bufferReached || startCommandArguments.txPrebufferMsec == 0)) {
-                flog::info("sigpath::transmitter->setTransmitStatus(false): buffer empty, stop transmitting.");
-                transmitPacker.out.stopReader();
-                setTxStatus(false);
-            }
-        }
-
-        // Compress data if needed and fill out header fields
-        if ((startCommandArguments.clientCapsRequested & CLIENT_CAPS_BASEDATA_METADATA)) {
-            bb_pkt_hdr->type = PACKET_TYPE_BASEBAND_WITH_METADATA;
-            StreamMetadata *sm = (StreamMetadata*)&bbuf[sizeof(PacketHeader)];
-            sm->version = 1;
-            sm->size = sizeof(StreamMetadata);
-            sm->frequency = lastCallbackFrequency != -1 ? lastCallbackFrequency : lastTunedFrequency; // for any driver, supporting callback frequency or not.
-            sm->sampleRate = lastSampleRate;
-            sm->fftCompressed = fftCompressor.isEnabled();
-            auto dataOffset = sizeof(PacketHeader) + sizeof(StreamMetadata);
-            if (sm->fftCompressed) {
-                count = ZSTD_compressCCtx(cctx, &bbuf[dataOffset], SERVER_MAX_PACKET_SIZE-dataOffset, data, count, 1);
-            } else {
-                memcpy(&bbuf[dataOffset], data, count);
-            }
-            bb_pkt_hdr->size = dataOffset + count;
-        } else if (fftCompressor.isEnabled()) {
-            bb_pkt_hdr->type = PACKET_TYPE_BASEBAND_EXPERIMENTAL_FFT;
-            auto dataOffset = sizeof(PacketHeader);
-            count = ZSTD_compressCCtx(cctx, &bbuf[dataOffset], SERVER_MAX_PACKET_SIZE-dataOffset, data, count, 1);
-            bb_pkt_hdr->size = sizeof(PacketHeader) + count;
-        } else if (compression) {
-            bb_pkt_hdr->type = PACKET_TYPE_BASEBAND_COMPRESSED;
-            bb_pkt_hdr->size = sizeof(PacketHeader) + (uint32_t)ZSTD_compressCCtx(cctx, &bbuf[sizeof(PacketHeader)], SERVER_MAX_PACKET_SIZE-sizeof(PacketHeader), data, count, 1);
-        } else {
-            bb_pkt_hdr->type = PACKET_TYPE_BASEBAND;
-            bb_pkt_hdr->size = sizeof(PacketHeader) + count;
-            memcpy(&bbuf[sizeof(PacketHeader)], data, count);
-        }
-
-        // Write to network
-        if (client) {
-            if (client->isOpen()) {
-                client->write(bb_pkt_hdr->size, bbuf);
-                if (fftCompressor.isEnabled() && frameCount % 20 == 1 && (sigpath::transmitter == nullptr || sigpath::transmitter->getTXStatus() == 0)) {
-                    fftCompressor.sharedDataLock.lock();
-                    auto nbytes = fftCompressor.noiseFigure.size() * sizeof(fftCompressor.noiseFigure[0]);
-                    memcpy(s_cmd_data, fftCompressor.noiseFigure.data(), nbytes);
-                    fftCompressor.sharedDataLock.unlock();
-                    sendCommand(COMMAND_EFFT_NOISE_FIGURE, nbytes);
-                }
-            } else {
-                sigpath::sourceManager.stop();
-                running = false;
-                client.reset();
-                flog::error("Client is gone, stopping SDR.");
-            }
-        }
-    }
-
-    void updateResampler() {
-        if (forcedSampleRate == 0) {
-            forcedResampler.setRates(sampleRate, sampleRate);
-            fftCompressor.setSampleRate(sampleRate);
-        } else {
-            forcedResampler.setRates(sampleRate, forcedSampleRate);
-            fftCompressor.setSampleRate(forcedSampleRate);
-        }
+        client->conn->readAsync(sizeof(PacketHeader), client->rbuf, _packetHandler, client.get());
     }
 
     void setInput(dsp::stream<dsp::complex_t>* stream) {
         lastCallbackFrequency = -1;
-        forcedResampler.setInput(stream);
+        splitter.setInput(stream);
     }
 
     void setInputCenterFrequencyCallback(int centerFrequency) {
@@ -484,9 +1088,9 @@ namespace server {
         lastCallbackFrequency = centerFrequency;
     }
 
-    void commandHandler(Command cmd, uint8_t* data, int len) {
+    void commandHandler(const Session& client, Command cmd, uint8_t* data, int len) {
         if (cmd == COMMAND_GET_UI) {
-            sendUI(COMMAND_GET_UI, "", dummyElem);
+            sendUI(client, COMMAND_GET_UI, "", dummyElem);
         }
         else if (cmd == COMMAND_UI_ACTION && len >= 3) {
             // Check if sending back data is needed
@@ -497,30 +1101,33 @@ namespace server {
             // Load id
             SmGui::DrawListElem diffId;
             int count = SmGui::DrawList::loadItem(diffId, &data[i], len);
-            if (count < 0) { sendError(ERROR_INVALID_ARGUMENT); return; }
-            if (diffId.type != SmGui::DRAW_LIST_ELEM_TYPE_STRING) { sendError(ERROR_INVALID_ARGUMENT); return; } 
+            if (count < 0) { client->sendError(ERROR_INVALID_ARGUMENT); return; }
+            if (diffId.type != SmGui::DRAW_LIST_ELEM_TYPE_STRING) { client->sendError(ERROR_INVALID_ARGUMENT); return; } 
             i += count;
             len -= count;
 
             // Load value
             SmGui::DrawListElem diffValue;
             count = SmGui::DrawList::loadItem(diffValue, &data[i], len);
-            if (count < 0) { sendError(ERROR_INVALID_ARGUMENT); return; }
+            if (count < 0) { client->sendError(ERROR_INVALID_ARGUMENT); return; }
             i += count;
             len -= count;
 
             // Render and send back
             if (sendback) {
-                sendUI(COMMAND_UI_ACTION, diffId.str, diffValue);
+                sendUI(client, COMMAND_UI_ACTION, diffId.str, diffValue);
             }
             else {
                 renderUI(NULL, diffId.str, diffValue);
             }
+
+            // The receiver is shared, everyone else sees the change too
+            sendUnsolicitedUI(client.get());
         }
         else if (cmd == COMMAND_SET_EFFT_LOSS_RATE) {
             if (len == 8) {
-                double *pdata = (double*)data;
-                fftCompressor.lossRate = pdata[0];
+                double lossRate = ((double*)data)[0];
+                updateClientSettings(client, [=](EncoderSettings& s) { s.lossRate = lossRate; });
             }
         }
         else if (cmd == COMMAND_START) {
@@ -530,66 +1137,109 @@ namespace server {
                 if (magic != SDRPP_BROWN_MAGIC) {      // brown
                     // do nothing
                 } else {
-                    memset(&startCommandArguments, 0, sizeof startCommandArguments);
-                    memcpy(&startCommandArguments, pdata, len);
+                    memset(&client->startCommandArguments, 0, sizeof client->startCommandArguments);
+                    memcpy(&client->startCommandArguments, pdata, std::min<int>(len, sizeof client->startCommandArguments));
                 }
             }
             bool startAllowed = true;
             if (!authSigningKey.empty()) {
-                if (challenge.size() == 0) {
+                if (client->challenge.size() == 0) {
                     flog::info("ASSERTION FAILED: challenge not produced");
                 }
                 HMAC_SHA256_CTX ctx;
                 hmac_sha256_init(&ctx, (uint8_t *)authSigningKey.data(), authSigningKey.size());
-                hmac_sha256_update(&ctx, (uint8_t *)challenge.data(), challenge.size());
+                hmac_sha256_update(&ctx, (uint8_t *)client->challenge.data(), client->challenge.size());
                 uint8_t hmac[256 / 8];
                 hmac_sha256_final(&ctx, hmac);
-                if (memcmp(hmac, startCommandArguments.signedChallenge, sizeof hmac)) {
+                if (memcmp(hmac, client->startCommandArguments.signedChallenge, sizeof hmac)) {
                     // different?
                     startAllowed = false;
-                    maybeSendChallenge();    // send new challenge. Password incorrect.
+                    maybeSendChallenge(client);    // send new challenge. Password incorrect.
                 }
             }
             if (startAllowed) {
-                sigpath::sourceManager.start();
-                running = true;
-                maybeSendTransmitterState();
+                if (!sourceRunning) {
+                    sigpath::sourceManager.start();
+                    sourceRunning = true;
+                }
+                bool metadata = (client->startCommandArguments.clientCapsRequested & CLIENT_CAPS_BASEDATA_METADATA);
+                {
+                    std::lock_guard<std::recursive_mutex> lck(clientsMtx);
+                    client->settings.metadata = metadata;
+                    client->running = true;
+                    attachEncoder(client);
+                }
+                maybeSendTransmitterState(client);
             }
         }
         else if (cmd == COMMAND_SET_SAMPLERATE) {
-            forcedSampleRate = *(int32_t *)data;
-            updateResampler();
-            sendSampleRate(forcedSampleRate != 0 ? forcedSampleRate: sampleRate);
+            int forced = *(int32_t *)data;
+            updateClientSettings(client, [=](EncoderSettings& s) { s.forcedSampleRate = forced; });
+            client->sendSampleRate(clientSampleRate(client));
         }
         else if (cmd == COMMAND_STOP) {
-            sigpath::sourceManager.stop();
-            running = false;
-            maybeSendTransmitterState();
-            maybeSendChallenge();
+            {
+                std::lock_guard<std::recursive_mutex> lck(clientsMtx);
+                client->running = false;
+                detachEncoder(client);
+            }
+            if (sourceRunning && !anyClientRunning()) {
+                sigpath::sourceManager.stop();
+                sourceRunning = false;
+            }
+            maybeSendTransmitterState(client);
+            maybeSendChallenge(client);
         }
         else if (cmd == COMMAND_SET_FREQUENCY && len == 8) {
             lastTunedFrequency = *(double*)data;
             flog::info("Setting device to frequency: {}", (double)lastTunedFrequency);
             sigpath::sourceManager.tune(*(double*)data);
-            sendCommandAck(COMMAND_SET_FREQUENCY, 0);
+            client->sendCommandAck(COMMAND_SET_FREQUENCY, NULL, 0);
+
+            // Let the other operators follow
+            std::lock_guard<std::recursive_mutex> lck(clientsMtx);
+            for (auto& c : clients) {
+                if (c == client) { continue; }
+                double freq = lastTunedFrequency;
+                c->sendCommand(COMMAND_SET_FREQUENCY, &freq, sizeof(double));
+            }
         }
         else if (cmd == COMMAND_SET_SAMPLE_TYPE && len == 1) {
             dsp::compression::PCMType type = (dsp::compression::PCMType)*(uint8_t*)data;
-            comp.setPCMType(type);
+            updateClientSettings(client, [=](EncoderSettings& s) { s.pcmType = type; });
         }
         else if (cmd == COMMAND_SET_COMPRESSION && len == 1) {
-            compression = *(uint8_t*)data;
+            int compression = *(uint8_t*)data;
+            if (compression > BASEBAND_COMPRESSION_LOSSLESS) { compression = BASEBAND_COMPRESSION_PACKET; }
+            updateClientSettings(client, [=](EncoderSettings& s) { s.compression = compression; });
         }
         else if (cmd == COMMAND_SET_FFTZSTD_COMPRESSION && len == 1) {
-            fftCompressor.setEnabled(*(uint8_t*)data);
+            bool enabled = *(uint8_t*)data;
+            updateClientSettings(client, [=](EncoderSettings& s) { s.fftCompression = enabled; });
         }
         else if (cmd == COMMAND_SET_EFFT_MASKED_FREQUENCIES) {
             std::vector<int32_t> freqs(len / sizeof(int32_t));
-            memcpy(freqs.data(), data, len);
-            fftCompressor.setMaskedFrequencies(freqs);
+            memcpy(freqs.data(), data, freqs.size() * sizeof(int32_t));
+            updateClientSettings(client, [&](EncoderSettings& s) { s.maskedFrequencies = freqs; });
+        }
+        else if (cmd == COMMAND_GET_DSP_STATS) {
+            // Oversized stats lose their least busy blocks, a cut document would not parse on the client
+            size_t maxSize = SERVER_MAX_PACKET_SIZE - sizeof(PacketHeader) - sizeof(CommandHeader);
+            std::string stats = dsp::stats::toJson(maxSize);
+            if (stats.size() > maxSize) {
+                flog::error("DSP stats do not fit in a packet ({} bytes), not sending them", stats.size());
+                client->sendError(ERROR_INVALID_COMMAND);
+            }
+            else {
+                client->sendCommand(COMMAND_GET_DSP_STATS, stats.c_str(), stats.size());
+            }
         }
         else if (cmd == COMMAND_TRANSMIT_ACTION && sigpath::transmitter != nullptr) {
-            std::string str = std::string((char*)r_cmd_data, r_pkt_hdr->size - sizeof(PacketHeader) - sizeof(CommandHeader));
+            {
+                std::lock_guard<std::mutex> lck(txMtx);
+                txClient = client;
+            }
+            std::string str = std::string((char*)data, len);
             try {
                 auto j = json::parse(str);
                 if (j.contains("transmitStatus")) {
@@ -616,11 +1266,12 @@ namespace server {
         }
         else {
             flog::error("Invalid Command: {0} (len = {1})", (int)cmd, len);
-            sendError(ERROR_INVALID_COMMAND);
+            client->sendError(ERROR_INVALID_COMMAND);
         }
     }
 
     void drawMenu() {
+        bool running = sourceRunning;
         if (running) { SmGui::BeginDisabled(); }
         SmGui::FillWidth();
         SmGui::ForceSync();
@@ -656,65 +1307,50 @@ namespace server {
         }
     }
 
-    void sendUI(Command originCmd, std::string diffId, SmGui::DrawListElem diffValue) {
+    void sendUI(const Session& client, Command originCmd, std::string diffId, SmGui::DrawListElem diffValue) {
         // Render UI
         SmGui::DrawList dl;
         renderUI(&dl, diffId, diffValue);
 
         // Create response
-        int size = dl.getSize();
-        dl.store(s_cmd_data, size);
+        std::vector<uint8_t> data(dl.getSize());
+        dl.store(data.data(), data.size());
 
         // Send to network
         //sendCommandAck(originCmd, size);
-        sendCommand(COMMAND_GET_UI, size);
+        client->sendCommand(COMMAND_GET_UI, data.data(), data.size());
     }
 
-    void sendUnsolicitedUI() {
+    void sendUnsolicitedUI(ClientSession* except) {
+        std::lock_guard<std::recursive_mutex> lck(uiMtx);
         SmGui::DrawList dl;
         renderUI(&dl, "", dummyElem);
-        int size = dl.getSize();
-        dl.store(s_cmd_data, size);
-        sendCommand(COMMAND_GET_UI, size);
-    }
+        std::vector<uint8_t> data(dl.getSize());
+        dl.store(data.data(), data.size());
 
-    void sendError(Error err) {
-        PacketHeader* hdr = (PacketHeader*)sbuf;
-        s_pkt_data[0] = err;
-        sendPacket(PACKET_TYPE_ERROR, 1);
-    }
-
-    void sendSampleRate(double sampleRate) {
-        *(double*)s_cmd_data = sampleRate;
-        sendCommand(COMMAND_SET_SAMPLERATE, sizeof(double));
-        lastSampleRate = sampleRate;
+        std::lock_guard<std::recursive_mutex> lck2(clientsMtx);
+        for (auto& c : clients) {
+            if (c.get() == except) { continue; }
+            c->sendCommand(COMMAND_GET_UI, data.data(), data.size());
+        }
     }
 
     void sendCenterFrequency(double freq) {
-        *(double*)s_cmd_data = freq;
-        sendCommand(COMMAND_SET_FREQUENCY, sizeof(double));
+        std::lock_guard<std::recursive_mutex> lck(clientsMtx);
+        for (auto& c : clients) {
+            c->sendCommand(COMMAND_SET_FREQUENCY, &freq, sizeof(double));
+        }
     }
 
     void setInputSampleRate(double samplerate) {
+        std::lock_guard<std::recursive_mutex> lck(clientsMtx);
         sampleRate = samplerate;
-        updateResampler();
-        if (!client || !client->isOpen()) { return; }
-        sendSampleRate(forcedSampleRate != 0 ? forcedSampleRate: sampleRate);
-    }
-
-    void sendPacket(PacketType type, int len) {
-        s_pkt_hdr->type = type;
-        s_pkt_hdr->size = sizeof(PacketHeader) + len;
-        client->write(s_pkt_hdr->size, sbuf);
-    }
-
-    void sendCommand(Command cmd, int len) {
-        s_cmd_hdr->cmd = cmd;
-        sendPacket(PACKET_TYPE_COMMAND, sizeof(CommandHeader) + len);
-    }
-
-    void sendCommandAck(Command cmd, int len) {
-        s_cmd_hdr->cmd = cmd;
-        sendPacket(PACKET_TYPE_COMMAND_ACK, sizeof(CommandHeader) + len);
+        for (auto& enc : encoders) {
+            enc->updateSampleRate();
+        }
+        for (auto& c : clients) {
+            if (!c->conn->isOpen()) { continue; }
+            c->sendSampleRate(clientSampleRate(c));
+        }
     }
 }
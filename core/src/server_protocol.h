@@ -26,8 +26,22 @@ namespace server {
         PACKET_TYPE_TRANSMIT_PROGRESS,     // various indicators of transmitter. 0x38
         PACKET_TYPE_TRANSMIT_DATA,  // 0x39
         PACKET_TYPE_BASEBAND_EXPERIMENTAL_FFT,  // 0x3a
+        PACKET_TYPE_BASEBAND_ZSTD_STREAM,       // 0x3b, StreamChunkHeader + one flushed block of a ZSTD stream
+        PACKET_TYPE_BASEBAND_LOSSLESS,          // 0x3c, SampleStreamCompressor header + lossless coded I8/I16 samples
     };
 
+    // Argument of COMMAND_SET_COMPRESSION. Older servers treat any non zero value as per packet compression.
+    enum BasebandCompression {
+        BASEBAND_COMPRESSION_NONE = 0,
+        BASEBAND_COMPRESSION_PACKET,        // every packet compressed on its own (PACKET_TYPE_BASEBAND_COMPRESSED)
+        BASEBAND_COMPRESSION_STREAM,        // one ZSTD stream per encoder, window kept across packets
+        BASEBAND_COMPRESSION_LOSSLESS,      // predictive Rice coding of I8/I16 samples (dsp/compression/lossless_iq.h)
+    };
+
+    // Set on the first chunk of a new ZSTD frame, the decoder must be reset before it.
+    // Clients that miss chunks skip ahead to the next chunk carrying it.
+    static const int STREAM_CHUNK_NEW_FRAME = 0x01;
+
     enum Command {
         // Client to Server
         COMMAND_GET_UI = 0x00,      // also unsolicited, server -> client, after async update.
@@ -52,7 +66,8 @@ namespace server {
         COMMAND_SET_TRANSMITTER_NOT_SUPPORTED, // 0xA2,
         COMMAND_EFFT_NOISE_FIGURE,
         COMMAND_SECURE_CHALLENGE,
-        COMMAND_DISCONNECT
+        COMMAND_DISCONNECT,
+        COMMAND_GET_DSP_STATS,          // client asks, server responds with JSON block counters (see dsp/stats.h)
     };
 
     enum Error {
@@ -95,5 +110,11 @@ namespace server {
     struct CommandHeader {
         uint32_t cmd;
     };
+
+    struct StreamChunkHeader {
+        uint8_t flags;
+        uint8_t level;              // compression level currently used by the server
+        uint16_t cpuPermille;       // share of one core spent compressing on the server
+    };
 #pragma pack(pop)
 }
\ No newline at end of file
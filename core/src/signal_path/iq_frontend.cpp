@@ -41,6 +41,13 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
 
     split.init(preproc.out);
 
+    // Source to splitter path must never wait behind pooled work
+    inBuf.setRealtime(true);
+    decim.setRealtime(true);
+    dcBlock.setRealtime(true);
+    conjugate.setRealtime(true);
+    split.setRealtime(true);
+
     // TODO: Do something to avoid basically repeating this code twice
     int skip;
     genReshapeParams(effectiveSr, _fftSize, _fftRate, skip, _nzFFTSize);
@@ -75,6 +82,10 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
     split.bindStream(&fftIn);
     split.origin = "iqfrontent.split";
 
+    // Only bound to the splitter while enabled
+    channelizer.init(&chanIn, effectiveSr);
+    chanIn.origin = "iq_frontend.chan_in";
+
     _init = true;
 }
 
@@ -95,6 +106,7 @@ void IQFrontEnd::setSampleRate(double sampleRate) {
     effectiveSr = _sampleRate / _decimRatio;
     onEffectiveSampleRateChange.emit(effectiveSr);
     dcBlock.setRate(genDCBlockRate(effectiveSr));
+    channelizer.setInSamplerate(effectiveSr);
     for (auto& [name, vfo] : vfos) {
         vfo->setInSamplerate(effectiveSr);
     }
@@ -143,6 +155,34 @@ void IQFrontEnd::setInvertIQ(bool enabled) {
     preproc.setBlockEnabled(&conjugate, enabled, [=](dsp::stream<dsp::complex_t>* out){ split.setInput(out); });
 }
 
+void IQFrontEnd::setChannelizerEnabled(bool enabled) {
+    if (enabled == _channelizerEnabled) { return; }
+    _channelizerEnabled = enabled;
+
+    if (enabled) {
+        split.bindStream(&chanIn);
+        if (_running) { channelizer.start(); }
+        for (auto& [name, vfo] : vfos) {
+            auto ch = channelizer.addChannel(vfo->getOffset(), vfo->getRequiredSamplerate());
+            vfo->setChannel(ch);
+            vfo->setInput(&ch->out);
+            unbindIQStream(vfoStreams[name]);
+            vfoChannels[name] = ch;
+        }
+    }
+    else {
+        for (auto& [name, vfo] : vfos) {
+            bindIQStream(vfoStreams[name]);
+            vfo->setInput(vfoStreams[name]);
+            vfo->setChannel(NULL);
+            channelizer.removeChannel(vfoChannels[name]);
+        }
+        vfoChannels.clear();
+        channelizer.stop();
+        split.unbindStream(&chanIn);
+    }
+}
+
 void IQFrontEnd::bindIQStream(dsp::stream<dsp::complex_t>* stream) {
     split.bindStream(stream);
 }
@@ -159,13 +199,21 @@ dsp::channel::RxVFO* IQFrontEnd::addVFO(std::string name, double sampleRate, dou
     }
 
     // Create VFO and its input stream
-    dsp::stream<dsp::complex_t>* vfoIn = new dsp::stream<dsp::complex_t>;
+    dsp::stream<dsp::complex_t>* vfoIn = new dsp::shared_stream<dsp::complex_t>;
     dsp::channel::RxVFO* vfo = new dsp::channel::RxVFO(vfoIn, effectiveSr, sampleRate, bandwidth, offset);
 
     // Register them
     vfoStreams[name] = vfoIn;
     vfos[name] = vfo;
-    bindIQStream(vfoIn);
+    if (_channelizerEnabled) {
+        auto ch = channelizer.addChannel(offset, vfo->getRequiredSamplerate());
+        vfo->setChannel(ch);
+        vfo->setInput(&ch->out);
+        vfoChannels[name] = ch;
+    }
+    else {
+        bindIQStream(vfoIn);
+    }
 
     // Start VFO
     vfo->start();
@@ -187,7 +235,13 @@ void IQFrontEnd::removeVFO(std::string name) {
     // Stop the VFO
     vfo->stop();
 
-    unbindIQStream(vfoIn);
+    if (vfoChannels.find(name) != vfoChannels.end()) {
+        channelizer.removeChannel(vfoChannels[name]);
+        vfoChannels.erase(name);
+    }
+    else {
+        unbindIQStream(vfoIn);
+    }
     vfoStreams.erase(name);
     vfos.erase(name);
 
@@ -225,7 +279,8 @@ void IQFrontEnd::start() {
     // Start IQ splitter
     split.start();
 
-    // Start all VFOs
+    // Start channelizer and all VFOs
+    if (_channelizerEnabled) { channelizer.start(); }
     for (auto& [name, vfo] : vfos) {
         vfo->start();
     }
@@ -233,6 +288,8 @@ void IQFrontEnd::start() {
     // Start FFT chain
     reshape.start();
     fftSink.start();
+
+    _running = true;
 }
 
 void IQFrontEnd::stop() {
@@ -245,7 +302,8 @@ void IQFrontEnd::stop() {
     // Stop IQ splitter
     split.stop();
 
-    // Stop all VFOs
+    // Stop channelizer and all VFOs
+    channelizer.stop();
     for (auto& [name, vfo] : vfos) {
         vfo->stop();
     }
@@ -253,6 +311,8 @@ void IQFrontEnd::stop() {
     // Stop FFT chain
     reshape.stop();
     fftSink.stop();
+
+    _running = false;
 }
 
 double IQFrontEnd::getEffectiveSamplerate() {
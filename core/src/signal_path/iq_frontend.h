@@ -6,6 +6,7 @@
 #include "../dsp/chain.h"
 #include "../dsp/routing/splitter.h"
 #include "../dsp/channel/rx_vfo.h"
+#include "../dsp/channel/fft_channelizer.h"
 #include "../dsp/sink/handler_sink.h"
 #include "../dsp/processor.h"
 #include "../dsp/math/conjugate.h"
@@ -34,7 +35,8 @@ public:
     void setDecimation(int ratio);
     void setInvertIQ(bool enabled);
     void setDCBlocking(bool enabled);
-
+    void setChannelizerEnabled(bool enabled);
+    bool isChannelizerEnabled() { return _channelizerEnabled; }
 
     void addPreprocessor(dsp::Processor<dsp::complex_t, dsp::complex_t>* processor, bool enabled);
     void removePreprocessor(dsp::Processor<dsp::complex_t, dsp::complex_t>* processor);
@@ -100,8 +102,8 @@ protected:
     // Splitting
     dsp::routing::Splitter<dsp::complex_t> split;
 
-    // FFT
-    dsp::stream<dsp::complex_t> fftIn;
+    // FFT, the waterfall only needs the latest data so it never holds back the VFOs
+    dsp::shared_stream<dsp::complex_t> fftIn { 2, dsp::DROP_POLICY_OLDEST };
     dsp::buffer::Reshaper<dsp::complex_t> reshape;
     dsp::sink::Handler<dsp::complex_t> fftSink;
 
@@ -109,6 +111,13 @@ protected:
     std::map<std::string, dsp::stream<dsp::complex_t>*> vfoStreams;
     std::map<std::string, dsp::channel::RxVFO*> vfos;
 
+    // Shared VFO channelizer
+    dsp::shared_stream<dsp::complex_t> chanIn;
+    dsp::channel::FFTChannelizer channelizer;
+    std::map<std::string, dsp::channel::FFTChannelizer::Channel*> vfoChannels;
+    bool _channelizerEnabled = false;
+    bool _running = false;
+
     // Parameters
     double _sampleRate;
     double _decimRatio;
@@ -532,7 +532,9 @@ namespace dsp {
 
             ComplexArray npfftfft(const ComplexArray& in) override {
                 auto in0 = resize(in, nbuckets);
-                std::copy(in0->begin(), in0->end(), input->begin());
+                if (in0 != input) {
+                    std::copy(in0->begin(), in0->end(), input->begin());
+                }
 //                auto out0 = npzeros_c(nbuckets);
                 fftwf_execute(p);
 //                std::copy(output->begin(), output->end(), out0->begin());
@@ -0,0 +1,301 @@
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "arrays.h"
+
+namespace dsp::arrays::expr {
+    // Lazy, fused counterpart of the numpy style functions of arrays.h.
+    //
+    // Operands are FloatArray/ComplexArray, std::vector, scalars or view(ptr, size), combined with the
+    // usual operators and the functions below. Nothing is computed until the expression is assigned:
+    //
+    //     assign(out, npexp((view(a) + b) * c));
+    //
+    // runs one loop over the elements into an existing buffer, where npexp(mul(addeach(a, b), c))
+    // allocates three arrays and walks memory three times. Operands must have the same size. The output
+    // may be one of the operands, since element i only reads index i of each of them.
+    //
+    // An expression used twice is computed twice, assign() shared intermediates to a scratch vector.
+    // eval() materializes an expression into a new array where the allocating API is expected.
+
+    struct ExprBase {};
+
+    template <class E>
+    constexpr bool is_expr_v = std::is_base_of_v<ExprBase, E>;
+
+    template <class T>
+    struct Ref : ExprBase {
+        using value_type = T;
+        const T* data;
+        int n;
+        T operator[](int i) const { return data[i]; }
+        int size() const { return n; }
+    };
+
+    // Scalar operand, size() is -1 so the other operand decides
+    template <class T>
+    struct Const : ExprBase {
+        using value_type = T;
+        T value;
+        T operator[](int i) const { return value; }
+        int size() const { return -1; }
+    };
+
+    template <class Op, class A>
+    struct Unary : ExprBase {
+        using value_type = decltype(Op::apply(std::declval<typename A::value_type>()));
+        A a;
+        value_type operator[](int i) const { return Op::apply(a[i]); }
+        int size() const { return a.size(); }
+    };
+
+    template <class Op, class A, class B>
+    struct Binary : ExprBase {
+        using value_type = decltype(Op::apply(std::declval<typename A::value_type>(), std::declval<typename B::value_type>()));
+        A a;
+        B b;
+        value_type operator[](int i) const { return Op::apply(a[i], b[i]); }
+        int size() const { return (a.size() >= 0) ? a.size() : b.size(); }
+    };
+
+    template <class T>
+    inline Ref<T> view(const T* data, int size) { return Ref<T>{ {}, data, size }; }
+
+    template <class T>
+    inline Ref<T> view(const std::vector<T>& v) { return view(v.data(), (int)v.size()); }
+
+    template <class T>
+    inline Ref<T> view(const std::shared_ptr<std::vector<T>>& v) { return view(*v); }
+
+    template <class X>
+    inline auto wrap(const X& x) {
+        if constexpr (is_expr_v<X>) {
+            return x;
+        }
+        else if constexpr (std::is_same_v<X, FloatArray> || std::is_same_v<X, ComplexArray> ||
+                           std::is_same_v<X, std::vector<float>> || std::is_same_v<X, std::vector<complex_t>>) {
+            return view(x);
+        }
+        else if constexpr (std::is_same_v<X, complex_t>) {
+            return Const<complex_t>{ {}, x };
+        }
+        else {
+            static_assert(std::is_arithmetic_v<X>, "Unsupported operand type");
+            return Const<float>{ {}, (float)x };
+        }
+    }
+
+    template <class X>
+    using wrap_t = decltype(wrap(std::declval<X>()));
+
+    template <class A, class B>
+    constexpr bool any_expr_v = is_expr_v<A> || is_expr_v<B>;
+
+    namespace ops {
+        struct Add {
+            static float apply(float a, float b) { return a + b; }
+            static complex_t apply(complex_t a, complex_t b) { return complex_t{ a.re + b.re, a.im + b.im }; }
+        };
+        struct Sub {
+            static float apply(float a, float b) { return a - b; }
+            static complex_t apply(complex_t a, complex_t b) { return complex_t{ a.re - b.re, a.im - b.im }; }
+        };
+        struct Mul {
+            static float apply(float a, float b) { return a * b; }
+            static complex_t apply(complex_t a, float b) { return complex_t{ a.re * b, a.im * b }; }
+            static complex_t apply(float a, complex_t b) { return complex_t{ a * b.re, a * b.im }; }
+            static complex_t apply(complex_t a, complex_t b) { return complex_t{ (a.re * b.re) - (a.im * b.im), (a.im * b.re) + (a.re * b.im) }; }
+        };
+        struct Div {
+            static float apply(float a, float b) { return a / b; }
+            static complex_t apply(complex_t a, float b) { return complex_t{ a.re / b, a.im / b }; }
+        };
+        struct Max {
+            static float apply(float a, float b) { return std::max<float>(a, b); }
+        };
+        struct Min {
+            static float apply(float a, float b) { return std::min<float>(a, b); }
+        };
+        struct Neg {
+            static float apply(float a) { return -a; }
+            static complex_t apply(complex_t a) { return complex_t{ -a.re, -a.im }; }
+        };
+        struct Exp {
+            static float apply(float a) { return expf(a); }
+        };
+        // Same approximation as the SIMD kernels of volk_32f_expfast_32f, a few % error, vectorizes
+        struct ExpFast {
+            static float apply(float a) {
+                int32_t bits = (int32_t)(a * (8388608.0f / 0.6931471805f) + (1065353216.0f - 60801.0f));
+                float v;
+                memcpy(&v, &bits, sizeof(v));
+                return v;
+            }
+        };
+        struct Log {
+            static float apply(float a) { return logf(a); }
+        };
+        struct Sqrt {
+            static float apply(float a) { return sqrtf(a); }
+        };
+        struct Square {
+            static float apply(float a) { return a * a; }
+        };
+        struct Abs {
+            static float apply(float a) { return fabsf(a); }
+            static float apply(complex_t a) { return a.amplitude(); }
+        };
+        struct Real {
+            static float apply(complex_t a) { return a.re; }
+        };
+        struct Conj {
+            static complex_t apply(complex_t a) { return a.conj(); }
+        };
+        struct ToComplex {
+            static complex_t apply(float a) { return complex_t{ a, 0 }; }
+        };
+        struct Expn {
+            static float apply(float a) { return dsp::math::expn(a); }
+        };
+    }
+
+    template <class Op, class A, class B>
+    inline Binary<Op, wrap_t<A>, wrap_t<B>> binary(const A& a, const B& b) { return { {}, wrap(a), wrap(b) }; }
+
+    template <class Op, class A>
+    inline Unary<Op, A> unary(const A& a) { return { {}, a }; }
+
+    // Arithmetic, at least one operand has to be an expression so the allocating operators of arrays.h keep working
+    template <class A, class B, std::enable_if_t<any_expr_v<A, B>, int> = 0>
+    inline auto operator+(const A& a, const B& b) { return binary<ops::Add>(a, b); }
+
+    template <class A, class B, std::enable_if_t<any_expr_v<A, B>, int> = 0>
+    inline auto operator-(const A& a, const B& b) { return binary<ops::Sub>(a, b); }
+
+    template <class A, class B, std::enable_if_t<any_expr_v<A, B>, int> = 0>
+    inline auto operator*(const A& a, const B& b) { return binary<ops::Mul>(a, b); }
+
+    template <class A, class B, std::enable_if_t<any_expr_v<A, B>, int> = 0>
+    inline auto operator/(const A& a, const B& b) { return binary<ops::Div>(a, b); }
+
+    template <class A, std::enable_if_t<is_expr_v<A>, int> = 0>
+    inline auto operator-(const A& a) { return unary<ops::Neg>(a); }
+
+    // Element wise functions, same names as their allocating versions
+    template <class A, class B, std::enable_if_t<any_expr_v<A, B>, int> = 0>
+    inline auto npmaximum(const A& a, const B& b) { return binary<ops::Max>(a, b); }
+
+    template <class A, class B, std::enable_if_t<any_expr_v<A, B>, int> = 0>
+    inline auto npminimum(const A& a, const B& b) { return binary<ops::Min>(a, b); }
+
+    template <class A, std::enable_if_t<is_expr_v<A>, int> = 0>
+    inline auto npexp(const A& a) { return unary<ops::Exp>(a); }
+
+    template <class A, std::enable_if_t<is_expr_v<A>, int> = 0>
+    inline auto npexpfast(const A& a) { return unary<ops::ExpFast>(a); }
+
+    template <class A, std::enable_if_t<is_expr_v<A>, int> = 0>
+    inline auto nplog(const A& a) { return unary<ops::Log>(a); }
+
+    template <class A, std::enable_if_t<is_expr_v<A>, int> = 0>
+    inline auto npsqrt(const A& a) { return unary<ops::Sqrt>(a); }
+
+    template <class A, std::enable_if_t<is_expr_v<A>, int> = 0>
+    inline auto square(const A& a) { return unary<ops::Square>(a); }
+
+    template <class A, std::enable_if_t<is_expr_v<A>, int> = 0>
+    inline auto npabsolute(const A& a) { return unary<ops::Abs>(a); }
+
+    template <class A, std::enable_if_t<is_expr_v<A>, int> = 0>
+    inline auto real(const A& a) { return unary<ops::Real>(a); }
+
+    template <class A, std::enable_if_t<is_expr_v<A>, int> = 0>
+    inline auto conj(const A& a) { return unary<ops::Conj>(a); }
+
+    template <class A, std::enable_if_t<is_expr_v<A>, int> = 0>
+    inline auto tocomplex(const A& a) { return unary<ops::ToComplex>(a); }
+
+    template <class A, std::enable_if_t<is_expr_v<A>, int> = 0>
+    inline auto scipyspecialexpn(const A& a) { return unary<ops::Expn>(a); }
+
+    // Evaluation
+    template <class T, class E>
+    inline void assign(T* out, const E& e, int size) {
+        static_assert(is_expr_v<E>, "assign() takes an expression");
+        for (int i = 0; i < size; i++) {
+            out[i] = e[i];
+        }
+    }
+
+    // Evaluates in place when out already has the expression's size. Otherwise the result goes to a new
+    // vector that then replaces out, resizing first would leave views of out inside the expression dangling.
+    template <class T, class E>
+    inline void assign(std::vector<T>& out, const E& e) {
+        if ((int)out.size() == e.size()) {
+            assign(out.data(), e, e.size());
+            return;
+        }
+        std::vector<T> result(e.size());
+        assign(result.data(), e, e.size());
+        out.swap(result);
+    }
+
+    template <class T, class E>
+    inline void assign(const std::shared_ptr<std::vector<T>>& out, const E& e) {
+        assign(*out, e);
+    }
+
+    template <class E>
+    inline std::shared_ptr<std::vector<typename E::value_type>> eval(const E& e) {
+        auto retval = std::make_shared<std::vector<typename E::value_type>>(e.size());
+        assign(retval->data(), e, e.size());
+        return retval;
+    }
+
+    // Reductions, without materializing the expression
+    template <class E, std::enable_if_t<is_expr_v<E>, int> = 0>
+    inline typename E::value_type npsum(const E& e) {
+        typename E::value_type total{};
+        int n = e.size();
+        for (int i = 0; i < n; i++) {
+            total = ops::Add::apply(total, e[i]);
+        }
+        return total;
+    }
+
+    template <class E, std::enable_if_t<is_expr_v<E>, int> = 0>
+    inline float npmax(const E& e) {
+        float m = e[0];
+        int n = e.size();
+        for (int i = 1; i < n; i++) {
+            m = std::max<float>(m, e[i]);
+        }
+        return m;
+    }
+
+    template <class E, std::enable_if_t<is_expr_v<E>, int> = 0>
+    inline float npmin(const E& e) {
+        float m = e[0];
+        int n = e.size();
+        for (int i = 1; i < n; i++) {
+            m = std::min<float>(m, e[i]);
+        }
+        return m;
+    }
+
+    // True if no element is zero
+    template <class E, std::enable_if_t<is_expr_v<E>, int> = 0>
+    inline bool npall(const E& e) {
+        int n = e.size();
+        for (int i = 0; i < n; i++) {
+            if (e[i] == 0) { return false; }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,239 @@
+#include "async_file_writer.h"
+#include <string.h>
+#include <algorithm>
+#include <volk/volk.h>
+#include <utils/flog.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+// Block sizes are kept a multiple of this so every write but the last one stays aligned for direct I/O
+#define ASYNC_FILE_ALIGNMENT 4096
+
+AsyncFileWriter::~AsyncFileWriter() {
+    close();
+}
+
+void AsyncFileWriter::configure(size_t blockSize, int blockCount, bool directIO, bool dropOnOverrun) {
+    this->blockSize = std::max<size_t>((blockSize + ASYNC_FILE_ALIGNMENT - 1) / ASYNC_FILE_ALIGNMENT, 1) * ASYNC_FILE_ALIGNMENT;
+    this->blockCount = std::max<int>(blockCount, 2);
+    this->directIO = directIO;
+    this->dropOnOverrun = dropOnOverrun;
+}
+
+bool AsyncFileWriter::open(const std::string& path) {
+    if (opened) { close(); }
+
+#ifdef _WIN32
+    file = std::ofstream(path, std::ios::out | std::ios::binary);
+    if (!file.is_open()) { return false; }
+#else
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    // Not every filesystem takes O_DIRECT (tmpfs for one), fall back to buffered writes there
+    if (directIO) { fd = ::open(path.c_str(), flags | O_DIRECT, 0644); }
+#endif
+    if (fd < 0) { fd = ::open(path.c_str(), flags, 0644); }
+    if (fd < 0) { return false; }
+#ifdef __APPLE__
+    if (directIO) { fcntl(fd, F_NOCACHE, 1); }
+#endif
+    reserved = 0;
+    canReserve = true;
+#endif
+
+    // Allocate the whole ring up front so recording never allocates
+    blocks.assign(blockCount, NULL);
+    lengths.assign(blockCount, 0);
+    for (auto& b : blocks) {
+        b = (uint8_t*)volk_malloc(blockSize, ASYNC_FILE_ALIGNMENT);
+        if (b) { continue; }
+        flog::error("AsyncFileWriter: could not allocate {} blocks of {} bytes", blockCount, blockSize);
+        for (auto& f : blocks) {
+            if (f) { volk_free(f); }
+        }
+        blocks.clear();
+#ifdef _WIN32
+        file.close();
+#else
+        ::close(fd);
+        fd = -1;
+#endif
+        return false;
+    }
+    writeIdx = 0;
+    readIdx = 0;
+    fill = 0;
+    accepted = 0;
+    written = 0;
+    patches.clear();
+    overruns = 0;
+    ioError = false;
+    stopping = false;
+
+    opened = true;
+    workerThread = std::thread(&AsyncFileWriter::worker, this);
+    return true;
+}
+
+bool AsyncFileWriter::isOpen() {
+    return opened;
+}
+
+void AsyncFileWriter::close() {
+    if (!opened) { return; }
+
+    // Hand over the partial block and let the worker drain the ring
+    if (fill) { publish(); }
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        stopping = true;
+    }
+    dataCV.notify_one();
+    workerThread.join();
+
+    finish();
+
+    for (auto& b : blocks) { volk_free(b); }
+    blocks.clear();
+    opened = false;
+}
+
+bool AsyncFileWriter::write(const void* data, size_t len) {
+    if (!opened) { return false; }
+
+    // In drop mode the write goes in whole or not at all, so the file never holds a partial sample block
+    if (dropOnOverrun) {
+        uint64_t queued = writeIdx.load(std::memory_order_relaxed) - readIdx.load(std::memory_order_acquire);
+        size_t space = (blockCount - queued) * blockSize - fill;
+        if (len > space) {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    const uint8_t* src = (const uint8_t*)data;
+    while (len) {
+        if (!fill && !dropOnOverrun) { waitForFreeBlock(); }
+        size_t n = std::min<size_t>(len, blockSize - fill);
+        memcpy(&blocks[writeIdx.load(std::memory_order_relaxed) % blockCount][fill], src, n);
+        fill += n;
+        src += n;
+        len -= n;
+        accepted += n;
+        if (fill == blockSize) { publish(); }
+    }
+    return true;
+}
+
+void AsyncFileWriter::patch(uint64_t offset, const void* data, size_t len) {
+    Patch p;
+    p.offset = offset;
+    p.data.assign((const uint8_t*)data, (const uint8_t*)data + len);
+    patches.push_back(std::move(p));
+}
+
+void AsyncFileWriter::publish() {
+    uint64_t w = writeIdx.load(std::memory_order_relaxed);
+    lengths[w % blockCount] = fill;
+    fill = 0;
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        writeIdx.store(w + 1, std::memory_order_release);
+    }
+    dataCV.notify_one();
+}
+
+void AsyncFileWriter::waitForFreeBlock() {
+    std::unique_lock<std::mutex> lck(mtx);
+    spaceCV.wait(lck, [this]() { return writeIdx.load(std::memory_order_relaxed) - readIdx.load(std::memory_order_relaxed) < (uint64_t)blockCount; });
+}
+
+void AsyncFileWriter::worker() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lck(mtx);
+            dataCV.wait(lck, [this]() { return readIdx.load(std::memory_order_relaxed) != writeIdx.load(std::memory_order_relaxed) || stopping; });
+            if (readIdx.load(std::memory_order_relaxed) == writeIdx.load(std::memory_order_relaxed)) { break; }
+        }
+
+        // After an error the blocks are still consumed so the producer keeps running
+        uint64_t r = readIdx.load(std::memory_order_relaxed);
+        if (!ioError && !writeOut(blocks[r % blockCount], lengths[r % blockCount])) {
+            flog::error("AsyncFileWriter: write failed after {} bytes, the rest of the recording is lost", written);
+            ioError = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            readIdx.store(r + 1, std::memory_order_release);
+        }
+        spaceCV.notify_one();
+    }
+}
+
+bool AsyncFileWriter::writeOut(const uint8_t* data, size_t len) {
+#ifdef _WIN32
+    file.write((const char*)data, len);
+    if (!file.good()) { return false; }
+#else
+#ifdef __linux__
+    // Reserve a ring's worth of space ahead of the data to keep the file contiguous and allocation off the write path
+    if (canReserve && written + len > reserved) {
+        uint64_t step = (uint64_t)blockSize * blockCount;
+        if (fallocate(fd, FALLOC_FL_KEEP_SIZE, reserved, step) == 0) {
+            reserved += step;
+        }
+        else {
+            canReserve = false;
+        }
+    }
+#endif
+#ifdef O_DIRECT
+    // Only the final block can be short, direct I/O can't write it
+    if (len % ASYNC_FILE_ALIGNMENT) {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags & O_DIRECT) { fcntl(fd, F_SETFL, flags & ~O_DIRECT); }
+    }
+#endif
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = ::write(fd, &data[done], len - done);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n <= 0) { return false; }
+        done += n;
+    }
+#endif
+    written += len;
+    return true;
+}
+
+void AsyncFileWriter::finish() {
+#ifdef _WIN32
+    for (auto& p : patches) {
+        file.seekp(p.offset);
+        file.write((const char*)p.data.data(), p.data.size());
+    }
+    file.close();
+#else
+#ifdef O_DIRECT
+    int flags = fcntl(fd, F_GETFL);
+    if (flags & O_DIRECT) { fcntl(fd, F_SETFL, flags & ~O_DIRECT); }
+#endif
+    // Releases the space reserved past the end
+    if (ftruncate(fd, written) != 0) {
+        flog::warn("AsyncFileWriter: could not trim the file to {} bytes", written);
+    }
+    for (auto& p : patches) {
+        if (p.offset + p.data.size() > written) { continue; }
+        if (pwrite(fd, p.data.data(), p.data.size(), p.offset) != (ssize_t)p.data.size()) {
+            flog::error("AsyncFileWriter: could not update the header at offset {}", p.offset);
+        }
+    }
+    ::close(fd);
+    fd = -1;
+#endif
+    patches.clear();
+}
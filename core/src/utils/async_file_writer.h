@@ -0,0 +1,95 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <stdint.h>
+#include <stddef.h>
+#ifdef _WIN32
+#include <fstream>
+#endif
+
+// File output that takes the disk off the caller's thread.
+//
+// write() copies into a preallocated ring of large, page aligned blocks and returns; a dedicated thread
+// writes each block out as soon as it fills. Space on disk is reserved ahead of the writes and the file
+// can optionally bypass the page cache (O_DIRECT on Linux, F_NOCACHE on macOS), so sustained rates
+// don't depend on the kernel's writeback.
+//
+// In drop mode a write that doesn't fit in the free part of the ring is discarded whole and counted as an
+// overrun, so a stalled disk never blocks the producer. Otherwise write() waits for space.
+class AsyncFileWriter {
+public:
+    AsyncFileWriter() {}
+    ~AsyncFileWriter();
+
+    // Ring geometry and I/O mode. Only takes effect on the next open().
+    void configure(size_t blockSize, int blockCount, bool directIO, bool dropOnOverrun);
+
+    bool open(const std::string& path);
+    bool isOpen();
+    void close();
+
+    // Queues len bytes. Returns false when they were dropped because the ring was full.
+    bool write(const void* data, size_t len);
+
+    // Number of bytes accepted so far, the logical end of the file
+    uint64_t tell() { return accepted; }
+
+    // Overwrites bytes already passed to write(), used for headers. Applied at close once the data is on disk.
+    void patch(uint64_t offset, const void* data, size_t len);
+
+    int getBlockCount() { return blockCount; }
+    int getQueueDepth() { return (int)(writeIdx.load(std::memory_order_relaxed) - readIdx.load(std::memory_order_relaxed)); }
+    uint64_t getOverruns() { return overruns.load(std::memory_order_relaxed); }
+    bool hasError() { return ioError.load(std::memory_order_relaxed); }
+
+private:
+    struct Patch {
+        uint64_t offset;
+        std::vector<uint8_t> data;
+    };
+
+    void publish();
+    void waitForFreeBlock();
+    void worker();
+    bool writeOut(const uint8_t* data, size_t len);
+    void finish();
+
+    // Configuration
+    size_t blockSize = 1 << 20;
+    int blockCount = 4;
+    bool directIO = false;
+    bool dropOnOverrun = false;
+
+    // Ring, blocks [readIdx, writeIdx) are waiting for the disk and block writeIdx is being filled
+    std::vector<uint8_t*> blocks;
+    std::vector<size_t> lengths;
+    std::atomic<uint64_t> writeIdx = 0;
+    std::atomic<uint64_t> readIdx = 0;
+    size_t fill = 0;
+    uint64_t accepted = 0;
+    std::vector<Patch> patches;
+
+    std::mutex mtx;
+    std::condition_variable dataCV;
+    std::condition_variable spaceCV;
+    bool stopping = false;
+    std::thread workerThread;
+
+    std::atomic<uint64_t> overruns = 0;
+    std::atomic<bool> ioError = false;
+
+    // Disk side, only touched by the worker thread while open
+    bool opened = false;
+    uint64_t written = 0;
+#ifdef _WIN32
+    std::ofstream file;
+#else
+    int fd = -1;
+    uint64_t reserved = 0;
+    bool canReserve = true;
+#endif
+};
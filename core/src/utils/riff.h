@@ -4,6 +4,7 @@
 #include <string>
 #include <stack>
 #include <stdint.h>
+#include "async_file_writer.h"
 
 namespace riff {
 #pragma pack(push, 1)
@@ -15,7 +16,7 @@ namespace riff {
 
     struct ChunkDesc {
         ChunkHeader hdr;
-        std::streampos pos;
+        uint64_t pos;
     };
 
     class Writer {
@@ -34,14 +35,18 @@ namespace riff {
         void beginChunk(const char id[4]);
         void endChunk();
 
-        void write(const uint8_t* data, size_t len);
+        // Returns false when the data was dropped, see AsyncFileWriter
+        bool write(const uint8_t* data, size_t len);
+
+        // Disk output, configure before open()
+        AsyncFileWriter& output() { return file; }
 
     private:
         void beginRIFF(const char form[4]);
         void endRIFF();
 
         std::recursive_mutex mtx;
-        std::ofstream file;
+        AsyncFileWriter file;
         std::stack<ChunkDesc> chunks;
     };
 
@@ -7,6 +7,7 @@
 
 namespace wav {
     const char* WAVE_FILE_TYPE          = "WAVE";
+    const char* IQZ_FILE_TYPE           = "IQZ ";
     const char* FORMAT_MARKER           = "fmt ";
     const char* DATA_MARKER             = "data";
     const uint32_t FORMAT_HEADER_LEN    = 16;
@@ -40,6 +41,7 @@ namespace wav {
 
         // Reset work values
         samplesWritten = 0;
+        samplesDropped = 0;
 
         // Fill header
         bytesPerSamp = (SAMP_BITS[_type] / 8) * _channels;
@@ -68,8 +70,15 @@ namespace wav {
             break;
         }
 
+        // The lossless codec only takes Int16 here, with at most two channels
+        if (_format == FORMAT_IQZ) {
+            if (_type != SAMP_TYPE_INT16 || _channels > 2) { close(); return false; }
+            // Room for the size prefix, so a block goes out in a single write
+            bufIQZ = dsp::buffer::alloc<uint8_t>(sizeof(uint32_t) + dsp::compression::lossless::maxEncodedSize(STREAM_BUFFER_SIZE, _channels, sizeof(int16_t)));
+        }
+
         // Open file
-        if (!rw.open(path, WAVE_FILE_TYPE)) { return false; }
+        if (!rw.open(path, (_format == FORMAT_IQZ) ? IQZ_FILE_TYPE : WAVE_FILE_TYPE)) { return false; }
 
         // Write format chunk
         rw.beginChunk(FORMAT_MARKER);
@@ -89,14 +98,11 @@ namespace wav {
 
     void Writer::close() {
         std::lock_guard<std::recursive_mutex> lck(mtx);
-        // Do nothing if the file is not open
-        if (!rw.isOpen()) { return; }
-
-        // Finish data chunk
-        rw.endChunk();
-
-        // Close the file
-        rw.close();
+        // Finish data chunk and close the file
+        if (rw.isOpen()) {
+            rw.endChunk();
+            rw.close();
+        }
 
         // Free buffers
         if (bufU8) {
@@ -111,6 +117,10 @@ namespace wav {
             dsp::buffer::free(bufI32);
             bufI32 = NULL;
         }
+        if (bufIQZ) {
+            dsp::buffer::free(bufIQZ);
+            bufIQZ = NULL;
+        }
     }
 
     void Writer::setChannels(int channels) {
@@ -147,6 +157,13 @@ namespace wav {
         _type = type;
     }
 
+    void Writer::setBuffering(size_t blockSize, int blockCount, bool directIO, bool dropOnOverrun) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        // Do not allow settings to change while open
+        if (rw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        rw.output().configure(blockSize, blockCount, directIO, dropOnOverrun);
+    }
+
     void Writer::write(float* samples, int count) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         if (!rw.isOpen()) { return; }
@@ -154,30 +171,43 @@ namespace wav {
         // Select different writer function depending on the chose depth
         int tcount = count * _channels;
         int tbytes = count * bytesPerSamp;
+        bool ok = false;
         switch (_type) {
         case SAMP_TYPE_UINT8:
             // Volk doesn't support unsigned ints yet :/
             for (int i = 0; i < tcount; i++) {
                 bufU8[i] = (samples[i] * 127.0f) + 128.0f;
             }
-            rw.write(bufU8, tbytes);
+            ok = rw.write(bufU8, tbytes);
             break;
         case SAMP_TYPE_INT16:
             volk_32f_s32f_convert_16i(bufI16, samples, 32767.0f, tcount);
-            rw.write((uint8_t*)bufI16, tbytes);
+            if (_format == FORMAT_IQZ) {
+                uint32_t size = dsp::compression::lossless::encode<int16_t>(bufI16, count, _channels, &bufIQZ[sizeof(size)]);
+                memcpy(bufIQZ, &size, sizeof(size));
+                ok = rw.write(bufIQZ, sizeof(size) + size);
+            }
+            else {
+                ok = rw.write((uint8_t*)bufI16, tbytes);
+            }
             break;
         case SAMP_TYPE_INT32:
             volk_32f_s32f_convert_32i(bufI32, samples, 2147483647.0f, tcount);
-            rw.write((uint8_t*)bufI32, tbytes);
+            ok = rw.write((uint8_t*)bufI32, tbytes);
             break;
         case SAMP_TYPE_FLOAT32:
-            rw.write((uint8_t*)samples, tbytes);
+            ok = rw.write((uint8_t*)samples, tbytes);
             break;
         default:
             break;
         }
 
-        // Increment sample counter
-        samplesWritten += count;
+        // Increment sample counter, dropped blocks are left out of the file entirely
+        if (ok) {
+            samplesWritten += count;
+        }
+        else {
+            samplesDropped += count;
+        }
     }
 }
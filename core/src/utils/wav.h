@@ -3,9 +3,13 @@
 #include <fstream>
 #include <stdint.h>
 #include <mutex>
+#include <atomic>
 #include "riff.h"
 #include "dsp/types.h"
+#include "dsp/stream.h"
+#include "dsp/compression/lossless_iq.h"
 #include <string.h>
+#include <vector>
 #ifndef _WIN32
 #include <unistd.h>
 #endif
@@ -25,7 +29,8 @@ namespace wav {
 
     enum Format {
         FORMAT_WAV,
-        FORMAT_RF64
+        FORMAT_RF64,
+        FORMAT_IQZ      // RIFF "IQZ " form, the data chunk holds lossless coded Int16 blocks
     };
 
     enum SampleType {
@@ -54,7 +59,14 @@ namespace wav {
         void setFormat(Format format);
         void setSampleType(SampleType type);
 
+        // Disk output ring, see AsyncFileWriter. With dropOnOverrun set, write() never waits on the disk.
+        void setBuffering(size_t blockSize, int blockCount, bool directIO, bool dropOnOverrun);
+
         size_t getSamplesWritten() { return samplesWritten; }
+        size_t getSamplesDropped() { return samplesDropped; }
+        int getQueueDepth() { return rw.output().getQueueDepth(); }
+        int getQueueSize() { return rw.output().getBlockCount(); }
+        bool hasIOError() { return rw.output().hasError(); }
 
         void write(float* samples, int count);
 
@@ -72,7 +84,9 @@ namespace wav {
         uint8_t* bufU8 = NULL;
         int16_t* bufI16 = NULL;
         int32_t* bufI32 = NULL;
-        size_t samplesWritten = 0;
+        uint8_t* bufIQZ = NULL;
+        std::atomic<size_t> samplesWritten = 0;
+        std::atomic<size_t> samplesDropped = 0;
     };
 
     struct ComplexDumper {
@@ -129,7 +143,8 @@ namespace wav {
             valid = false;
             error = "signature mismatch";
             if (memcmp(hdr.signature, "RIFF", 4) != 0) { return; }
-            if (memcmp(hdr.fileType, "WAVE", 4) != 0) { return; }
+            compressed = (memcmp(hdr.fileType, "IQZ ", 4) == 0);
+            if (memcmp(hdr.fileType, "WAVE", 4) != 0 && !compressed) { return; }
             error = "";
             valid = true;
         }
@@ -150,7 +165,21 @@ namespace wav {
             return valid;
         }
 
+        // Lossless IQZ file, samples are returned decoded as Int16
+        bool isCompressed() {
+            return compressed;
+        }
+
         void readSamples(void* data, size_t size) {
+            if (compressed) {
+                size_t read = readDecoded((uint8_t*)data, size);
+                if (read < size) {
+                    rewind();
+                    readDecoded((uint8_t*)data + read, size - read);
+                }
+                bytesRead += size;
+                return;
+            }
             char* _data = (char*)data;
             file.read(_data, size);
             int read = file.gcount();
@@ -163,6 +192,7 @@ namespace wav {
         }
 
         size_t readSamples2(void* data, size_t size) {
+            if (compressed) { return readDecoded((uint8_t*)data, size); }
             char* _data = (char*)data;
             file.read(_data, size);
             int read = file.gcount();
@@ -170,7 +200,10 @@ namespace wav {
         }
 
         void rewind() {
+            file.clear();
             file.seekg(sizeof(WavHeader_t));
+            decoded.clear();
+            decodedPos = 0;
         }
 
         void close() {
@@ -194,7 +227,41 @@ namespace wav {
             uint32_t dataSize;
         };
 
+        // Copies out decoded samples, decoding the next blocks as needed, until size bytes or the end of the file
+        size_t readDecoded(uint8_t* data, size_t size) {
+            size_t done = 0;
+            while (done < size) {
+                if (decodedPos == decoded.size() && !decodeBlock()) { break; }
+                size_t n = std::min<size_t>(size - done, decoded.size() - decodedPos);
+                memcpy(&data[done], &decoded[decodedPos], n);
+                decodedPos += n;
+                done += n;
+            }
+            return done;
+        }
+
+        // Block layout: uint32 size, then a dsp::compression::lossless buffer of that size
+        bool decodeBlock() {
+            uint32_t size = 0;
+            file.read((char*)&size, sizeof(size));
+            if (file.gcount() != sizeof(size) || !size || size > (uint32_t)dsp::compression::lossless::maxEncodedSize(STREAM_BUFFER_SIZE, 2, sizeof(int16_t))) { return false; }
+            encoded.resize(size);
+            file.read((char*)encoded.data(), size);
+            if ((uint32_t)file.gcount() != size) { return false; }
+
+            int frames = dsp::compression::lossless::frameCount<int16_t>(encoded.data(), size);
+            if (frames < 0 || frames > STREAM_BUFFER_SIZE) { return false; }
+            int channels = ((dsp::compression::lossless::Header*)encoded.data())->channels;
+            decoded.resize(frames * channels * sizeof(int16_t));
+            decodedPos = 0;
+            return dsp::compression::lossless::decode<int16_t>(encoded.data(), size, (int16_t*)decoded.data(), frames) == frames;
+        }
+
         bool valid = false;
+        bool compressed = false;
+        std::vector<uint8_t> encoded;
+        std::vector<uint8_t> decoded;
+        size_t decodedPos = 0;
         std::ifstream file;
         size_t bytesRead = 0;
         WavHeader_t hdr;
@@ -1,9 +1,16 @@
 #pragma once
 
-#define NEW_BUILTIN_MODE
-
 #include <core.h>
 #include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <tuple>
+#include <climits>
+#include <functional>
+#include <filesystem>
 #include <utils/wav.h>
 #include <utils/riff.h>
 #include "symbolic.h"
@@ -28,12 +35,15 @@
 #include <io.h>
 #endif
 
-#ifdef NEW_BUILTIN_MODE
+#include <dsp/multirate/rational_resampler.h>
 #include "ft8_etc/mshv_support.h"
 #include "ft8_etc/mscore.h"
 #include "ft8_etc/decoderms.h"
-#include "symbolic.h"
-#endif
+
+namespace ft8 {
+    // mshv decoder entry point, sdrpp_ft8_mshv.cpp
+    void decodeFT8(int threads, const char *mode, int sampleRate, dsp::stereo_t* samples, long long nsamples, int depth, std::function<void(const char*)> callback);
+}
 
 namespace dsp {
 
@@ -119,33 +129,97 @@ namespace dsp {
 #endif
 
         enum {
-            DMS_FT8 = 11
+            DMS_FT8 = 11,
+            DMS_FT4 = 13
         } DecoderMSMode;
 
-#ifdef NEW_BUILTIN_MODE
+        // One decode, as the mshv decoder prints it:
+        // FT8_OUT	1675635874870	30	{0}	120000	{1}	-19	{2}	0.2	{3}	775	{4}	SQ9KWU DL1PP -14	{5}	? 0	{6}	0.1	{7}	1975
+        struct DecodedMessage {
+            std::string time;       // {0} block time given to the decoder
+            int snr = 0;            // {1} dB
+            float dt = 0;           // {2} sec
+            std::string message;    // {4} with "|call1;call2" appended when the message had hashed callsigns
+            float quality = 0;      // {6} 0..1
+            int frequency = 0;      // {3} audio frequency relative to 1200 Hz ({7} minus 1200), Hz
+        };
+
+        inline bool parseDecodedLine(const std::string& line, DecodedMessage& out) {
+            if (line.rfind("FT8_OUT", 0) != 0 && line.rfind("FT4_OUT", 0) != 0) {
+                return false;
+            }
+            std::vector<std::string> fields;
+            splitStringV(line, "\t\n", fields);
+            if (fields.size() <= 18) {
+                return false;
+            }
+            out.time = fields[4];
+            out.snr = atoi(fields[6].c_str());
+            out.dt = (float)atof(fields[8].c_str());
+            out.message = fields[12];
+            out.quality = (float)atof(fields[16].c_str());
+            out.frequency = atoi(fields[10].c_str());
+            return true;
+        }
 
-        void invokeDecoder(int nthreads, const std::string &mode, const std::string &wavPath, const std::string &outPath,
-                               const std::string &errPath, std::function<void(int mode, std::vector<std::string> result, std::atomic<const char *> &progress)> callback, std::atomic<const char *> &progress);
+        inline std::string getTempPath() {
+            std::string tempPath;
+            core::configManager.acquire();
+            if (core::configManager.conf.find("tempDir") != core::configManager.conf.end()) {
+                tempPath = core::configManager.conf["tempDir"];
+            }
+            core::configManager.release(false);
 
-#else
+            if (tempPath.empty()) {
+                tempPath = (std::string) core::args["temp"];
+            }
+
+            if (tempPath.empty()) {
+                std::error_code ec;
+                auto p = std::filesystem::temp_directory_path(ec);
+                if (!ec.value()) {
+                    tempPath = std::string(wstr::wstr2str(p.c_str()));
+                } else {
+                    tempPath = "/tmp";
+                }
+            }
+            return tempPath;
+        }
 
-        void invokeDecoder(int nthreads, const std::string &mode, const std::string &wavPath, const std::string &outPath,
-                           const std::string &errPath, std::function<void(int mode, std::vector<std::string> result, std::atomic<const char *> &progress)> callback, std::atomic<const char *> &progress) {
+        // mshv keeps its decoder state in process globals, held around every in-process decodeFT8() call
+        inline std::mutex mshvMtx;
 
+        // Location of the sdrpp_ft8_mshv helper, only built with OPT_BUILD_FT8_MSHV_HELPER
+        inline std::string helperPath() {
 #ifdef __ANDROID__
             Dl_info info;
-            dladdr((void *) &invokeDecoder, &info);
+            dladdr((void *) &helperPath, &info);
             auto path = std::string(info.dli_fname);
             path = path.substr(0, path.rfind('/'));
-            auto decoderPath = path + "/sdrpp_ft8_mshv.so";
+            return path + "/sdrpp_ft8_mshv.so";
 #else
             core::configManager.acquire();
             std::string modules = core::configManager.conf["modulesDirectory"];
             core::configManager.release(false);
-            auto decoderPath = modules+"/../../sdrpp_ft8_mshv";
 #ifdef _WIN32
-            decoderPath = modules + "/../sdrpp_ft8_mshv.exe";
-            auto cmd = decoderPath + " --decode " + wavPath + " --mode " + mode+" --threads "+std::to_string(nthreads);
+            return modules + "/../sdrpp_ft8_mshv.exe";
+#else
+            return modules + "/../../sdrpp_ft8_mshv";
+#endif
+#endif
+        }
+
+        inline bool helperAvailable() {
+            std::error_code ec;
+            return std::filesystem::exists(helperPath(), ec);
+        }
+
+        // Runs the sdrpp_ft8_mshv helper on a WAV file and reads its results back from its stdout file.
+        inline void invokeDecoder(int nthreads, int depth, const std::string &mode, const std::string &wavPath, const std::string &outPath,
+                                  const std::string &errPath, const std::function<void(const DecodedMessage&)>& onMessage, std::string& error) {
+            auto decoderPath = helperPath();
+#ifdef _WIN32
+            auto cmd = decoderPath + " --decode " + wavPath + " --mode " + mode+" --threads "+std::to_string(nthreads)+" --depth "+std::to_string(depth);
             std::replace(cmd.begin(), cmd.end(), '/', '\\');
             flog::info("FT8decoder: spawn: {}", cmd);
             FILE* data = popen_gpt4(cmd.c_str(), "r");
@@ -153,44 +227,25 @@ namespace dsp {
             if (data) {
                 char line[4096];
                 while (fgets(line, sizeof(line), data)) {
-                    if (strstr(line, "DECODE_EOF") != 0 ) {
-                        std::vector<std::string> selected;
-                        selected.emplace_back("DECODE_EOF");
-                        callback(DMS_FT8, selected, progress);
-                    }
-                    if (strncmp(line, "FT8_OUT", 7) != 0 || strncmp(line, "FT4_OUT", 7) != 0) {
-                        std::vector<std::string> singleBroken;
-                        splitStringV(std::string(line), "\t", singleBroken);
-                        std::vector<std::string> selected;
-                        // FT8_OUT	1675635874870	30	{0}	120000	{1}	-19	{2}	0.2	{3}	775	{4}	SQ9KWU DL1PP -14	{5}	? 0	{6}	0.1	{7}	1975
-                        if (singleBroken.size() > 18) {
-                            selected.emplace_back(singleBroken[4]);
-                            selected.emplace_back(singleBroken[6]);
-                            selected.emplace_back(singleBroken[8]);
-                            selected.emplace_back(singleBroken[10]);
-                            selected.emplace_back(singleBroken[12]);
-                            selected.emplace_back(singleBroken[14]);
-                            selected.emplace_back(singleBroken[16]);
-                            selected.emplace_back(singleBroken[18]);
-                            count++;
-                            callback(DMS_FT8, selected, progress);
-                        }
+                    DecodedMessage msg;
+                    if (parseDecodedLine(line, msg)) {
+                        count++;
+                        onMessage(msg);
                     }
                 }
                 int status = _pclose(data);
                 if (status == 0) {
                     flog::info("FT8 Decoder ({}): process ended. Count messages: {}", mode, count);
                 } else {
-                    printf("Command exited with status %d\n", status);
+                    error = "decoder exited with status " + std::to_string(status);
                 }
             } else {
-                printf("Failed to popen %s\n", cmd.c_str());
+                error = "decoder exec failed";
+                flog::error("Failed to popen {}", cmd);
             }
             return;
 #endif // _WIN32
 
-#endif // __ANDROID__
-
             // non-windows code
 #ifndef _WIN32
 
@@ -204,7 +259,9 @@ namespace dsp {
             strcpy(mydta->args[5], mode.c_str());
             strcpy(mydta->args[6], "--threads");
             snprintf(mydta->args[7], sizeof mydta->args[7], "%d", nthreads);
-            mydta->nargs = 8;
+            strcpy(mydta->args[8], "--depth");
+            snprintf(mydta->args[9], sizeof mydta->args[9], "%d", depth);
+            mydta->nargs = 10;
             strcpy(mydta->errPath, errPath.c_str());
             strcpy(mydta->outPath, outPath.c_str());
             strcpy(mydta->info, mode.c_str());
@@ -215,202 +272,352 @@ namespace dsp {
             int nwaiting = 0;
             int STEP_USEC = 100000;
             int MAXWAITING_STEPS = 20000000 / STEP_USEC;  // 20 second max decode
-//            flog::info("Forked, waiting outside {} steps for {} for files", MAXWAITING_STEPS, mode);
 
             while (true) {
-                progress = "usleeping";
                 auto finished = mydta->completed.load();
                 if (finished && mydta->completeStatus != 0) {
-                    std::vector<std::string> selected;
-                    selected.emplace_back("ERROR");
-                    selected.emplace_back("decoder exec failed");
-                    progress = "pre-err-callback";
-                    callback(DMS_FT8, selected, progress);
-                    progress = "post-err-callback";
+                    error = "decoder exec failed";
                 }
-//                flog::info("Usleep {} begin for {}", nwaiting, mode);
                 usleep(STEP_USEC);
                 nwaiting++;
-//                flog::info("Usleep {} finished for {}, outpath={}", nwaiting-1, mode, outPath.c_str());
                 if (nwaiting > MAXWAITING_STEPS) {
-                    progress = "break_maxwait";
                     flog::warn("MAXWAITING_STEPS elapsed for {} -> will abort",mode);
+                    error = "decoder timed out";
                     break;
                 }
-                try {
-                    progress = "open...";
-                    auto hdl = open(outPath.c_str(), O_RDONLY);
-                    progress = "opened.";
-                    char rdbuf[30000];
-                    if (hdl > 0) {
-                        int nrd = read(hdl, rdbuf, sizeof(rdbuf) - 1);
-                        progress = "freaded";
-                        if (nrd > 0) {
-                            rdbuf[sizeof rdbuf - 1] = 0;
-                            rdbuf[nrd] = 0;
-                            std::vector<std::string> thisResult;
-                            progress = "split...";
-                            splitString(rdbuf, "\n", [&](const std::string& p) {
-                                if (p.find("FT8_OUT") == 0 || p.find("FT4_OUT") == 0 || p.find("ERROR") == 0 || p.find("DECODE_EOF") == 0) {
-                                    thisResult.emplace_back(p);
-                                }
-                            });
-                            progress = "split ok";
-//                            flog::info("ft8 read bytes: {} split {}", nrd, (int)thisResult.size());
-                            for (int q = nsent; q < thisResult.size(); q++) {
-                                std::vector<std::string> singleBroken;
-                                progress = "split small";
-                                splitStringV(thisResult[q], "\t", singleBroken);
-                                progress = "split small ok";
-                                flog::info("ft8 from decoder: {}", thisResult[q]);
-                                std::vector<std::string> selected;
-                                // FT8_OUT	1675635874870	30	{0}	120000	{1}	-19	{2}	0.2	{3}	775	{4}	SQ9KWU DL1PP -14	{5}	? 0	{6}	0.1	{7}	1975
-                                if (singleBroken.size() > 18) {
-                                    selected.emplace_back(singleBroken[4]);
-                                    selected.emplace_back(singleBroken[6]);
-                                    selected.emplace_back(singleBroken[8]);
-                                    selected.emplace_back(singleBroken[10]);
-                                    selected.emplace_back(singleBroken[12]);
-                                    selected.emplace_back(singleBroken[14]);
-                                    selected.emplace_back(singleBroken[16]);
-                                    selected.emplace_back(singleBroken[18]);
-                                    progress = "pre-callback";
-                                    callback(DMS_FT8, selected, progress);
-                                    progress = "post-callback";
-                                }
-                                if (singleBroken.size() > 1 && singleBroken[0] == "ERROR") {
-                                    selected.emplace_back("ERROR");
-                                    selected.emplace_back(singleBroken[1]);
-                                    progress = "pre-err-callback";
-                                    callback(DMS_FT8, selected, progress);
-                                    progress = "post-err-callback";
-                                }
-                                if (singleBroken.size() >= 1 && singleBroken[0] == "DECODE_EOF") {
-                                    flog::info("DECODE_EOF");
-                                    finished = true;
-                                    selected.emplace_back("DECODE_EOF");
-                                    progress = "pre-eof-callback";
-                                    callback(DMS_FT8, selected, progress);
-                                    progress = "post-eof-callback";
-                                }
-                                count++;
+                auto hdl = open(outPath.c_str(), O_RDONLY);
+                char rdbuf[30000];
+                if (hdl > 0) {
+                    int nrd = read(hdl, rdbuf, sizeof(rdbuf) - 1);
+                    if (nrd > 0) {
+                        rdbuf[nrd] = 0;
+                        std::vector<std::string> thisResult;
+                        splitString(rdbuf, "\n", [&](const std::string& p) {
+                            if (p.find("FT8_OUT") == 0 || p.find("FT4_OUT") == 0 || p.find("ERROR") == 0 || p.find("DECODE_EOF") == 0) {
+                                thisResult.emplace_back(p);
+                            }
+                        });
+                        for (int q = nsent; q < thisResult.size(); q++) {
+                            DecodedMessage msg;
+                            if (parseDecodedLine(thisResult[q], msg)) {
+                                onMessage(msg);
+                            }
+                            else if (thisResult[q].find("ERROR") == 0) {
+                                error = thisResult[q].substr(std::min<size_t>(6, thisResult[q].size()));
+                            }
+                            else if (thisResult[q].find("DECODE_EOF") == 0) {
+                                finished = true;
                             }
-                            nsent = thisResult.size();
+                            count++;
                         }
-                        progress = "pre-close";
-                        close(hdl);
-                        progress = "post-close";
+                        nsent = thisResult.size();
                     }
-                } catch (std::runtime_error &err) {
-                    progress = "except";
-                    flog::info("EXCEPTION for {}: {}", mode, err.what());
-                    finished = true;
+                    close(hdl);
                 }
                 if (finished) {
-                    progress = "finishing..";
-                    flog::info("FT8 - finished");
-//                    flog::info("Breaking the loop for {}", mode);
                     break;
                 }
             }
             core::removeForkInProgress(mydta->seq);
             flog::info("FT8 Decoder ({}): process ended. Count messages: {}", mode, count);
-            progress = "finished ok.";
 #endif // !win32
         }
 
-#endif // NEW_BUILTIN_MODE
-
-        inline void decodeFT8(int nthreads, const std::string &mode, int sampleRate, dsp::stereo_t *samples, long long nsamples,
-                              std::function<void(int mode, std::vector<std::string> result, std::atomic<const char *> &progress)> callback,
-                              std::atomic<const char *> &progress, bool removeFiles
-                              ) {
 
-            static std::atomic_int _seq = 100;
-            int seq = ++_seq;
-            std::string seqS = std::to_string(seq);
-            //
-            //
-            //
+        // Shared decode scheduler for all bands and modes. Blocks are decoded on persistent workers that
+        // together never run more decoder threads than the thread budget, so at the cycle boundary the bands
+        // queue up instead of all competing for the CPU at once. Jobs are taken by priority, then by deadline.
+        // When the time left before a job's deadline is shorter than the decode time measured on its band,
+        // the decode depth is lowered so the results still arrive before the next block.
+        //
+        // By default the mshv decoder runs in this process, straight from the block the caller filled, and
+        // results come back parsed through onMessage. mshv is not reentrant, so only one in-process job runs
+        // at a time and it takes what the budget allows, up to MSHV_MAX_THREADS. With isolate set the block goes
+        // through a WAV file in the temp directory and the sdrpp_ft8_mshv helper process instead, so a decoder
+        // crash does not take SDR++ down with it, and isolated jobs of several bands share the budget.
+        class DecoderPool {
+        public:
+            struct Job {
+                std::string mode;                                       // "ft8" or "ft4"
+                std::string band;                                       // key for the statistics, e.g. "14.074 ft8"
+                int priority = 0;                                       // lower runs first
+                long long deadline = 0;                                 // currentTimeMillis() when the next block is due, 0 for none
+                int sampleRate = 12000;
+                std::shared_ptr<std::vector<dsp::stereo_t>> block;      // read in place, not copied
+                int threads = 1;                                        // decoder threads wanted in isolated mode, granted from the budget
+                int depth = 3;                                          // deepest decode wanted, 1..3
+                bool isolate = false;
+                bool keepFiles = false;                                 // isolated mode, keep the WAV for debugging
+                std::function<void(const DecodedMessage&)> onMessage;   // called from the worker thread
+                std::function<void(const std::string& error)> onDone;   // error is empty on success
+            };
+
+            struct BandStats {
+                int queueWait = 0;          // ms from submit to start, last block
+                int decodeTime = 0;         // ms, last block
+                int depth = 0;              // depth the last block ran at
+                int threads = 0;            // decoder threads the last block got
+                int degraded = 0;           // blocks decoded below the depth they asked for
+                int late = 0;               // blocks finished after their deadline
+                float fullDepthTime = 0;    // running estimate of a depth 3 decode, ms
+            };
+
+            ~DecoderPool() {
+                stop();
+            }
 
-            std::string tempPath;
-            core::configManager.acquire();
-            if (core::configManager.conf.find("tempDir") != core::configManager.conf.end()) {
-                tempPath = core::configManager.conf["tempDir"];
+            void start(int nworkers) {
+                std::lock_guard<std::mutex> lck(jobMtx);
+                if (!workers.empty()) { return; }
+                stopping = false;
+                threadBudget = nworkers;
+                for (int i = 0; i < nworkers; i++) {
+                    auto w = std::make_unique<Worker>();
+                    w->thread = std::thread(&DecoderPool::workerLoop, this, w.get());
+                    workers.emplace_back(std::move(w));
+                }
             }
-            core::configManager.release(false);
 
-            if (tempPath.empty()) {
-                tempPath = (std::string) core::args["temp"];
+            // Waits for the jobs that are running, the queued ones complete with an error
+            void stop() {
+                std::deque<Queued> dropped;
+                {
+                    std::lock_guard<std::mutex> lck(jobMtx);
+                    stopping = true;
+                    dropped.swap(jobs);
+                }
+                jobCV.notify_all();
+                for (auto& w : workers) {
+                    if (w->thread.joinable()) { w->thread.join(); }
+                }
+                workers.clear();
+                for (auto& q : dropped) {
+                    if (q.job.onDone) { q.job.onDone("decoder stopped"); }
+                }
             }
 
-            if (tempPath.empty()) {
-                std::error_code ec;
-                auto p = std::filesystem::temp_directory_path(ec);
-                if (!ec.value()) {
-                    tempPath = std::string(wstr::wstr2str(p.c_str()));
-                } else {
-                    tempPath = "/tmp";
+            // Decoder threads shared by all running jobs, at most the number of workers
+            void setThreadBudget(int threads) {
+                {
+                    std::lock_guard<std::mutex> lck(jobMtx);
+                    threadBudget = std::clamp<int>(threads, 1, std::max<int>(1, workers.size()));
                 }
+                jobCV.notify_all();
             }
 
+            int getThreadBudget() {
+                std::lock_guard<std::mutex> lck(jobMtx);
+                return threadBudget;
+            }
 
-            std::vector<dsp::stereo_t> samplez;
-            samplez.resize(nsamples);
-            std::vector<dsp::stereo_t> resampledV;
+            void submit(Job job) {
+                {
+                    std::lock_guard<std::mutex> lck(jobMtx);
+                    jobs.emplace_back(Queued{ std::move(job), currentTimeMillis(), nextSeq++ });
+                }
+                jobCV.notify_one();
+            }
 
-            int max = 0;
-            for (int i = 0; i < nsamples; i++) {
-                max = std::max<float>(abs(samples[i].l), max);
-                max = std::max<float>(abs(samples[i].r), max);
+            int queued() {
+                std::lock_guard<std::mutex> lck(jobMtx);
+                return (int)jobs.size();
             }
 
-//            flog::info("max: {}", max);
-            if (max == 0) {
-                max = 1;        // leave zeros. whatever.
+            std::map<std::string, BandStats> getStats() {
+                std::lock_guard<std::mutex> lck(jobMtx);
+                return stats;
             }
-            for (int i = 0; i < nsamples; i++) {
-                samplez[i].l = samples[i].l / max;
-                samplez[i].r = samples[i].r / max;
+
+        private:
+            struct Worker {
+                std::thread thread;
+                std::vector<dsp::stereo_t> normalized;
+                std::vector<dsp::stereo_t> resampled;
+                dsp::multirate::RationalResampler<dsp::stereo_t> resamp;
+                int resampRate = 0;
+            };
+
+            struct Queued {
+                Job job;
+                long long submitted;
+                uint64_t seq;
+
+                bool before(const Queued& other) const {
+                    long long d = job.deadline ? job.deadline : LLONG_MAX;
+                    long long od = other.job.deadline ? other.job.deadline : LLONG_MAX;
+                    return std::make_tuple(job.priority, d, seq) < std::make_tuple(other.job.priority, od, other.seq);
+                }
+            };
+
+            // Decoder threads mshv can use for one decode. Its multi-threaded path is stubbed out in this tree
+            // (DecoderMs::SetDecode aborts when it would start the threads), so a decode runs on one.
+            static constexpr int MSHV_MAX_THREADS = 1;
+
+            // Relative cost of the decode depths: 3 = three passes with OSD, 2 = three passes BP only, 1 = one pass
+            static constexpr float DEPTH_COST[4] = { 0.0f, 0.25f, 0.6f, 1.0f };
+
+            int chooseDepth(const Job& job, const BandStats& st, long long now) {
+                int depth = std::clamp<int>(job.depth, 1, 3);
+                if (job.deadline == 0 || st.fullDepthTime <= 0) { return depth; }
+                long long left = job.deadline - now;
+                while (depth > 1 && st.fullDepthTime * DEPTH_COST[depth] > left) {
+                    depth--;
+                }
+                return depth;
             }
-            samples = samplez.data();
-
-            if (sampleRate != 12000) {
-                long long int outSize = 3 * (nsamples * 12000) / sampleRate;
-                resampledV.resize(outSize);
-                dsp::multirate::RationalResampler<dsp::stereo_t> res;
-                res.init(nullptr, sampleRate, 12000);
-                nsamples = res.process(nsamples, samples, resampledV.data());
-                samples = resampledV.data();
+
+            void workerLoop(Worker* w) {
+                SetThreadName("ft8_decoder_pool");
+                while (true) {
+                    Job job;
+                    int threads;
+                    int depth;
+                    long long started;
+                    {
+                        std::unique_lock<std::mutex> lck(jobMtx);
+                        auto next = jobs.end();
+                        jobCV.wait(lck, [&] {
+                            if (stopping) { return true; }
+                            if (threadsInUse >= threadBudget) { return false; }
+                            next = jobs.end();
+                            for (auto it = jobs.begin(); it != jobs.end(); it++) {
+                                if (!it->job.isolate && inProcessRunning) { continue; }
+                                if (next == jobs.end() || it->before(*next)) { next = it; }
+                            }
+                            return next != jobs.end();
+                        });
+                        if (stopping) { return; }
+                        started = currentTimeMillis();
+                        auto& st = stats[next->job.band];
+                        st.queueWait = (int)(started - next->submitted);
+                        job = std::move(next->job);
+                        jobs.erase(next);
+
+                        if (job.isolate) {
+                            threads = std::clamp<int>(threadBudget - threadsInUse, 1, std::max<int>(1, job.threads));
+                        }
+                        else {
+                            threads = std::clamp<int>(threadBudget - threadsInUse, 1, MSHV_MAX_THREADS);
+                            inProcessRunning = true;
+                        }
+                        threadsInUse += threads;
+                        depth = chooseDepth(job, st, started);
+                        st.threads = threads;
+                        st.depth = depth;
+                        if (depth < job.depth) { st.degraded++; }
+                    }
+
+                    std::string error;
+                    try {
+                        run(w, job, threads, depth, error);
+                    }
+                    catch (std::exception& e) {
+                        error = e.what();
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> lck(jobMtx);
+                        auto end = currentTimeMillis();
+                        auto& st = stats[job.band];
+                        st.decodeTime = (int)(end - started);
+                        float full = st.decodeTime / DEPTH_COST[depth];
+                        st.fullDepthTime = (st.fullDepthTime > 0) ? 0.7f * st.fullDepthTime + 0.3f * full : full;
+                        if (job.deadline && end > job.deadline) { st.late++; }
+                        threadsInUse -= threads;
+                        if (!job.isolate) { inProcessRunning = false; }
+                    }
+                    jobCV.notify_all();
+
+                    if (job.onDone) { job.onDone(error); }
+                }
             }
 
-            wav::Writer w;
-            w.setChannels(2);
-            w.setFormat(wav::FORMAT_WAV);
-            w.setSampleType(wav::SAMP_TYPE_FLOAT32);
-            w.setSamplerate(12000);
-            auto wavPath = tempPath + "/sdrpp_ft8_mshv.wav." + seqS;
-            w.open(wavPath);
-            w.write((float *) samples, nsamples);
-            w.close();
+            void run(Worker* w, Job& job, int threads, int depth, std::string& error) {
+                const dsp::stereo_t* in = job.block->data();
+                long long nsamples = job.block->size();
 
+                float max = 0;
+                for (long long i = 0; i < nsamples; i++) {
+                    max = std::max<float>(fabsf(in[i].l), max);
+                    max = std::max<float>(fabsf(in[i].r), max);
+                }
+                float scale = (max > 0) ? 1.0f / max : 1.0f;        // leave zeros. whatever.
+                w->normalized.resize(nsamples);
+                for (long long i = 0; i < nsamples; i++) {
+                    w->normalized[i].l = in[i].l * scale;
+                    w->normalized[i].r = in[i].r * scale;
+                }
+                dsp::stereo_t* samples = w->normalized.data();
 
-            auto outPath = tempPath + "/sdrpp_ft8_mshv.out." + seqS;
-            auto errPath = tempPath + "/sdrpp_ft8_mshv.err." + seqS;
+                if (job.sampleRate != 12000) {
+                    if (!w->resampRate) {
+                        w->resamp.init(nullptr, job.sampleRate, 12000);
+                    }
+                    else if (w->resampRate != job.sampleRate) {
+                        w->resamp.setInSamplerate(job.sampleRate);
+                    }
+                    else {
+                        w->resamp.reset();
+                    }
+                    w->resampRate = job.sampleRate;
+                    w->resampled.resize(3 * (nsamples * 12000) / job.sampleRate);
+                    nsamples = w->resamp.process(nsamples, samples, w->resampled.data());
+                    samples = w->resampled.data();
+                }
 
-            invokeDecoder(nthreads, mode, wavPath, outPath, errPath, callback, progress);
+                if (!job.isolate) {
+                    std::lock_guard<std::mutex> lck(mshvMtx);
+                    ::ft8::decodeFT8(threads, job.mode.c_str(), 12000, samples, nsamples, depth, [&](const char* line) {
+                        DecodedMessage msg;
+                        if (parseDecodedLine(line, msg) && job.onMessage) {
+                            job.onMessage(msg);
+                        }
+                    });
+                    return;
+                }
 
-            if (removeFiles) {
-                std::filesystem::remove(wavPath);
-                std::filesystem::remove(outPath);
-                std::filesystem::remove(errPath);
-            } else {
-                flog::info("keeping WAV file: {}", wavPath);
+                static std::atomic_int _seq = 100;
+                std::string seqS = std::to_string(++_seq);
+                std::string tempPath = getTempPath();
+
+                wav::Writer wr;
+                wr.setChannels(2);
+                wr.setFormat(wav::FORMAT_WAV);
+                wr.setSampleType(wav::SAMP_TYPE_FLOAT32);
+                wr.setSamplerate(12000);
+                auto wavPath = tempPath + "/sdrpp_ft8_mshv.wav." + seqS;
+                wr.open(wavPath);
+                wr.write((float *) samples, nsamples);
+                wr.close();
+
+                auto outPath = tempPath + "/sdrpp_ft8_mshv.out." + seqS;
+                auto errPath = tempPath + "/sdrpp_ft8_mshv.err." + seqS;
+
+                invokeDecoder(threads, depth, job.mode, wavPath, outPath, errPath, [&](const DecodedMessage& msg) {
+                    if (job.onMessage) { job.onMessage(msg); }
+                }, error);
+
+                if (!job.keepFiles) {
+                    std::error_code ec;
+                    std::filesystem::remove(wavPath, ec);
+                    std::filesystem::remove(outPath, ec);
+                    std::filesystem::remove(errPath, ec);
+                } else {
+                    flog::info("keeping WAV file: {}", wavPath);
+                }
             }
 
-            return;
-        }
+            std::mutex jobMtx;
+            std::condition_variable jobCV;
+            std::deque<Queued> jobs;
+            uint64_t nextSeq = 0;
+            std::vector<std::unique_ptr<Worker>> workers;
+            int threadBudget = 1;
+            int threadsInUse = 0;
+            bool inProcessRunning = false;
+            std::map<std::string, BandStats> stats;
+            bool stopping = false;
+        };
     }
 
 }
-
@@ -66,7 +66,6 @@ void DecoderFt4::SetStMultiAnswerMod(bool f)
 {
     f_multi_answer_mod4 = f;
 }
-static int s_decoder_deep4 = 1;
 void DecoderFt4::SetStDecoderDeep(int d)
 {
     s_decoder_deep4 = d;
@@ -125,7 +125,6 @@ void DecoderFt8::SetStDecode(QString time,int mousebutton,bool ffopen)
     s_mousebutton8 = mousebutton;//mousebutton Left=1, Right=3 fullfile=0 rtd=2
     s_fopen8 = ffopen;//2.66 for ap7 s_fopen8
 }
-static int s_decoder_deep8 = 1;
 void DecoderFt8::SetStDecoderDeep(int d)
 {
     s_decoder_deep8 = d;
@@ -366,7 +366,17 @@ void DecoderMs::SetDecoderDeep(int d)
 {
     s_decoder_deep = d;
     DecFt8_0->SetStDecoderDeep(d);
+    DecFt8_1->SetStDecoderDeep(d);
+    DecFt8_2->SetStDecoderDeep(d);
+    DecFt8_3->SetStDecoderDeep(d);
+    DecFt8_4->SetStDecoderDeep(d);
+    DecFt8_5->SetStDecoderDeep(d);
     DecFt4_0->SetStDecoderDeep(d);
+    DecFt4_1->SetStDecoderDeep(d);
+    DecFt4_2->SetStDecoderDeep(d);
+    DecFt4_3->SetStDecoderDeep(d);
+    DecFt4_4->SetStDecoderDeep(d);
+    DecFt4_5->SetStDecoderDeep(d);
     DecQ65->SetStDecoderDeep(d);  //qDebug()<<"s_decoder_deep="<<s_decoder_deep;
 }
 void DecoderMs::SetSingleDecQ65(bool f)
@@ -35,6 +35,7 @@
 class DecoderFt8
 {
     int outCount = 0;
+    int s_decoder_deep8 = 1;    // per instance, DecoderMs::SetDecoderDeep sets it on every decoder thread
 public:
     explicit DecoderFt8(int id, std::shared_ptr<F2a> f2a);
     ~DecoderFt8();
@@ -155,6 +156,7 @@ class DecoderFt4
 {
 
     int outCount;
+    int s_decoder_deep4 = 1;    // per instance, DecoderMs::SetDecoderDeep sets it on every decoder thread
 
 public:
     explicit DecoderFt4(int id, std::shared_ptr<F2a> f2a);
@@ -159,6 +159,8 @@ struct CallHashCache {
 };
 
 bool removeFiles = true;
+bool isolateDecoder = false;            // run the decoder as a separate process, fed through WAV files
+dsp::ft8::DecoderPool decoderPool;
 
 struct DecodedResult {
     DecodedMode mode;
@@ -756,6 +758,11 @@ public:
         if (config.conf[name].find("nthreads") != config.conf[name].end()) {
             nthreads = config.conf[name]["nthreads"];
         }
+        threadBudget = std::max<int>(1, std::thread::hardware_concurrency() / 2);
+        if (config.conf[name].contains("threadBudget")) {
+            threadBudget = config.conf[name]["threadBudget"];
+        }
+        decoderPool.setThreadBudget(threadBudget);
         if (config.conf[name].contains("processingEnabledFT8")) {
             ft8decoder.processingEnabled = config.conf[name]["processingEnabledFT8"].get<bool>();
         }
@@ -768,8 +775,16 @@ public:
         if (config.conf[name].find("enableALLTXT") != config.conf[name].end()) {
             enableAllTXT = config.conf[name]["enableALLTXT"].get<bool>();
         }
+        if (config.conf[name].contains("isolateDecoder")) {
+            isolateDecoder = config.conf[name]["isolateDecoder"].get<bool>();
+        }
         config.release(true);
 
+        helperAvailable = dsp::ft8::helperAvailable();
+        if (isolateDecoder && !helperAvailable) {
+            flog::warn("FT8 decoder helper {} not found, decoding in-process", dsp::ft8::helperPath());
+        }
+
         gui::menu.registerEntry(name, menuHandler, this, this);
 
         std::for_each(allDecoders.begin(), allDecoders.end(), [&](SingleDecoder* d) {
@@ -791,6 +806,20 @@ public:
         ImGui::LeftLabel("Remove FT8 WAVs");
         ImGui::FillWidth();
         ImGui::Checkbox("##keep_ft8_wavs", &removeFiles);
+        ImGui::LeftLabel("Decoder in separate process");
+        ImGui::FillWidth();
+        if (!helperAvailable) { style::beginDisabled(); }
+        bool isolate = isolateDecoder && helperAvailable;
+        if (ImGui::Checkbox("##ft8_isolate_decoder", &isolate)) {
+            isolateDecoder = isolate;
+            config.acquire();
+            config.conf[name]["isolateDecoder"] = isolateDecoder;
+            config.release(true);
+        }
+        if (!helperAvailable) {
+            style::endDisabled();
+            ImGui::TextDisabled("sdrpp_ft8_mshv helper not installed");
+        }
         ImGui::Text("ft8en %d onfreq %d", allDecoders[0]->mod->enabled, allDecoders[0]->onTheFrequency);
     }
 
@@ -798,6 +827,10 @@ public:
 
     ~FT8DecoderModule() {
         disable();
+        // decoder pool jobs call back into the decoders
+        while (std::any_of(allDecoders.begin(), allDecoders.end(), [](SingleDecoder* d) { return d->blockProcessorsRunning.load() > 0; })) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
         gui::waterfall.afterWaterfallDraw.unbindHandler(&afterWaterfallDrawListener);
         std::for_each(allDecoders.begin(), allDecoders.end(), [&](SingleDecoder* d) {
             d->destroy();
@@ -855,6 +888,13 @@ public:
             config.conf[_this->name]["nthreads"] = _this->nthreads;
             config.release(true);
         }
+        ImGui::FillWidth();
+        if (ImGui::SliderInt("##ft8_thread_budget", &_this->threadBudget, 1, std::max<int>(2, std::thread::hardware_concurrency()), "%d threads for all bands", 0)) {
+            decoderPool.setThreadBudget(_this->threadBudget);
+            config.acquire();
+            config.conf[_this->name]["threadBudget"] = _this->threadBudget;
+            config.release(true);
+        }
 
         auto ft8processing = _this->ft8decoder.blockProcessorsRunning.load();
         if (ft8processing) {
@@ -919,6 +959,18 @@ public:
             ImGui::PopStyleColor();
         }
         //
+        // Per band decode timing, from the shared scheduler
+        //
+        if (ImGui::CollapsingHeader(CONCAT("Decode timing##_ft8_timing_", _this->name))) {
+            for (auto& [band, st] : decoderPool.getStats()) {
+                ImGui::Text("%s: wait %d, decode %d ms, depth %d, %d thr", band.c_str(), st.queueWait, st.decodeTime, st.depth, st.threads);
+                if (st.degraded || st.late) {
+                    ImGui::SameLine();
+                    ImGui::TextColored(ImVec4(1.0f, 1.0f, 0, 1.0f), "degraded %d late %d", st.degraded, st.late);
+                }
+            }
+        }
+        //
         // PSK Reporter
         //
         ImGui::LeftLabel("PSKReporter");
@@ -971,6 +1023,8 @@ public:
     std::string allTxtPathError;
     int secondsToKeepResults = 120;
     int nthreads = 1;
+    int threadBudget = 1;
+    bool helperAvailable = false;
 
     std::string  lastLocation;
     LatLng _myPos = LatLng::invalid();
@@ -1167,169 +1221,136 @@ void SingleDecoder::handleData(int rd, dsp::stereo_t* inputData) {
     }
 }
 void SingleDecoder::startBlockProcessing(const std::shared_ptr<std::vector<dsp::stereo_t>>& block, int blockNumber, int originalOffset) {
-    std::thread processor([=]() {
-        SetThreadName(getModeString()+"_startBlockProcessing");
-        std::time_t bst = (std::time_t)(blockNumber * getBlockDuration());
-//        flog::info("Start processing block ({}), size={}, block time: {}", this->getModeString(), (int64_t)block->size(), std::asctime(std::gmtime(&bst)));
-        blockProcessorsRunning.fetch_add(1);
-        auto started = currentTimeMillis();
-        std::unique_ptr<int, std::function<void(int*)>> myPtr(new int, [&](int* p) {
-            delete p;
-            auto prev = blockProcessorsRunning.fetch_add(-1);
-//            flog::info("blockProcessorsRunning ({}) released after {} msec, prev={}", getModeString(), (int64_t)(currentTimeMillis() - started), prev);
-        });
+    struct BlockState {
         int count = 0;
         long long time0 = 0;
-        auto poss = mod->getMyPos();
-        auto handler = [&](int mode, std::vector<std::string> result, std::atomic<const char *> &progress) {
-            progress ="in-handler";
-            if (result.size() == 2 && result[0] == "ERROR") {
-                strcpy(decodeError, result[1].c_str());
-            } else if (result.size() == 1 && result[0] == "DECODE_EOF") {
-                //
-            } else {
-                strcpy(decodeError , "");
-                if (time0 == 0) {
-                    time0 = currentTimeMillis();
-                }
-                auto message = result[4];
-                auto pipe = message.find('|');
-                std::string callsigns;
-                std::string callsign;
-                if (pipe != std::string::npos) {
-                    progress = "pipe1";
-                    callsigns = message.substr(pipe + 1);
-                    message = message.substr(0, pipe);
-                    std::vector<std::string> callsignsV;
-                    progress = "pipe2";
-                    splitStringV(callsigns, ";", callsignsV);
-                    progress = "pipe3";
-                    if (callsignsV.size() > 1) {
-                        progress = "pipe4";
-                        callsign = callsignsV[1];
-                        callHashCacheMutex.lock();
-                        progress = "pipe5";
-                        callHashCache.addCall(callsignsV[0], bst * 1000);
-                        callHashCache.addCall(callsignsV[1], bst * 1000);
-                        callHashCacheMutex.unlock();
-                        progress = "pipe6";
-                    }
-                    if (!callsign.empty() && callsign[0] == '<') {
-                        progress = "pipe7";
-                        callHashCacheMutex.lock();
-                        auto ncallsign = callHashCache.findCall(callsign, bst * 1000);
-                        progress = "pipe8";
+        long long started = 0;
+    };
+    auto state = std::make_shared<BlockState>();
+    state->started = currentTimeMillis();
+    std::time_t bst = (std::time_t)(blockNumber * getBlockDuration());
+    auto poss = mod->getMyPos();
+    blockProcessorsRunning.fetch_add(1);
+
+    char band[32];
+    snprintf(band, sizeof band, "%0.3f %s", (previousCenterOffset - USB_BANDWIDTH) / 1000000.0, getModeString().c_str());
+
+    dsp::ft8::DecoderPool::Job job;
+    job.mode = getModeString();
+    job.band = band;
+    job.priority = (int)getBlockDuration();                 // shorter cycles first, FT4 before FT8
+    job.deadline = state->started + (long long)(getBlockDuration() * 1000);
+    job.sampleRate = VFO_SAMPLE_RATE;
+    job.block = block;
+    job.threads = mod->nthreads;
+    job.isolate = isolateDecoder && mod->helperAvailable;
+    job.keepFiles = !removeFiles;
+    job.onMessage = [=](const dsp::ft8::DecodedMessage& msg) {
+        if (state->time0 == 0) {
+            state->time0 = currentTimeMillis();
+        }
+        auto message = msg.message;
+        auto pipe = message.find('|');
+        std::string callsigns;
+        std::string callsign;
+        if (pipe != std::string::npos) {
+            callsigns = message.substr(pipe + 1);
+            message = message.substr(0, pipe);
+            std::vector<std::string> callsignsV;
+            splitStringV(callsigns, ";", callsignsV);
+            if (callsignsV.size() > 1) {
+                callsign = callsignsV[1];
+                callHashCacheMutex.lock();
+                callHashCache.addCall(callsignsV[0], bst * 1000);
+                callHashCache.addCall(callsignsV[1], bst * 1000);
+                callHashCacheMutex.unlock();
+            }
+            if (!callsign.empty() && callsign[0] == '<') {
+                callHashCacheMutex.lock();
+                auto ncallsign = callHashCache.findCall(callsign, bst * 1000);
 //                        flog::info("Found call: {} -> {}", callsign, ncallsign);
-                        callsign = ncallsign;
-                        callHashCacheMutex.unlock();
-                        progress = "pipe9";
-                    }
-                }
-                else {
-                    progress = "pre-extract";
-                    callsign = extractCallsignFromFT8(message);
-                    progress = "post-extract";
-                }
-                count++;
-                if (callsign.empty() || callsign.find('<') != std::string::npos) { // ignore <..> callsigns
-                    return;
-                }
-                double distance = 0;
-                CTY::Callsign cs;
-                if (callsign.empty()) {
-                    callsign = "?? " + message;
-                }
-                else {
-                    progress = "pre-find";
-                    cs = globalCty.findCallsign(callsign);
-                    progress = "post-find";
-                    if (poss.isValid()) {
-                        auto bd = bearingDistance(poss, cs.ll);
-                        distance = bd.distance;
-                    }
-                }
-                progress = "pre-mkdecoded-result";
-                auto frequencyInBand = atoi(result[3].c_str());
-
-                if (message.find(callsign) == std::string::npos) {
-                    // inject callsign into message
-                    std::string newmsg;
-                    std::vector<std::string> splitMessage;
-                    splitStringV(message, " ", splitMessage);
-                    for(auto &s : splitMessage) {
-                        if (s[0] == '<' && s[s.size()-1] == '>') {
-                            s = callsign;   // inject
-                        }
-                        newmsg += s + " ";
-                    }
-                    if (newmsg.size() > 0) {
-                        newmsg.resize(newmsg.size() - 1);
-                    }
-                    message = newmsg;
-                }
-                DecodedResult decodedResult(getModeDM(), (long long)(blockNumber * getBlockDuration() * 1000 + getBlockDuration()), frequencyInBand, callsign, message);
-                decodedResult.distance = (int)distance;
-                auto strength = atof(result[1].c_str());
-                strength = (strength + 24) / (24 + 24);
-                if (strength < 0.0) strength = 0.0;
-                if (strength > 1.0) strength = 1.0;
-                decodedResult.strength = strength;
-                decodedResult.strengthRaw = atof(result[1].c_str());
-                decodedResult.intensity = 0;
-
-                time_t blocktimeUnix = blockNumber * getBlockDuration();
-                tm* ltm = std::gmtime(&blocktimeUnix);
-
-                char buf[100];
-                snprintf(buf, sizeof buf, "%02d%02d%02d_%02d%02d%02d", ltm->tm_year % 100, ltm->tm_mon + 1, ltm->tm_mday, ltm->tm_hour, ltm->tm_min, ltm->tm_sec);
-                decodedResult.decodedBlock = buf;
-                snprintf(buf, sizeof buf,  "%0.3f", (previousCenterOffset - USB_BANDWIDTH) / 1000000.0);
-                decodedResult.frequencyBand = buf;
-
-                // (random() % 100) / 100.0;
-                if (!cs.dxccname.empty()) {
-                    decodedResult.qth = cs.dxccname;
-                }
-                progress = "pre-add-result";
-                mod->addDecodedResult(decodedResult);
-                progress = "post-add-result";
+                callsign = ncallsign;
+                callHashCacheMutex.unlock();
             }
+        }
+        else {
+            callsign = extractCallsignFromFT8(message);
+        }
+        state->count++;
+        if (callsign.empty() || callsign.find('<') != std::string::npos) { // ignore <..> callsigns
             return;
-        };
-        std::atomic<const char *> progress;
-        progress = "Starting";
-        std::thread t0([&]() {
-            SetThreadName(getModeString()+"_callDecode");
-            auto start = currentTimeMillis();
-            dsp::ft8::decodeFT8(mod->nthreads, getModeString(), VFO_SAMPLE_RATE, block->data(), block->size(), handler, progress, removeFiles);
-            auto end = currentTimeMillis();
-            if (noisy_ft8) {
-                flog::info("FT8 decoding ({}) took {} ms", this->getModeString(), (int64_t) (end - start));
+        }
+        double distance = 0;
+        CTY::Callsign cs;
+        if (callsign.empty()) {
+            callsign = "?? " + message;
+        }
+        else {
+            cs = globalCty.findCallsign(callsign);
+            if (poss.isValid()) {
+                auto bd = bearingDistance(poss, cs.ll);
+                distance = bd.distance;
             }
-            lastDecodeCount = (int)count;
-            lastDecodeTime = (int)(end - start);
-            if (time0 == 0) {
-                lastDecodeTime0 = 0;
-            } else {
-                lastDecodeTime0 = (int)(time0 - start);
+        }
+        auto frequencyInBand = msg.frequency;
+
+        if (message.find(callsign) == std::string::npos) {
+            // inject callsign into message
+            std::string newmsg;
+            std::vector<std::string> splitMessage;
+            splitStringV(message, " ", splitMessage);
+            for(auto &s : splitMessage) {
+                if (s[0] == '<' && s[s.size()-1] == '>') {
+                    s = callsign;   // inject
+                }
+                newmsg += s + " ";
             }
-        });
-
-        auto future = std::async(std::launch::async, &std::thread::join, &t0);
-        int count0=0;
-        while(true) {
-            if (future.wait_for(std::chrono::seconds(1)) == std::future_status::timeout) {
-//                flog::info("outside progress({}: decoding ({}) : {}", count0, this->getModeString(), progress.load());
-                count0++;
-            } else {
-                break;
+            if (newmsg.size() > 0) {
+                newmsg.resize(newmsg.size() - 1);
             }
+            message = newmsg;
         }
-
-//        flog::info("blockProcessorsRunning ({}) gracefully completed {}", getModeString(), blockNumber);
-
-    });
-    processor.detach();
+        DecodedResult decodedResult(getModeDM(), (long long)(blockNumber * getBlockDuration() * 1000 + getBlockDuration()), frequencyInBand, callsign, message);
+        decodedResult.distance = (int)distance;
+        double strength = msg.snr;
+        strength = (strength + 24) / (24 + 24);
+        if (strength < 0.0) strength = 0.0;
+        if (strength > 1.0) strength = 1.0;
+        decodedResult.strength = strength;
+        decodedResult.strengthRaw = msg.snr;
+        decodedResult.intensity = 0;
+
+        time_t blocktimeUnix = blockNumber * getBlockDuration();
+        tm* ltm = std::gmtime(&blocktimeUnix);
+
+        char buf[100];
+        snprintf(buf, sizeof buf, "%02d%02d%02d_%02d%02d%02d", ltm->tm_year % 100, ltm->tm_mon + 1, ltm->tm_mday, ltm->tm_hour, ltm->tm_min, ltm->tm_sec);
+        decodedResult.decodedBlock = buf;
+        snprintf(buf, sizeof buf,  "%0.3f", (previousCenterOffset - USB_BANDWIDTH) / 1000000.0);
+        decodedResult.frequencyBand = buf;
+
+        // (random() % 100) / 100.0;
+        if (!cs.dxccname.empty()) {
+            decodedResult.qth = cs.dxccname;
+        }
+        mod->addDecodedResult(decodedResult);
+    };
+    job.onDone = [=](const std::string& error) {
+        auto end = currentTimeMillis();
+        strcpy(decodeError, error.substr(0, sizeof(decodeError) - 1).c_str());
+        if (noisy_ft8) {
+            flog::info("FT8 decoding ({}) took {} ms", this->getModeString(), (int64_t) (end - state->started));
+        }
+        lastDecodeCount = state->count;
+        lastDecodeTime = (int)(end - state->started);
+        if (state->time0 == 0) {
+            lastDecodeTime0 = 0;
+        } else {
+            lastDecodeTime0 = (int)(state->time0 - state->started);
+        }
+        blockProcessorsRunning.fetch_add(-1);
+    };
+    decoderPool.submit(std::move(job));
 }
 
 void SingleDecoder::init(const std::string &name) {
@@ -1402,7 +1423,7 @@ MOD_EXPORT void _INIT_() {
     config.load(def);
     config.enableAutoSave();
     mshv_init();
-
+    decoderPool.start(std::clamp<int>(std::thread::hardware_concurrency(), 2, 16));
 }
 
 MOD_EXPORT ModuleManager::Instance* _CREATE_INSTANCE_(std::string name) {
@@ -1414,6 +1435,7 @@ MOD_EXPORT void _DELETE_INSTANCE_(void* instance) {
 }
 
 MOD_EXPORT void _END_() {
+    decoderPool.stop();
     config.disableAutoSave();
     config.save();
 }
@@ -1460,25 +1482,3 @@ void SingleDecoder::handleIFData(const std::vector<dsp::stereo_t>& data) {
     fullBlock->insert(std::end(*fullBlock), std::begin(data), std::end(data));
     //        flog::info("{} Got {} samples: {}", blockNumber, data.size(), data[0].l);
 }
-
-
-#ifdef NEW_BUILTIN_MODE
-
-extern void doDecode(const char *mode, const char *path, int threads, std::function<void(int mode, std::vector<std::string> result)> callback);
-namespace dsp {
-    namespace ft8 {
-        void invokeDecoder(int nthreads, const std::string &mode, const std::string &wavPath, const std::string &outPath,
-                           const std::string &errPath,
-                           std::function<void(int mode, std::vector<std::string> result, std::atomic<const char *> &progress)> callback1,
-                           std::atomic<const char *> &progress)
-        {
-            ::doDecode(mode.c_str(), wavPath.c_str(), nthreads, [&](int mode2, std::vector<std::string> result) {
-                callback1(mode2, result, progress);
-            });
-        }
-
-    }
-}
-
-
-#endif
@@ -38,8 +38,10 @@ namespace ft8 {
     } DecoderMSMode;
 
 
-    // input stereo samples, nsamples (number of pairs of float)
-    inline void decodeFT8(int threads, const char *mode, int sampleRate, dsp::stereo_t* samples, long long nsamples, std::function<void(const char*)> callback) {
+    // input stereo samples, nsamples (number of pairs of float). Decoder entry point, also called in-process by the module.
+    // depth: 3 = 3 passes with OSD, 2 = 3 passes BP only, 1 = single pass, no subtraction
+    // Not reentrant: mshv keeps its thread completion flags, hash tables and decoder state in globals.
+    void decodeFT8(int threads, const char *mode, int sampleRate, dsp::stereo_t* samples, long long nsamples, int depth, std::function<void(const char*)> callback) {
         //
         //
         //
@@ -76,7 +78,7 @@ namespace ft8 {
             dms->setMode(DMS_FT4);
         } else {
             fprintf(stderr, "ERROR: invalid mode is specified. Valid modes: ft8, ft4\n");
-            exit(1);
+            return;
         }
         {
             QStringList ql;
@@ -94,12 +96,13 @@ namespace ft8 {
             dms->SetCalsHash(ql);
         }
         dms->SetResultsCallback(callback);
-        dms->SetDecoderDeep(3);
-        dms->SetThrLevel(threads);
+        dms->SetDecoderDeep(depth);
+        // The multi-threaded decode is stubbed out, SetDecode() aborts for more than one thread
+        dms->SetThrLevel(1);
 
         dms->SetDecode(converted.data(), converted.size(), "120000", 0, 4, false, true, false);
         while (dms->IsWorking()) {
-            usleep(100000);
+            usleep(10000);
         }
         return;
     }
@@ -107,7 +110,7 @@ namespace ft8 {
 }
 
 
-void doDecode(const char *mode, const char *path, int threads, std::function<void(int mode, std::vector<std::string> result)> callback) {
+void doDecode(const char *mode, const char *path, int threads, int depth, std::function<void(int mode, std::vector<std::string> result)> callback) {
     mshv_init();
     FILE *f = fopen(path,"rb");
     if (!f) {
@@ -169,7 +172,7 @@ void doDecode(const char *mode, const char *path, int threads, std::function<voi
             auto ctm = currentTimeMillis();
             int outCount = 0;
 //            spdlog::info("=================================");
-            ft8::decodeFT8(threads, mode, hdr->sampleRate, (dsp::stereo_t*)data, nSamples, [&](const char *line) {
+            ft8::decodeFT8(threads, mode, hdr->sampleRate, (dsp::stereo_t*)data, nSamples, depth, [&](const char *line) {
                 std::vector<std::string> split;
                 splitStringV(line,"\t\n", split);
                 std::vector<std::string> formatted = {
@@ -16,11 +16,11 @@
 #include <utils/wstr.h>
 #include <utils/strings.h>
 
-extern void doDecode(const char *mode, const char *path, int threads, std::function<void(int mode, std::vector<std::string> result)> callback);
+extern void doDecode(const char *mode, const char *path, int threads, int depth, std::function<void(int mode, std::vector<std::string> result)> callback);
 
 
 static void help(const char *cmd) {
-    fprintf(stderr,"usage: %s --decode <path> [--mode <mode>]\n", cmd);
+    fprintf(stderr,"usage: %s --decode <path> [--mode <mode>] [--threads <n>] [--depth <1..3>]\n", cmd);
     exit(1);
 }
 
@@ -42,6 +42,7 @@ int main(int argc, char* argv[]) {
     std::string decodeFile;
     std::string mode = "ft8";
     int threads = 1;
+    int depth = 3;
     for(int i=1; i<argc; i++) {
         if (!strcmp(argv[i],"--decode")) {
             i++;
@@ -64,6 +65,15 @@ int main(int argc, char* argv[]) {
                 }
             }
         }
+        if (!strcmp(argv[i],"--depth")) {
+            i++;
+            if (i < argc) {
+                depth = atoi(argv[i]);
+                if (depth < 1 || depth > 3) {
+                    depth = 3;
+                }
+            }
+        }
     }
     if (false) {
         mode = "ft4";
@@ -77,8 +87,15 @@ int main(int argc, char* argv[]) {
     if (mode == "ft8" || mode == "ft4") {
         fprintf(stdout, "Using mode: %s\n", mode.c_str());
         fprintf(stdout, "Using file: %s\n", decodeFile.c_str());
-        doDecode(mode.c_str(), decodeFile.c_str(), threads, [](int mode, std::vector<std::string> result) {
+        // the module reads the FT8_OUT lines back from stdout when it runs the decoder isolated
+        decodeResultOutputFun = [](const char* line) {
+            fputs(line, stdout);
+            fflush(stdout);
+        };
+        doDecode(mode.c_str(), decodeFile.c_str(), threads, depth, [](int mode, std::vector<std::string> result) {
         });
+        fprintf(stdout, "DECODE_EOF\n");
+        fflush(stdout);
         exit(0);
     } else {
         fprintf(stderr, "ERROR: invalid mode is specified. Valid modes: ft8, ft4\n");
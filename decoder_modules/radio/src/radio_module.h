@@ -78,6 +78,9 @@ public:
         ifChain.addBlock(&squelch, false);
         ifChain.addBlock(&fmnr, false);
 
+        // Run the IF blocks on a single thread whenever they are all fusable
+        ifChain.setFused(true, [=](dsp::stream<dsp::complex_t>* out){ ifChainOutputChangeHandler(out, this); });
+
         // Initialize audio DSP chain
         afChain.init(&dummyAudioStream);
 
@@ -86,6 +89,7 @@ public:
 
         afChain.addBlock(&resamp, true);
         afChain.addBlock(&deemp, false);
+        afChain.setFused(true, [](dsp::stream<dsp::stereo_t>* out){});
 
         // Initialize the sink
         srChangeHandler.ctx = this;
@@ -10,7 +10,7 @@
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
 #include "utils/arrays.h"
-#include "logmmse.h"
+#include "logmmse_engine.h"
 #include "omlsa_mcra.h"
 #include "utils/stream_tracker.h"
 
@@ -209,7 +209,8 @@ namespace dsp {
 
         using base_type = Processor<complex_t, complex_t>;
 
-        ComplexArray worker1c;
+        std::vector<complex_t> worker1c;
+        std::vector<complex_t> denoised;
 
         void init(stream<complex_t>* in) override {
             base_type::init(in);
@@ -221,12 +222,11 @@ namespace dsp {
         }
 
         AFNRLogMMSE() {
-            worker1c = std::make_shared<std::vector<complex_t>>();
             params.forceAudio = true;
         }
 
 
-        LogMMSE::SavedParamsC params;
+        LogMMSEEngine params;
 
         double getVFOFrequency() {
             if (gui::waterfall.selectedVFO == "") {
@@ -289,55 +289,38 @@ namespace dsp {
         void process(complex_t *readBuf, int count, complex_t *writeBuf, int &wrote) {
             wrote = 0;
             std::lock_guard<std::mutex> lock(freqMutex);
-            auto curSize = worker1c->size();
-            worker1c->resize(curSize + count);
-            memmove(worker1c->data() + curSize, readBuf, count * sizeof(complex_t));
+            auto curSize = worker1c.size();
+            worker1c.insert(worker1c.end(), readBuf, readBuf + count);
             switchTrigger += count;
             overlapTrigger += count;
 
             int noiseFrames = 12;
-            int fram = processingBandwidthHz / 100;
-            auto Slen = (int)floor(0.02 * processingBandwidthHz);
-            if (!params.noise_mu2) {
-                if (worker1c->size() >= noiseFrames * Slen) {
+            if (!params.isSampled()) {
+                int demand = LogMMSEEngine::sampleDemand(processingBandwidthHz, noiseFrames);
+                if (worker1c.size() >= demand) {
                     // finally can sample
-                    flog::info("Sampling, total samples: {0}, will be used: {1}", (int64_t)worker1c->size(), noiseFrames * Slen);
-                    LogMMSE::logmmse_sample(worker1c, processingBandwidthHz, 0.15f, &params, noiseFrames);
-                    worker1c->erase(worker1c->begin(), worker1c->begin() + curSize); // skip everything already sent to the output before
+                    flog::info("Sampling, total samples: {0}, will be used: {1}", (int64_t)worker1c.size(), demand);
+                    params.sample(worker1c.data(), processingBandwidthHz, noiseFrames);
+                    worker1c.erase(worker1c.begin(), worker1c.begin() + curSize); // skip everything already sent to the output before
                 } else {
                     // pass throug until it fills
-                    memmove(writeBuf, worker1c->data() + curSize, count * sizeof(complex_t));
+                    memmove(writeBuf, worker1c.data() + curSize, count * sizeof(complex_t));
                     wrote = count;
                     return;
                 }
             }
-            int size1 = worker1c->size();
-            if (worker1c->size() >= 4 * params.Slen && params.noise_mu2) {
-                ALLOC_AND_CHECK(worker1c, size1, "afnr point -5")
-                auto rv = LogMMSE::logmmse_all(worker1c, processingBandwidthHz, 0.15f, &params);
-                int limit = rv->size();
-                auto dta = rv->data();
-                ALLOC_AND_CHECK(worker1c, size1, "afnr point -3")
+            if (worker1c.size() >= 4 * params.Slen) {
+                // Buffers only grow until the block size settles
+                denoised.resize(worker1c.size());
+                int limit = params.process(worker1c.data(), worker1c.size(), denoised.data());
 
-                sma.write(dta, limit);
-                ALLOC_AND_CHECK(worker1c, size1, "afnr point -2")
+                sma.write(denoised.data(), limit);
 
                 if (sma.available() >= limit) {
                     wrote = limit;
-                    ALLOC_AND_CHECK(worker1c, size1, "afnr point -1")
                     sma.read(writeBuf, limit);
-                    ALLOC_AND_CHECK(worker1c, size1, "afnr point 0")
-                    memmove(worker1c->data(), ((complex_t*)worker1c->data()) + limit, sizeof(complex_t) * (worker1c->size() - limit));
-                    ALLOC_AND_CHECK(worker1c, size1, "afnr point 0.1")
-                    unsigned long nsize = worker1c->size() - limit;
-                    char buf[100];
-                    snprintf(buf, sizeof(buf), "afnr point 0.2 size = %lld curr=%lld",(long long)nsize, (long long)worker1c->size());
-                    worker1c->resize(nsize);
-                    size1 = nsize;
-                    ALLOC_AND_CHECK(worker1c, size1, buf)
+                    worker1c.erase(worker1c.begin(), worker1c.begin() + limit);
                 }
-            } else {
-
             }
             return;
         }
@@ -3,6 +3,7 @@
 //
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
 class BackgroundNoiseCaltulator {
@@ -46,7 +47,7 @@ public:
         memset(buckets.data(), 0, sizeof(int) * NBUCKETS);
         for(auto f : logFrame) {
             int bucket = (int) (NBUCKETS * ((f - minn) / width));
-            buckets[bucket]++;
+            buckets[std::min<int>(bucket, NBUCKETS - 1)]++;     // the maximum lands one past the end
         }
         auto ix = std::max_element(buckets.begin(), buckets.end()) - buckets.begin();
         double maxf = pow(10, ((((double)ix)/NBUCKETS) * width + minn));
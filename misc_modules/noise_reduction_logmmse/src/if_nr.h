@@ -5,7 +5,8 @@
 #include <dsp/processor.h>
 #include "utils/arrays.h"
 #include <utils/usleep.h>
-#include "logmmse.h"
+#include <ctm.h>
+#include "logmmse_engine.h"
 
 namespace dsp {
 
@@ -33,10 +34,11 @@ namespace dsp {
 
     public:
 
-        ComplexArray worker1c;
+        std::vector<complex_t> worker1c;
         std::mutex workerMutex;
         int freq = 192000;
-        LogMMSE::SavedParamsC params;
+        LogMMSEEngine params;
+        int forceSampleRate = 0;
         std::mutex freqMutex;
 
         void doStart() override {
@@ -59,48 +61,37 @@ namespace dsp {
             if (shouldReset) {
                 flog::info("Resetting IF NR LogMMSE");
                 shouldReset = false;
-                worker1c.reset();
-                if (params.forceSampleRate != 0) {
-                    freq = params.forceSampleRate;
+                worker1c.clear();
+                params.reset();
+                if (forceSampleRate != 0) {
+                    freq = forceSampleRate;
                 } else {
                     freq = (int)sigpath::iqFrontEnd.getSampleRate();
                 }
             }
-            if (!worker1c) {
-                worker1c = npzeros_c(0);
-                params.reset();
-            }
-            for (int i = 0; i < count; i++) {
-                worker1c->emplace_back(in[i]);
-            }
+            worker1c.insert(worker1c.end(), in, in + count);
             int noiseFrames = 12;
             int fram = freq / 100;
             int initialDemand = fram * 2;
-            if (!params.Xk_prev) {
+            if (!params.isSampled()) {
                 initialDemand = fram * (noiseFrames + 2) * 2;
             }
-            if (worker1c->size() < initialDemand) {
+            if (worker1c.size() < initialDemand) {
                 outCount = 0;
                 return;
             }
-            int retCount = 0;
             freqMutex.lock();
-            if (!params.Xk_prev) {
-                std::cout << std::endl << "Sampling initially" << std::endl;
-                LogMMSE::logmmse_sample(worker1c, freq, 0.15f, &params, noiseFrames);
+            if (!params.isSampled()) {
+                flog::info("Sampling initially");
+                params.sample(worker1c.data(), freq, noiseFrames);
             }
-            auto rv = LogMMSE::logmmse_all(worker1c, freq, 0.15f, &params);
+            int limit = params.process(worker1c.data(), worker1c.size(), out);
             freqMutex.unlock();
 
-            int limit = rv->size();
-            auto dta = rv->data();
             for (int i = 0; i < limit; i++) {
-                auto lp = dta[i];
-                out[i] = lp * 4.0;
+                out[i] *= 4.0f;
             }
-            memmove(worker1c->data(), ((complex_t *) worker1c->data()) + rv->size(), sizeof(complex_t) * (worker1c->size() - rv->size()));
-            worker1c->resize(worker1c->size() - rv->size());
-            retCount += rv->size();
+            worker1c.erase(worker1c.begin(), worker1c.begin() + limit);
             outCount = limit;
             return;
         }
@@ -0,0 +1,413 @@
+#pragma once
+
+#include <algorithm>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <volk/volk.h>
+#include <utils/flog.h>
+#include "utils/arrays.h"
+#include "utils/arrays_expr.h"
+#include "bgnoise.h"
+
+namespace dsp::logmmse {
+
+    // Branch free single precision approximations, written so the per bin loops below vectorize.
+    //
+    // Selects are done on the bits: without -ffast-math gcc does not if-convert a ?: on floats in a loop
+    // that also reinterprets floats as integers, and falls back to scalar code.
+    namespace vmath {
+        inline float asFloat(int32_t v) { float f; memcpy(&f, &v, sizeof(f)); return f; }
+        inline int32_t asInt(float f) { int32_t v; memcpy(&v, &f, sizeof(v)); return v; }
+
+        inline float select(bool cond, float a, float b) {
+            int32_t mask = -(int32_t)cond;
+            return asFloat((asInt(a) & mask) | (asInt(b) & ~mask));
+        }
+        inline float min(float a, float b) { return select(a < b, a, b); }
+        inline float max(float a, float b) { return select(a > b, a, b); }
+
+        // Cephes expf, ~1 ulp
+        inline float exp(float x) {
+            x = min(max(x, -87.0f), 88.0f);
+            // Rounds through the mantissa of 1.5 * 2^23, which leaves n in the low bits of shifted
+            float shifted = x * 1.44269504088896341f + 12582912.0f;
+            float n = shifted - 12582912.0f;
+            float r = x - n * 0.693359375f + n * 2.12194440e-4f;
+            float p = 1.9875691500E-4f;
+            p = p * r + 1.3981999507E-3f;
+            p = p * r + 8.3334519073E-3f;
+            p = p * r + 4.1665795894E-2f;
+            p = p * r + 1.6666665459E-1f;
+            p = p * r + 5.0000001201E-1f;
+            p = p * r * r + r + 1.0f;
+            return p * asFloat((asInt(shifted) - 0x4B400000 + 127) << 23);
+        }
+
+        // Cephes logf, positive normal x only
+        inline float log(float x) {
+            int32_t bits = asInt(x);
+            // Mantissa in [sqrt(0.5), sqrt(2)) instead of [1, 2)
+            int32_t big = (bits & 0x007FFFFF) > 0x003504F3;
+            float e = (float)((bits >> 23) - 127 + big);
+            float m = asFloat((bits & 0x007FFFFF) | (0x3F800000 - (big << 23)));
+            float f = m - 1.0f;
+            float z = f * f;
+            float y = 7.0376836292E-2f;
+            y = y * f - 1.1514610310E-1f;
+            y = y * f + 1.1676998740E-1f;
+            y = y * f - 1.2420140846E-1f;
+            y = y * f + 1.4249322787E-1f;
+            y = y * f - 1.6668057665E-1f;
+            y = y * f + 2.0000714765E-1f;
+            y = y * f - 2.4999993993E-1f;
+            y = y * f + 3.3333331174E-1f;
+            y = y * f * z;
+            y += e * -2.12194440e-4f;
+            y += -0.5f * z;
+            return f + y + e * 0.693359375f;
+        }
+
+        // Exponential integral E1(x) (scipy.special.exp1), Abramowitz & Stegun 5.1.53 below 1 and
+        // 5.1.56 above, relative error under 5e-5. x is clamped to 1e-16 where E1 is ~36.3, the
+        // first entry of the table dsp::math::expn() interpolates.
+        inline float expint(float x) {
+            x = max(x, 1e-16f);
+            float small = -log(x) + (((((0.00107857f * x - 0.00976004f) * x + 0.05519968f) * x - 0.24991055f) * x + 0.99999193f) * x - 0.57721566f);
+            float large = exp(-x) / x * ((x * x + 2.334733f * x + 0.250621f) / (x * x + 3.330657f * x + 1.681534f));
+            return select(x < 1.0f, small, large);
+        }
+    }
+
+    using namespace ::dsp::arrays;
+
+    // Preallocated implementation of LogMMSE::logmmse_sample() / logmmse_all().
+    //
+    // The noise and deviation histories are rings of nFFT bins per frame, allocated when the noise
+    // profile is sampled, and every per frame quantity lives in a scratch buffer, so process() does
+    // not allocate. The gain is computed in a single pass per bin, with vmath::expint() in place of the
+    // dsp::math::expn() table and the exponential of the SIMD volk_32f_expfast_32f kernels, so the
+    // output follows the original closely on x86 builds of volk.
+    class LogMMSEEngine {
+    public:
+        // Output error relative to the original, as measured by the LogMMSE case of sdrpp_dsp_bench.
+        // Volk builds without a SIMD expfast kernel use expf() instead, which alone moves the original
+        // by about -28 dB.
+        static constexpr float REFERENCE_TOLERANCE_DB = -25.0f;
+
+        bool forceAudio = false;
+        bool forceWideband = false;
+        bool hold = false;
+
+        int Slen = 0;
+        int len1 = 0;
+        int len2 = 0;
+        int nFFT = 0;
+
+        // The noise profile has to be sampled before the first process() and after every reset()
+        bool isSampled() { return sampled; }
+
+        void reset() {
+            noiseCount = 0;
+            noiseHead = 0;
+            sampled = false;
+            generation = 0;
+            stable = false;
+            backgroundNoise.reset();
+        }
+
+        // Number of input samples sample() needs
+        static int sampleDemand(int sampleRate, int noiseFrames) {
+            return frameLength(sampleRate) * noiseFrames;
+        }
+
+        // Builds the initial noise profile from the first noiseFrames frames of x
+        void sample(const complex_t* x, int sampleRate, int noiseFrames) {
+            Slen = frameLength(sampleRate);
+            len1 = Slen * PERC / 100;
+            len2 = Slen - len1;
+            bool audioFrequency = sampleRate <= 24000;
+            if (forceAudio) { audioFrequency = true; }
+            if (forceWideband) { audioFrequency = false; }
+
+            win.resize(Slen);
+            for (int i = 0; i < Slen; i++) {
+                win[i] = (0.5 - 0.5 * cos(2.0 * M_PI * i / (Slen - 1)));
+            }
+            float winSum = 0;
+            for (int i = 0; i < Slen; i++) { winSum += win[i]; }
+            volk_32f_s32f_multiply_32f(win.data(), win.data(), len2, Slen);
+            volk_32f_s32f_multiply_32f(win.data(), win.data(), 1.0 / winSum, Slen);
+
+            if (nFFT != 2 * Slen) {
+                nFFT = 2 * Slen;
+                forwardPlan = allocateFFTWPlan(false, nFFT);
+                reversePlan = allocateFFTWPlan(true, nFFT);
+            }
+            flog::info("LogMMSE: sampling noise, srate={} Slen={} nFFT={}", sampleRate, Slen, nFFT);
+
+            // Deviations are only used by the wideband noise floor
+            historyLen = (nFFT < 1000) ? 2000 : 200;
+            wideband = !((nFFT < 1200 || forceAudio) && !forceWideband);
+            noiseHistory.assign((size_t)historyLen * nFFT, 0);
+            devHistory.assign(wideband ? (size_t)historyLen * nFFT : 0, 0);
+            noiseCount = 0;
+            noiseHead = 0;
+            sums.assign(nFFT, 0);
+            devs.assign(nFFT, 0);
+            noiseMu2.assign(nFFT, 0);
+            invNoiseMu2.assign(nFFT, 0);
+            xkPrev.assign(nFFT, 0);
+            xkPrevZeros = nFFT;
+            xOld.assign(len1, { 0, 0 });
+            sig.assign(nFFT, 0);
+            scratchA.assign(nFFT, 0);
+            scratchB.assign(nFFT, 0);
+            scratchList.assign(nFFT, 0);
+            std::fill(forwardPlan->getInput()->begin(), forwardPlan->getInput()->end(), complex_t{ 0, 0 });
+
+            for (int j = 0; j < Slen * noiseFrames; j += Slen) {
+                forwardFFT(&x[j]);
+                volk_32fc_magnitude_32f(sig.data(), (const lv_32fc_t*)forwardPlan->getOutput()->data(), nFFT);
+                addNoiseHistory(sig.data());
+                volk_32f_x2_add_32f(noiseMu2.data(), noiseMu2.data(), sig.data(), nFFT);
+            }
+            volk_32f_s32f_multiply_32f(noiseMu2.data(), noiseMu2.data(), 1.0 / (float)noiseFrames, nFFT);
+            if (!audioFrequency) {
+                npmavg(noiseMu2.data(), nFFT, 120, scratchA.data());
+                noiseMu2.swap(scratchA);
+            }
+            volk_32f_x2_multiply_32f(noiseMu2.data(), noiseMu2.data(), noiseMu2.data(), nFFT);
+
+            ksiMin = ::pow(10, -25.0 / 10.0);
+            generation = 0;
+            stable = false;
+            sampled = true;
+        }
+
+        // Denoises as many whole frames of x as possible, keeping one frame of lookahead like
+        // logmmse_all(). Writes and returns the number of samples the caller can drop from x.
+        int process(const complex_t* x, int count, complex_t* out) {
+            updateNoiseMu2();
+            for (int i = 0; i < nFFT; i++) {
+                invNoiseMu2[i] = 1.0f / noiseMu2[i];
+            }
+            int nframes = count / len2 - Slen / len2;
+            for (int f = 0; f < nframes; f++) {
+                processFrame(&x[f * len2], &out[f * len2]);
+            }
+            return std::max<int>(nframes, 0) * len2;
+        }
+
+    private:
+        static constexpr int PERC = 50;
+        static constexpr float aa = 0.98f;
+
+        static int frameLength(int sampleRate) {
+            int len = floor(0.02 * sampleRate);
+            if (len % 2 == 1) { len++; }
+            return len;
+        }
+
+        // Same as arrays::npmavg()
+        static void npmavg(const float* v, int size, int windowSize, float* out) {
+            float sum = 0;
+            float count = 0;
+            int ws2 = windowSize / 2;
+            int o = 0;
+            for (int ix = 0; ix < size + ws2; ix++) {
+                if (ix < size) {
+                    sum += v[ix];
+                    count++;
+                }
+                if (ix > windowSize) {
+                    count--;
+                    sum -= v[ix - (int)count];
+                }
+                if (ix >= ws2) {
+                    out[o++] = sum / count;
+                }
+            }
+        }
+
+        float* noiseSlot(int n) { return &noiseHistory[(size_t)((noiseHead + n) % historyLen) * nFFT]; }
+        float* devSlot(int n) { return &devHistory[(size_t)((noiseHead + n) % historyLen) * nFFT]; }
+
+        // Windowed, zero padded frame into the forward plan
+        void forwardFFT(const complex_t* x) {
+            complex_t* in = forwardPlan->getInput()->data();
+            volk_32fc_32f_multiply_32fc((lv_32fc_t*)in, (const lv_32fc_t*)x, win.data(), Slen);
+            forwardPlan->npfftfft(forwardPlan->getInput());
+        }
+
+        void addNoiseHistory(const float* noise) {
+            if (hold) {
+                return;
+            }
+            bool full = (noiseCount == historyLen);
+            float* slot = full ? noiseSlot(0) : noiseSlot(noiseCount);
+
+            // Sums are updated in the same order as the list based version: add the new frame, then drop the oldest
+            volk_32f_x2_add_32f(sums.data(), sums.data(), noise, nFFT);
+            if (full) { volk_32f_x2_subtract_32f(sums.data(), sums.data(), slot, nFFT); }
+            memcpy(slot, noise, nFFT * sizeof(float));
+            int frames = full ? historyLen : noiseCount + 1;
+
+            if (wideband) {
+                float* dev = full ? devSlot(0) : devSlot(noiseCount);
+                float scale = 1.0 / (float)frames;
+                float* diff = scratchB.data();
+                for (int i = 0; i < nFFT; i++) {
+                    float d = noise[i] - sums[i] * scale;
+                    diff[i] = d * d;
+                }
+                volk_32f_x2_add_32f(devs.data(), devs.data(), diff, nFFT);
+                if (full) { volk_32f_x2_subtract_32f(devs.data(), devs.data(), dev, nFFT); }
+                memcpy(dev, diff, nFFT * sizeof(float));
+            }
+
+            if (full) {
+                noiseHead = (noiseHead + 1) % historyLen;
+            }
+            else {
+                noiseCount++;
+            }
+        }
+
+        void updateNoiseMu2() {
+            int nframes = noiseCount;
+            if (nframes <= 100 || hold) {
+                return;
+            }
+
+            if (!wideband) {
+                // recalculate noise floor from the latest frames
+                if (generation > 0) {
+                    const int nlower = 12;
+                    float* lower = scratchA.data();
+                    std::fill(lower, lower + nFFT, 0.0f);
+                    for (int f = nframes - nlower; f < nframes; f++) {
+                        volk_32f_x2_add_32f(lower, lower, noiseSlot(f), nFFT);
+                    }
+                    for (int w = 0; w < nFFT; w++) {
+                        lower[w] /= nlower;
+                        lower[w] *= lower[w];
+                    }
+                    npmavg(lower, nFFT, 6, scratchB.data());
+                    float tmindb = *std::min_element(scratchB.begin(), scratchB.end());
+                    float tmaxdb = *std::max_element(scratchB.begin(), scratchB.end());
+                    if (tmindb + tmaxdb < mindb + maxdb) {
+                        mindb = tmindb;
+                        maxdb = tmaxdb;
+                        noiseMu2.swap(scratchA);
+                        stable = true;
+                    }
+                }
+
+                // scale the noise figure
+                if (!stable && generation == 0) {
+                    npmavg(noiseMu2.data(), nFFT, 6, scratchB.data());
+                    mindb = *std::min_element(scratchB.begin(), scratchB.end());
+                    maxdb = *std::max_element(scratchB.begin(), scratchB.end());
+                    flog::info("LogMMSE: initial noise floor {}", mindb);
+                }
+                generation++;
+                return;
+            }
+
+            float* noiseMu2Copy = scratchA.data();
+            memcpy(noiseMu2Copy, noiseMu2.data(), nFFT * sizeof(float));
+
+            // after fft, rightmost and leftmost sides of real frequencies range are at the center of the
+            // table, the middle is excluded from the lookup
+            float scale = 1 / (float)nframes;
+            float* devSquare = scratchList.data();
+            for (int z = 0; z < nFFT; z++) {
+                float hi = devs[z] * scale;
+                devSquare[z] = (abs(z - nFFT/2) < nFFT * 15 / 100) ? BackgroundNoiseCaltulator::ERASED_SAMPLE : hi * hi;
+            }
+            float acceptableStdev = backgroundNoise.addFrame(scratchList);
+
+            float* nmu2 = noiseMu2.data();
+            for (int q = 0; q < nFFT; q++) {
+                float navg = sums[q] * scale;
+                nmu2[q] = (devSquare[q] < acceptableStdev) ? navg * navg : 0.0f;
+            }
+            if (!dsp::math::linearInterpolateHoles(nmu2, nFFT)) {
+                memcpy(nmu2, noiseMu2Copy, nFFT * sizeof(float));
+            }
+        }
+
+        void processFrame(const complex_t* x, complex_t* out) {
+            forwardFFT(x);
+            const complex_t* spec = forwardPlan->getOutput()->data();
+            float* s = sig.data();
+            volk_32fc_magnitude_32f(s, (const lv_32fc_t*)spec, nFFT);
+            for (int z = 1; z < nFFT; z++) {
+                if (s[z] == 0) {
+                    s[z] = s[z - 1];      // for some reason fft returns 0 instead if small value
+                }
+            }
+            addNoiseHistory(s);
+
+            // Gain per bin, applied to the spectrum straight into the inverse plan
+            bool havePrev = (xkPrevZeros == 0);
+            const float* invMu2 = invNoiseMu2.data();
+            float* xk = xkPrev.data();
+            complex_t* weighted = reversePlan->getInput()->data();
+            const float ksiFloor = havePrev ? ksiMin : 0.0f;
+            const float prevWeight = havePrev ? aa : 0.0f;
+            const float constant = havePrev ? 0.0f : aa;
+            int zeros = 0;
+            for (int i = 0; i < nFFT; i++) {
+                float gammak = vmath::min((s[i] * s[i]) * invMu2[i], 40);
+                float ksi = vmath::max(gammak - 1, 0) * (1 - aa) + (prevWeight * xk[i]) * invMu2[i] + constant;
+                ksi = vmath::max(ksi, ksiFloor);
+                float A = ksi / (ksi + 1);
+                float hw = A * expr::ops::ExpFast::apply(0.5f * vmath::expint(A * gammak));
+                float filtered = s[i] * hw;
+                xk[i] = filtered * filtered;
+                zeros += (xk[i] == 0.0f);
+                weighted[i] = complex_t{ spec[i].re * hw, spec[i].im * hw };
+            }
+            xkPrevZeros = zeros;
+            reversePlan->npfftfft(reversePlan->getInput());
+
+            // Overlap add
+            const complex_t* xi = reversePlan->getOutput()->data();
+            volk_32fc_x2_add_32fc((lv_32fc_t*)out, (const lv_32fc_t*)xOld.data(), (const lv_32fc_t*)xi, len1);
+            memcpy(xOld.data(), &xi[len1], len2 * sizeof(complex_t));
+        }
+
+        Arg<FFTPlan> forwardPlan;
+        Arg<FFTPlan> reversePlan;
+        std::vector<float> win;
+
+        int historyLen = 0;
+        bool wideband = false;
+        std::vector<float> noiseHistory;    // historyLen frames of nFFT
+        std::vector<float> devHistory;
+        int noiseHead = 0;
+        int noiseCount = 0;
+        std::vector<float> sums;            // sliding sum of noiseHistory
+        std::vector<float> devs;            // sliding sum of devHistory
+
+        std::vector<float> noiseMu2;
+        std::vector<float> invNoiseMu2;
+        std::vector<float> xkPrev;
+        int xkPrevZeros = 0;                // previous frame only counts once no bin is zero
+        std::vector<complex_t> xOld;
+        std::vector<float> sig;
+        std::vector<float> scratchA;
+        std::vector<float> scratchB;
+        std::vector<float> scratchList;     // BackgroundNoiseCaltulator takes a vector
+
+        BackgroundNoiseCaltulator backgroundNoise;
+        float ksiMin = 0;
+        bool sampled = false;
+        bool stable = false;
+        long long generation = 0;
+        float mindb = 0;
+        float maxdb = 0;
+    };
+}
@@ -2,6 +2,7 @@
 #include <module.h>
 #include <dsp/types.h>
 #include <dsp/stream.h>
+#include <dsp/shared_stream.h>
 #include <dsp/bench/peak_level_meter.h>
 #include <dsp/sink/handler_sink.h>
 #include <dsp/routing/splitter.h>
@@ -48,15 +49,21 @@ public:
         // Define option lists
         containers.define("WAV", wav::FORMAT_WAV);
         // containers.define("RF64", wav::FORMAT_RF64); // Disabled for now
+        containers.define("IQZ", "IQZ (lossless, Int16)", wav::FORMAT_IQZ);
         sampleTypes.define(wav::SAMP_TYPE_UINT8, "Uint8", wav::SAMP_TYPE_UINT8);
         sampleTypes.define(wav::SAMP_TYPE_INT16, "Int16", wav::SAMP_TYPE_INT16);
         sampleTypes.define(wav::SAMP_TYPE_INT32, "Int32", wav::SAMP_TYPE_INT32);
         sampleTypes.define(wav::SAMP_TYPE_FLOAT32, "Float32", wav::SAMP_TYPE_FLOAT32);
-
+        bufferSizes.define(64, "64 MB", 64);
+        bufferSizes.define(128, "128 MB", 128);
+        bufferSizes.define(256, "256 MB", 256);
+        bufferSizes.define(512, "512 MB", 512);
+        bufferSizes.define(1024, "1 GB", 1024);
 
         // Load default config for option lists
         containerId = containers.valueId(wav::FORMAT_WAV);
         sampleTypeId = sampleTypes.valueId(wav::SAMP_TYPE_INT16);
+        bufferSizeId = bufferSizes.valueId(256);
 
         // Load config
         config.acquire();
@@ -72,6 +79,12 @@ public:
         if (config.conf[name].contains("sampleType") && sampleTypes.keyExists(config.conf[name]["sampleType"])) {
             sampleTypeId = sampleTypes.keyId(config.conf[name]["sampleType"]);
         }
+        if (config.conf[name].contains("bufferSize") && bufferSizes.keyExists(config.conf[name]["bufferSize"])) {
+            bufferSizeId = bufferSizes.keyId(config.conf[name]["bufferSize"]);
+        }
+        if (config.conf[name].contains("directIO")) {
+            directIO = config.conf[name]["directIO"];
+        }
         if (config.conf[name].contains("audioStream")) {
             selectedStreamName = config.conf[name]["audioStream"];
         }
@@ -165,14 +178,23 @@ public:
         else {
             samplerate = sigpath::iqFrontEnd.getSampleRate();
         }
+        bool lossless = (containers[containerId] == wav::FORMAT_IQZ);
         writer.setFormat(containers[containerId]);
         writer.setChannels((recMode == RECORDER_MODE_AUDIO && !stereo) ? 1 : 2);
-        writer.setSampleType(sampleTypes[sampleTypeId]);
+        writer.setSampleType(lossless ? wav::SAMP_TYPE_INT16 : sampleTypes[sampleTypeId]);
         writer.setSamplerate(samplerate);
 
+        // The disk is written from its own thread, blocks that don't fit in the buffer are dropped rather than stalling the DSP
+        if (recMode == RECORDER_MODE_AUDIO) {
+            writer.setBuffering(AUDIO_BUFFER_BLOCK, AUDIO_BUFFER_BLOCKS, false, true);
+        }
+        else {
+            writer.setBuffering(BASEBAND_BUFFER_BLOCK, (int)(((size_t)bufferSizes[bufferSizeId] << 20) / BASEBAND_BUFFER_BLOCK), directIO, true);
+        }
+
         // Open file
         std::string vfoName = (recMode == RECORDER_MODE_AUDIO) ? selectedStreamName : "";
-        std::string extension = ".wav";
+        std::string extension = lossless ? ".iqz" : ".wav";
         std::string expandedPath = expandString(folderSelect.path + "/" + genFileName(nameTemplate, recMode, vfoName) + extension);
         if (!writer.open(expandedPath)) {
             flog::error("Failed to open file for recording: {0}", expandedPath);
@@ -192,8 +214,8 @@ public:
             splitter.bindStream(&stereoStream);
         }
         else {
-            // Create and bind IQ stream
-            basebandStream = new dsp::stream<dsp::complex_t>();
+            // Create and bind IQ stream, a slow disk drops blocks instead of stalling the rest of the IQ path
+            basebandStream = new dsp::shared_stream<dsp::complex_t>(BASEBAND_BACKLOG, dsp::DROP_POLICY_OLDEST);
             basebandSink.setInput(basebandStream);
             basebandSink.start();
             sigpath::iqFrontEnd.bindIQStream(basebandStream);
@@ -218,15 +240,30 @@ public:
             // Unbind and destroy IQ stream
             sigpath::iqFrontEnd.unbindIQStream(basebandStream);
             basebandSink.stop();
+            if (basebandStream->getDropped()) {
+                flog::warn("Recorder dropped {} baseband blocks, the disk couldn't keep up", basebandStream->getDropped());
+            }
             delete basebandStream;
+            basebandStream = NULL;
         }
 
         // Close file
+        if (writer.getSamplesDropped()) {
+            flog::warn("Recorder dropped {} samples, the disk couldn't keep up", writer.getSamplesDropped());
+        }
         writer.close();
         
         recording = false;
     }
 
+    // Samples missing from the file, dropped by the writer or by the baseband stream in front of it
+    uint64_t getSamplesDropped() {
+        std::lock_guard<std::recursive_mutex> lck(recMtx);
+        uint64_t dropped = writer.getSamplesDropped();
+        if (basebandStream) { dropped += basebandStream->getDroppedSamples(); }
+        return dropped;
+    }
+
 private:
     static void menuHandler(void* ctx) {
         RecorderModule* _this = (RecorderModule*)ctx;
@@ -277,13 +314,33 @@ private:
             config.release(true);
         }
 
+        // The lossless container is always Int16
+        bool lossless = (_this->containers[_this->containerId] == wav::FORMAT_IQZ);
         ImGui::LeftLabel("Sample type");
         ImGui::FillWidth();
+        if (lossless && !_this->recording) { style::beginDisabled(); }
         if (ImGui::Combo(CONCAT("##_recorder_st_", _this->name), &_this->sampleTypeId, _this->sampleTypes.txt)) {
             config.acquire();
             config.conf[_this->name]["sampleType"] = _this->sampleTypes.key(_this->sampleTypeId);
             config.release(true);
         }
+        if (lossless && !_this->recording) { style::endDisabled(); }
+
+        // Disk buffering for baseband, which is where the data rates are
+        if (_this->recMode == RECORDER_MODE_BASEBAND) {
+            ImGui::LeftLabel("Buffer");
+            ImGui::FillWidth();
+            if (ImGui::Combo(CONCAT("##_recorder_buffer_", _this->name), &_this->bufferSizeId, _this->bufferSizes.txt)) {
+                config.acquire();
+                config.conf[_this->name]["bufferSize"] = _this->bufferSizes.key(_this->bufferSizeId);
+                config.release(true);
+            }
+            if (ImGui::Checkbox(CONCAT("Direct I/O##_recorder_direct_io_", _this->name), &_this->directIO)) {
+                config.acquire();
+                config.conf[_this->name]["directIO"] = _this->directIO;
+                config.release(true);
+            }
+        }
 
         if (_this->recording) { style::endDisabled(); }
 
@@ -352,6 +409,18 @@ private:
             else {
                 ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Recording %02d:%02d:%02d", dtm->tm_hour, dtm->tm_min, dtm->tm_sec);
             }
+
+            // Disk health, any dropped samples or a write error mean the file has gaps
+            int depth = _this->writer.getQueueDepth();
+            int size = std::max(_this->writer.getQueueSize(), 1);
+            uint64_t dropped = _this->getSamplesDropped();
+            if (_this->writer.hasIOError()) {
+                ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Disk write error");
+            }
+            else {
+                ImVec4 color = dropped ? ImVec4(1.0f, 0.0f, 0.0f, 1.0f) : ImGui::GetStyleColorVec4(ImGuiCol_Text);
+                ImGui::TextColored(color, "Buffer %d%%, dropped %.1fs", (depth * 100) / size, (double)dropped / _this->samplerate);
+            }
         }
     }
 
@@ -600,7 +669,15 @@ private:
     bool ignoringSilence = false;
     wav::Writer writer;
     std::recursive_mutex recMtx;
-    dsp::stream<dsp::complex_t>* basebandStream;
+    dsp::shared_stream<dsp::complex_t>* basebandStream = NULL;
+    // Only absorbs scheduling jitter, the writer's own ring does the buffering against the disk
+    static constexpr int BASEBAND_BACKLOG = 4;
+    static constexpr size_t BASEBAND_BUFFER_BLOCK = 4 << 20;
+    static constexpr size_t AUDIO_BUFFER_BLOCK = 256 << 10;
+    static constexpr int AUDIO_BUFFER_BLOCKS = 16;
+    OptionList<int, int> bufferSizes;
+    int bufferSizeId;
+    bool directIO = false;
     dsp::stream<dsp::stereo_t> stereoStream;
     dsp::sink::Handler<dsp::complex_t> basebandSink;
     dsp::sink::Handler<dsp::stereo_t> stereoSink;
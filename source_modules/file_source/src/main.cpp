@@ -19,6 +19,8 @@
 #include <stdexcept>
 #include "utils/wstr.h"
 #include "server.h"
+#include "mapped_iq_file.h"
+#include <condition_variable>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
@@ -34,15 +36,27 @@ ConfigManager config;
 
 class FileSourceModule : public ModuleManager::Instance {
 public:
-    FileSourceModule(std::string name) : fileSelect("", { "Wav IQ Files (*.wav)", "*.wav", "All Files", "*" }) {
+    FileSourceModule(std::string name) : fileSelect("", { "Wav IQ Files (*.wav)", "*.wav", "Lossless IQ Files (*.iqz)", "*.iqz", "Raw IQ Files (*.cu8 *.cs8 *.cs16 *.cf32)", "*.cu8 *.bin *.raw *.cs8 *.cs16 *.cf32 *.cfile", "All Files", "*" }) {
         this->name = name;
         isServer = core::args["server"].b() ? 1 : 0;
 
 //        if (core::args["server"].b()) { return; }
 
+        // 0 means as fast as the pipeline consumes
+        rates.define("1x", "Real-time", 1.0);
+        rates.define("2x", "2x", 2.0);
+        rates.define("4x", "4x", 4.0);
+        rates.define("10x", "10x", 10.0);
+        rates.define("max", "Max", 0.0);
+
         config.acquire();
         fileSelect.setPath(config.conf["path"], true);
+        std::string rateKey = config.conf["rate"];
+        loop = config.conf["loop"];
+        rawSampleRate = config.conf["rawSampleRate"];
         config.release();
+        rateId = rates.keyExists(rateKey) ? rates.keyId(rateKey) : 0;
+        rate = rates[rateId];
 
         handler.ctx = this;
         handler.selectHandler = menuSelected;
@@ -65,8 +79,9 @@ public:
 
         // Iterate over the directory entries
         for (const auto& entry : std::filesystem::directory_iterator(wstr::str2wstr(directoryPath))) {
-            // Check if the entry is a file and has a .wav extension
-            if (entry.is_regular_file() && entry.path().extension() == ".wav") {
+            // Check if the entry is a file with one of the supported extensions
+            static const std::vector<std::string> exts = { ".wav", ".iqz", ".cu8", ".bin", ".raw", ".cs8", ".cs16", ".cf32", ".cfile" };
+            if (entry.is_regular_file() && std::find(exts.begin(), exts.end(), entry.path().extension().string()) != exts.end()) {
                 wavFiles.push_back(entry.path().string());
             }
         }
@@ -164,21 +179,30 @@ private:
     static void start(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
         if (_this->running) { return; }
-        if (_this->reader == NULL) { return; }
+        if (_this->reader == NULL && !_this->mapped.isOpen()) { return; }
         _this->running = true;
-        _this->workerThread = _this->float32Mode ? std::thread(floatWorker, _this) : std::thread(worker, _this);
+        _this->workerThread = std::thread(worker, _this);
         flog::info("FileSourceModule '{0}': Start!", _this->name);
     }
 
     static void stop(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
         if (!_this->running) { return; }
-        if (_this->reader == NULL) { return; }
+        {
+            std::lock_guard<std::mutex> lck(_this->idleMtx);
+            _this->stopWorker = true;
+        }
+        _this->idleCV.notify_all();
         _this->stream.stopWriter();
         _this->workerThread.join();
         _this->stream.clearWriteStop();
+        _this->stopWorker = false;
         _this->running = false;
-        _this->reader->rewind();
+        // Lossless files can't seek, so they start over. Mapped files keep their position.
+        if (_this->reader != NULL) {
+            _this->reader->rewind();
+            _this->compressedPos = 0;
+        }
         flog::info("FileSourceModule '{0}': Stop!", _this->name);
     }
 
@@ -192,7 +216,7 @@ private:
     static void menuHandler(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
         if (isServer) {
-            if (!_this->reader) {
+            if (!_this->reader && !_this->mapped.isOpen()) {
                 _this->openPathFromFileSelect();
             }
             SmGui::LeftLabel("File:");
@@ -219,15 +243,12 @@ private:
             if (_this->running) {
                 SmGui::EndDisabled();
             }
+            _this->playbackMenu();
             return;
         }
 
         if (_this->fileSelect.render("##file_source_" + _this->name)) {
             if (_this->fileSelect.pathIsValid()) {
-                if (_this->reader != NULL) {
-                    _this->reader->close();
-                    delete _this->reader;
-                }
                 try {
                     _this->openPathFromFileSelect();
                 }
@@ -252,23 +273,111 @@ private:
             char streamTime[64];
             strftime(streamTime, sizeof(streamTime), "%Y-%m-%d %H:%M:%S", tmm);
             ImGui::Text("Stream pos: %s", streamTime);
-            ImGui::Checkbox("Float32 Mode##_file_source", &_this->float32Mode);
+
+            if (_this->mapped.isOpen()) {
+                // Seek bar, in seconds from the start of the file
+                float pos = _this->mapped.getPosition() / _this->sampleRate;
+                float duration = _this->mapped.getFrameCount() / _this->sampleRate;
+                char posText[64];
+                int ip = (int)pos, id = (int)duration;
+                snprintf(posText, sizeof(posText), "%02d:%02d:%02d / %02d:%02d:%02d", ip / 3600, (ip / 60) % 60, ip % 60, id / 3600, (id / 60) % 60, id % 60);
+                SmGui::FillWidth();
+                if (ImGui::SliderFloat(CONCAT("##_file_source_pos_", _this->name), &pos, 0.0f, duration, posText)) {
+                    _this->seek((uint64_t)((double)pos * _this->sampleRate));
+                }
+            }
+
+            if (_this->mapped.isRaw()) {
+                if (_this->running) { ImGui::BeginDisabled(); }
+                SmGui::LeftLabel("Sample rate");
+                SmGui::FillWidth();
+                if (ImGui::InputInt(CONCAT("##_file_source_raw_sr_", _this->name), &_this->rawSampleRate, 0, 0) && _this->rawSampleRate > 0) {
+                    _this->sampleRate = _this->rawSampleRate;
+                    core::setInputSampleRate(_this->sampleRate);
+                    config.acquire();
+                    config.conf["rawSampleRate"] = _this->rawSampleRate;
+                    config.release(true);
+                }
+                if (_this->running) { ImGui::EndDisabled(); }
+            }
+            else {
+                // 32-bit PCM tagged files that really hold floats, as some tools write them
+                if (ImGui::Checkbox("Float32 Mode##_file_source", &_this->float32Mode)) {
+                    _this->mapped.setInt32AsFloat(_this->float32Mode);
+                }
+            }
+        }
+
+        _this->playbackMenu();
+    }
+
+    void playbackMenu() {
+        SmGui::LeftLabel("Rate");
+        SmGui::FillWidth();
+        if (SmGui::Combo(CONCAT("##_file_source_rate_", name), &rateId, rates.txt)) {
+            rate = rates[rateId];
+            config.acquire();
+            config.conf["rate"] = rates.key(rateId);
+            config.release(true);
+        }
+        bool _loop = loop;
+        if (SmGui::Checkbox(CONCAT("Loop##_file_source_loop_", name), &_loop)) {
+            {
+                std::lock_guard<std::mutex> lck(idleMtx);
+                loop = _loop;
+            }
+            idleCV.notify_all();
+            config.acquire();
+            config.conf["loop"] = _loop;
+            config.release(true);
+        }
+    }
+
+    void seek(uint64_t frame) {
+        {
+            std::lock_guard<std::mutex> lck(idleMtx);
+            mapped.seek(frame);
+            seekCount++;
+        }
+        idleCV.notify_all();
+        if (streamStartTime != 0) {
+            sigpath::iqFrontEnd.setCurrentStreamTime(streamStartTime + (long long)(mapped.getPosition() * 1000 / (double)sampleRate));
+        }
+    }
+
+    void closeFile() {
+        if (reader != NULL) {
+            reader->close();
+            delete reader;
+            reader = NULL;
         }
+        mapped.close();
+        compressedPos = 0;
     }
 
     void openPath(const std::string &path) {
         try {
             lastError = "";
-            reader = new wav::Reader(path);
-            sampleRate = reader->getSampleRate();
-            if (reader->getSampleRate() == 0) {
-                reader->close();
-                delete reader;
-                reader = NULL;
+            if (running) { throw std::runtime_error("Cannot change file while running"); }
+            closeFile();
+            std::string filename = getFileName(path);
+            // Lossless files are decoded block by block, everything else is mapped
+            if (filename.size() >= 4 && filename.substr(filename.size() - 4) == ".iqz") {
+                reader = new wav::Reader(path);
+                sampleRate = reader->getSampleRate();
+            }
+            else {
+                if (!mapped.open(path)) {
+                    throw std::runtime_error("Cannot open " + filename + ": " + mapped.error);
+                }
+                mapped.setInt32AsFloat(float32Mode);
+                sampleRate = mapped.isRaw() ? getRawSampleRate(filename) : mapped.getSampleRate();
+            }
+            if (sampleRate == 0) {
+                closeFile();
                 throw std::runtime_error("Sample rate may not be zero");
             }
             core::setInputSampleRate(sampleRate);
-            std::string filename = getFileName(path);
             double newFrequency = getFrequency(filename);
             streamStartTime = getStartTime(filename);
             bool fineTune = gui::waterfall.containsFrequency(newFrequency);
@@ -297,62 +406,99 @@ private:
 
     long long streamStartTime = 0;
 
+    // Fills up to count frames, wrapping to the start when looping. Returns 0 at the end of the file,
+    // and -1 when a wrap to the start read nothing either, so there is nothing to loop over.
+    int readBlock(dsp::complex_t* out, int16_t* inBuf, int count) {
+        if (mapped.isOpen()) {
+            int n = mapped.read(out, count);
+            if (n < count && loop) {
+                mapped.seek(0);
+                int m = mapped.read(&out[n], count - n);
+                if (!n && !m) { return -1; }
+                n += m;
+            }
+            return n;
+        }
+
+        int n = reader->readSamples2(inBuf, count * 2 * sizeof(int16_t)) / (2 * sizeof(int16_t));
+        compressedPos += n;
+        if (n < count && loop) {
+            reader->rewind();
+            int m = reader->readSamples2(&inBuf[n * 2], (count - n) * 2 * sizeof(int16_t)) / (2 * sizeof(int16_t));
+            compressedPos = m;
+            if (!n && !m) { return -1; }
+            n += m;
+        }
+        volk_16i_s32f_convert_32f((float*)out, inBuf, 32768.0f, n * 2);
+        return n;
+    }
+
+    // Parks the worker at the end of the file until the user seeks, enables looping or stops.
+    // Looping doesn't wake it when the file turned out to have no samples to loop over.
+    bool waitAtEnd(bool empty) {
+        flog::info("FileSourceModule '{0}': End of file", name);
+        std::unique_lock<std::mutex> lck(idleMtx);
+        uint64_t seeks = seekCount;
+        idleCV.wait(lck, [&]() { return stopWorker || (loop && !empty) || seekCount != seeks; });
+        return !stopWorker;
+    }
+
     static void worker(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
-        double sampleRate = std::max(_this->reader->getSampleRate(), (uint32_t)1);
-        int blockSize = std::min((int)(sampleRate / 200.0f), (int)STREAM_BUFFER_SIZE);
-        int16_t* inBuf = new int16_t[blockSize * 2];
+        double sampleRate = std::max<double>(_this->sampleRate, 1.0);
+        int baseBlockSize = std::clamp((int)(sampleRate / 200.0), 1, (int)STREAM_BUFFER_SIZE);
+        int16_t* inBuf = (_this->reader != NULL) ? new int16_t[STREAM_BUFFER_SIZE * 2] : NULL;
 
-        long long samplesRead = 0;
-        sigpath::iqFrontEnd.setCurrentStreamTime(_this->streamStartTime);
-        auto serverMode = core::args["server"].b();
+        // Pacing state, re-anchored when the rate changes, on seeks, or after falling behind
+        double due = 0;
+        double pacedRate = -1;
+        uint64_t pacedSeeks = 0;
 
-        auto ctm = currentTimeMillis();
         while (true) {
-            _this->reader->readSamples(inBuf, blockSize * 2 * sizeof(int16_t));
-            volk_16i_s32f_convert_32f((float*)_this->stream.writeBuf, inBuf, 32768.0f, blockSize * 2);
-            if (!_this->stream.swap(blockSize)) { break; };
+            double rate = _this->rate;
+            // Faster playback moves bigger blocks (100ms worth at Max) so per-block overhead doesn't cap throughput
+            int blockSize = std::min(baseBlockSize * (rate > 0 ? (int)rate : 20), (int)STREAM_BUFFER_SIZE);
+            int count = _this->readBlock(_this->stream.writeBuf, inBuf, blockSize);
+            if (count <= 0) {
+                if (!_this->waitAtEnd(count < 0)) { break; }
+                pacedRate = -1;
+                continue;
+            }
+            if (!_this->stream.swap(count)) { break; };
 
-            samplesRead += blockSize;
             if (_this->streamStartTime != 0) {
-                long long currentTime = _this->streamStartTime + samplesRead * 1000 / sampleRate;
-                sigpath::iqFrontEnd.setCurrentStreamTime(currentTime);
+                uint64_t pos = _this->mapped.isOpen() ? _this->mapped.getPosition() : _this->compressedPos;
+                sigpath::iqFrontEnd.setCurrentStreamTime(_this->streamStartTime + (long long)(pos * 1000 / sampleRate));
             }
-            if (serverMode) {
-                auto blockLength = (1000 * blockSize) / sampleRate;
-                ctm += blockLength;
-                auto now = currentTimeMillis();
-                auto delay = ctm - now;
+
+            // At Max the blocking swap is the only throttle, the file goes as fast as the decoders take it
+            if (rate > 0) {
+                double now = currentTimeMillis();
+                uint64_t seeks = _this->seekCount;
+                if (rate != pacedRate || seeks != pacedSeeks || now - due > 500) {
+                    due = now;
+                    pacedRate = rate;
+                    pacedSeeks = seeks;
+                }
+                due += (1000.0 * count) / (sampleRate * rate);
+                long long delay = (long long)(due - now);
                 if (delay > 0) {
                     usleep(delay * 1000);
                 }
             }
         }
 
-        delete[] inBuf;
+        if (inBuf) { delete[] inBuf; }
     }
 
-    static void floatWorker(void* ctx) {
-        FileSourceModule* _this = (FileSourceModule*)ctx;
-        double sampleRate = std::max(_this->reader->getSampleRate(), (uint32_t)1);
-        int blockSize = std::min((int)(sampleRate / 200.0f), (int)STREAM_BUFFER_SIZE);
-        dsp::complex_t* inBuf = new dsp::complex_t[blockSize];
-
-        long long samplesRead = 0;
-        sigpath::iqFrontEnd.setCurrentStreamTime(_this->streamStartTime);
-
-        while (true) {
-            _this->reader->readSamples(_this->stream.writeBuf, blockSize * sizeof(dsp::complex_t));
-            if (!_this->stream.swap(blockSize)) { break; };
-
-            samplesRead += blockSize;
-            if (_this->streamStartTime != 0) {
-                long long currentTime = _this->streamStartTime + samplesRead * 1000 / sampleRate;
-                sigpath::iqFrontEnd.setCurrentStreamTime(currentTime);
-            }
+    long long getRawSampleRate(const std::string& filename) {
+        // rtl_sdr captures usually carry the rate in the name, like capture_2048000sps.cu8
+        std::regex expr("([0-9]+)sps", std::regex::icase);
+        std::smatch matches;
+        if (std::regex_search(filename, matches, expr)) {
+            rawSampleRate = std::atoi(matches[1].str().c_str());
         }
-
-        delete[] inBuf;
+        return rawSampleRate;
     }
 
     double getFrequency(std::string filename) {
@@ -368,7 +514,7 @@ private:
         // like baseband_14235774Hz_12-19-14_10-07-2022.wav
 
         if (filename.substr(0, 8) != "baseband") return 0;
-        if (".wav" != filename.substr(filename.size() - 4, 4)) return 0;
+        if (".wav" != filename.substr(filename.size() - 4, 4) && ".iqz" != filename.substr(filename.size() - 4, 4)) return 0;
         auto pos = filename.find("Hz");
         if (pos == std::string::npos) return 0;
         std::string dateTimeStre = filename.substr(pos+3, 19);
@@ -417,6 +563,22 @@ private:
     bool centerFreqSet = false;
 
     bool float32Mode = false;
+
+    // Uncompressed files are mapped and seekable, lossless ones go through reader
+    MappedIQFile mapped;
+    uint64_t compressedPos = 0;
+    int rawSampleRate = 2048000;
+
+    OptionList<std::string, double> rates;
+    int rateId = 0;
+    std::atomic<double> rate = 1.0;
+    std::atomic<bool> loop = true;
+
+    // Wakes the worker parked at the end of the file
+    std::mutex idleMtx;
+    std::condition_variable idleCV;
+    bool stopWorker = false;
+    std::atomic<uint64_t> seekCount = 0;
 };
 
 int FileSourceModule::isServer;
@@ -424,6 +586,9 @@ int FileSourceModule::isServer;
 MOD_EXPORT void _INIT_() {
     json def = json({});
     def["path"] = "";
+    def["rate"] = "1x";
+    def["loop"] = true;
+    def["rawSampleRate"] = 2048000;
     config.setPath(std::string(core::getRoot()) + "/file_source_config.json");
     config.load(def);
     config.enableAutoSave();
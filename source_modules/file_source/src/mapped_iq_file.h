@@ -0,0 +1,250 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <volk/volk.h>
+#include <dsp/types.h>
+#include <utils/wstr.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Uncompressed IQ recording mapped into memory.
+//
+// Reads convert straight from the mapping into the output buffer, so there is no intermediate copy
+// and seeking is only a change of the frame index. Handles the WAV files written by the recorder
+// (Uint8, Int16, Int32 and Float32) and headerless rtl_sdr style captures, whose sample type comes
+// from the extension (.cu8/.bin/.raw, .cs8, .cs16, .cf32/.cfile).
+class MappedIQFile {
+public:
+    enum SampleType {
+        SAMP_UINT8,
+        SAMP_INT8,
+        SAMP_INT16,
+        SAMP_INT32,
+        SAMP_FLOAT32
+    };
+
+    ~MappedIQFile() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+        error = "";
+        if (!map(path)) { close(); return false; }
+        if (!parse(path)) { close(); return false; }
+        frameCount = dataSize / frameSize;
+        if (!frameCount) { error = "no samples"; close(); return false; }
+        position = 0;
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (base) { UnmapViewOfFile(base); }
+        if (mapping) { CloseHandle(mapping); }
+        if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (base) { munmap(base, fileSize); }
+        if (fd >= 0) { ::close(fd); }
+        fd = -1;
+#endif
+        base = NULL;
+        data = NULL;
+        fileSize = 0;
+        dataSize = 0;
+        frameCount = 0;
+        position = 0;
+        raw = false;
+        floatCodec = false;
+        sampleRate = 0;
+        type = SAMP_INT16;
+        frameSize = 4;
+    }
+
+    bool isOpen() { return base != NULL; }
+
+    // Headerless files carry no sample rate, the caller has to supply one
+    bool isRaw() { return raw; }
+    uint32_t getSampleRate() { return sampleRate; }
+    SampleType getSampleType() { return type; }
+
+    uint64_t getFrameCount() { return frameCount; }
+    uint64_t getPosition() { return position.load(std::memory_order_relaxed); }
+
+    // Some tools tag 32-bit float IQ as PCM, this reads such files as Float32
+    void setInt32AsFloat(bool enabled) {
+        if (type == SAMP_INT32 || type == SAMP_FLOAT32) { type = (enabled || floatCodec) ? SAMP_FLOAT32 : SAMP_INT32; }
+    }
+
+    // Safe to call from another thread while read() is running, the seek wins over the block in flight
+    void seek(uint64_t frame) {
+        position.store(std::min<uint64_t>(frame, frameCount), std::memory_order_relaxed);
+    }
+
+    // Converts up to `count` frames at the current position. Returns the number of frames read,
+    // short only at the end of the file.
+    int read(dsp::complex_t* out, int count) {
+        uint64_t pos = position.load(std::memory_order_relaxed);
+        int n = (int)std::min<uint64_t>(count, frameCount - std::min(pos, frameCount));
+        const uint8_t* in = data + pos * frameSize;
+        float* fout = (float*)out;
+        switch (type) {
+        case SAMP_UINT8:
+            for (int i = 0; i < n * 2; i++) { fout[i] = u8Lut[in[i]]; }
+            break;
+        case SAMP_INT8:
+            volk_8i_s32f_convert_32f(fout, (const int8_t*)in, 128.0f, n * 2);
+            break;
+        case SAMP_INT16:
+            volk_16i_s32f_convert_32f(fout, (const int16_t*)in, 32768.0f, n * 2);
+            break;
+        case SAMP_INT32:
+            volk_32i_s32f_convert_32f(fout, (const int32_t*)in, 2147483648.0f, n * 2);
+            break;
+        case SAMP_FLOAT32:
+            memcpy(out, in, n * sizeof(dsp::complex_t));
+            break;
+        }
+        position.compare_exchange_strong(pos, pos + n, std::memory_order_relaxed);
+        return n;
+    }
+
+    std::string error;
+
+private:
+    bool map(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileW(wstr::str2wstr(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) { error = "cannot open file"; return false; }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) { error = "empty file"; return false; }
+        fileSize = size.QuadPart;
+        mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping) { error = "cannot map file"; return false; }
+        base = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!base) { error = "cannot map file"; return false; }
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { error = "cannot open file"; return false; }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) { error = "empty file"; return false; }
+        fileSize = st.st_size;
+        void* ptr = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED) { error = "cannot map file"; return false; }
+        base = (uint8_t*)ptr;
+        // Playback is a linear scan, let the kernel read ahead aggressively
+        madvise(base, fileSize, MADV_SEQUENTIAL);
+#endif
+        return true;
+    }
+
+    bool parse(const std::string& path) {
+        raw = (fileSize < 12 || memcmp(base, "RIFF", 4) != 0);
+        if (raw) { return parseRaw(path); }
+        if (memcmp(base + 8, "WAVE", 4) != 0) { error = "not a WAV file"; return false; }
+
+        // Walk the chunks for the format and data, the recorder writes them in that order but others may not
+        bool haveFormat = false;
+        uint16_t codec = 0, channels = 0, bits = 0;
+        size_t off = 12;
+        while (off + 8 <= fileSize) {
+            const uint8_t* id = base + off;
+            uint32_t size;
+            memcpy(&size, base + off + 4, sizeof(size));
+            off += 8;
+            if (!memcmp(id, "fmt ", 4) && size >= 16 && off + 16 <= fileSize) {
+                memcpy(&codec, base + off, 2);
+                memcpy(&channels, base + off + 2, 2);
+                memcpy(&sampleRate, base + off + 4, 4);
+                memcpy(&bits, base + off + 14, 2);
+                haveFormat = true;
+            }
+            else if (!memcmp(id, "data", 4)) {
+                data = base + off;
+                // Recordings past 4GB wrap the 32-bit chunk size, and an interrupted one never has it patched,
+                // so the size is only trusted when it leaves room for trailing chunks rather than a wrapped length
+                size_t rest = fileSize - off;
+                dataSize = (size && size < rest && ((uint64_t)(rest - size) & 0xFFFFFFFFull)) ? size : rest;
+                break;
+            }
+            off += size + (size & 1);
+        }
+        if (!haveFormat || !data) { error = "missing format or data chunk"; return false; }
+        if (channels != 2) { error = "only two channel IQ files are supported"; return false; }
+
+        // WAV Uint8 is offset binary around 128, as written by the recorder
+        floatCodec = (codec == 3);
+        if (codec == 1 && bits == 8) { setType(SAMP_UINT8, 128.0f, 127.0f); }
+        else if (codec == 1 && bits == 16) { setType(SAMP_INT16); }
+        else if (codec == 1 && bits == 32) { setType(SAMP_INT32); }
+        else if (codec == 3 && bits == 32) { setType(SAMP_FLOAT32); }
+        else { error = "unsupported sample format"; return false; }
+        return true;
+    }
+
+    bool parseRaw(const std::string& path) {
+        std::string ext = path.substr(std::min(path.size(), path.find_last_of('.')));
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        // rtl_sdr writes offset binary centered on 127.5
+        if (ext == ".cu8" || ext == ".bin" || ext == ".raw") { setType(SAMP_UINT8, 127.5f, 127.5f); }
+        else if (ext == ".cs8") { setType(SAMP_INT8); }
+        else if (ext == ".cs16") { setType(SAMP_INT16); }
+        else if (ext == ".cf32" || ext == ".cfile") { setType(SAMP_FLOAT32); }
+        else { error = "unknown raw IQ file type"; return false; }
+        floatCodec = (type == SAMP_FLOAT32);
+        data = base;
+        dataSize = fileSize;
+        sampleRate = 0;
+        return true;
+    }
+
+    void setType(SampleType t, float offset = 0.0f, float scale = 1.0f) {
+        type = t;
+        switch (type) {
+        case SAMP_UINT8:
+        case SAMP_INT8:
+            frameSize = 2;
+            break;
+        case SAMP_INT16:
+            frameSize = 4;
+            break;
+        default:
+            frameSize = 8;
+            break;
+        }
+        // Volk has no unsigned conversion, a table is as fast
+        for (int i = 0; i < 256; i++) { u8Lut[i] = ((float)i - offset) / scale; }
+    }
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+    uint8_t* base = NULL;
+    const uint8_t* data = NULL;
+    size_t fileSize = 0;
+    size_t dataSize = 0;
+    size_t frameSize = 4;
+    uint64_t frameCount = 0;
+    std::atomic<uint64_t> position = 0;
+
+    bool raw = false;
+    bool floatCodec = false;
+    uint32_t sampleRate = 0;
+    SampleType type = SAMP_INT16;
+    float u8Lut[256];
+};
@@ -38,9 +38,12 @@ public:
         compressionTypeList.define("No compression", server::CT_NONE);
         compressionTypeList.define("Legacy ZSTD compression", server::CT_LEGACY);
         compressionTypeList.define("Lossy compression", server::CT_LOSSY);
+        compressionTypeList.define("Streaming ZSTD compression", server::CT_STREAM);
+        compressionTypeList.define("Lossless IQ compression", server::CT_LOSSLESS);
         compressionTypeId = compressionTypeList.valueId(server::CT_NONE);
 
         sampleTypeList.define("Int8", dsp::compression::PCM_TYPE_I8);
+        sampleTypeList.define("Int8 block scaled", dsp::compression::PCM_TYPE_BFP8);
         sampleTypeList.define("Int16", dsp::compression::PCM_TYPE_I16);
         sampleTypeList.define("Float32", dsp::compression::PCM_TYPE_F32);
         sampleTypeId = sampleTypeList.valueId(dsp::compression::PCM_TYPE_I16);
@@ -331,6 +334,16 @@ private:
                     ImGui::TextUnformatted("Compression: server not compatible.");
                 }
             }
+            if (_this->compressionTypeList.value(_this->compressionTypeId) == server::CT_STREAM) {
+                auto stats = _this->client->getStreamCompressionStats();
+                if (stats.level) {
+                    ImGui::Text("Ratio %.2f, level %d, server CPU %.1f%%", stats.ratio, stats.level, stats.serverCpu);
+                }
+                else {
+                    // Older servers answer with per packet compression
+                    ImGui::TextUnformatted("Compression: no stream from server.");
+                }
+            }
 
 
             bool dummy = true;
@@ -349,6 +362,9 @@ private:
             ImGui::TextUnformatted("Status:");
             ImGui::SameLine();
             ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Connected (%.3f Mbit/s), %d%% buffer", _this->datarate, _this->client ? _this->client->getBufferPercentFull() : 0);
+            if (ImGui::Button("Dump server DSP stats##sdrpp_srv_source", ImVec2(menuWidth, 0))) {
+                _this->client->requestDSPStats();
+            }
             ImGui::CollapsingHeader("Source [REMOTE]", ImGuiTreeNodeFlags_DefaultOpen);
 
             _this->client->showMenu();
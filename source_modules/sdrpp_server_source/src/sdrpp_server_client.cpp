@@ -3,6 +3,7 @@
 #include <cstring>
 #include <signal_path/signal_path.h>
 #include <utils/flog.h>
+#include <dsp/compression/lossless_iq.h>
 #include <core.h>
 #include "dsp/compression/experimental_fft_decompressor.h"
 #include <gui/tuner.h>
@@ -244,6 +245,7 @@ namespace server {
 
         // Initialize decompressor
         dctx = ZSTD_createDCtx();
+        streamDctx = ZSTD_createDCtx();
 
         // Initialize DSP
         decompIn.setBufferSize(STREAM_BUFFER_SIZE*sizeof(dsp::complex_t) + 8);
@@ -281,6 +283,7 @@ namespace server {
     Client::~Client() {
         close();
         ZSTD_freeDCtx(dctx);
+        ZSTD_freeDCtx(streamDctx);
         delete[] rbuffer;
         delete[] sbuffer;
     }
@@ -351,12 +354,90 @@ namespace server {
 
     void Client::setCompressionType(CompressionType type) {
         if (!isOpen()) { return; }
-        s_cmd_data[0] = type == CompressionType::CT_LEGACY ? 1 : 0;
+        if (type == CompressionType::CT_STREAM) {
+            s_cmd_data[0] = BASEBAND_COMPRESSION_STREAM;
+        }
+        else if (type == CompressionType::CT_LOSSLESS) {
+            s_cmd_data[0] = BASEBAND_COMPRESSION_LOSSLESS;
+        }
+        else {
+            s_cmd_data[0] = type == CompressionType::CT_LEGACY ? BASEBAND_COMPRESSION_PACKET : BASEBAND_COMPRESSION_NONE;
+        }
         sendCommand(COMMAND_SET_COMPRESSION, 1);
         s_cmd_data[0] = type == CompressionType::CT_LOSSY ? 1 : 0;
         sendCommand(COMMAND_SET_FFTZSTD_COMPRESSION, 1);
     }
 
+    void Client::requestDSPStats() {
+        if (!isOpen()) { return; }
+        sendCommand(COMMAND_GET_DSP_STATS, 0);
+    }
+
+    StreamCompressionStats Client::getStreamCompressionStats() {
+        std::lock_guard<std::mutex> lck(streamStatsMtx);
+        StreamCompressionStats stats;
+        stats.ratio = streamCompressedBytes ? (double)streamRawBytes / (double)streamCompressedBytes : 0.0;
+        stats.level = streamLevel;
+        stats.serverCpu = streamCpuPermille / 10.0;
+        return stats;
+    }
+
+    // Restores the SampleStreamCompressor block into decompIn, returns its size or -1 on error
+    int Client::decodeLossless() {
+        int payloadSize = r_pkt_hdr->size - sizeof(PacketHeader) - 8;
+        if (payloadSize < 0) { return -1; }
+        uint16_t sampleType = *(uint16_t*)&r_pkt_data[2];
+        memcpy(decompIn.writeBuf, r_pkt_data, 8);
+
+        int frames = -1;
+        int sampleBytes = 0;
+        if (sampleType == dsp::compression::PCM_TYPE_I16) {
+            frames = dsp::compression::lossless::decode<int16_t>(&r_pkt_data[8], payloadSize, (int16_t*)&decompIn.writeBuf[8], STREAM_BUFFER_SIZE);
+            sampleBytes = sizeof(int16_t);
+        }
+        else if (sampleType == dsp::compression::PCM_TYPE_I8) {
+            frames = dsp::compression::lossless::decode<int8_t>(&r_pkt_data[8], payloadSize, (int8_t*)&decompIn.writeBuf[8], STREAM_BUFFER_SIZE);
+            sampleBytes = sizeof(int8_t);
+        }
+        if (frames < 0) {
+            flog::error("Invalid lossless baseband packet");
+            return -1;
+        }
+        return 8 + (frames * 2 * sampleBytes);
+    }
+
+    // Returns the number of bytes written to decompIn, 0 while waiting for a new frame or -1 on error
+    int Client::decompressStreamChunk() {
+        int payloadSize = r_pkt_hdr->size - sizeof(PacketHeader) - sizeof(StreamChunkHeader);
+        if (payloadSize < 0) { return -1; }
+        StreamChunkHeader* ch = (StreamChunkHeader*)r_pkt_data;
+
+        // Chunks are only decodable from the start of a frame
+        if (ch->flags & STREAM_CHUNK_NEW_FRAME) {
+            ZSTD_DCtx_reset(streamDctx, ZSTD_reset_session_only);
+            streamSynced = true;
+        }
+        if (!streamSynced) { return 0; }
+
+        ZSTD_inBuffer zin = { &r_pkt_data[sizeof(StreamChunkHeader)], (size_t)payloadSize, 0 };
+        ZSTD_outBuffer zout = { decompIn.writeBuf, STREAM_BUFFER_SIZE*sizeof(dsp::complex_t)+8, 0 };
+        while (zin.pos < zin.size) {
+            size_t ret = ZSTD_decompressStream(streamDctx, &zout, &zin);
+            if (ZSTD_isError(ret) || zout.pos == zout.size) {
+                flog::error("Stream decompression failed: {}", ZSTD_isError(ret) ? ZSTD_getErrorName(ret) : "output full");
+                streamSynced = false;
+                return -1;
+            }
+        }
+
+        std::lock_guard<std::mutex> lck(streamStatsMtx);
+        streamCompressedBytes += r_pkt_hdr->size;
+        streamRawBytes += zout.pos;
+        streamLevel = ch->level;
+        streamCpuPermille = ch->cpuPermille;
+        return zout.pos;
+    }
+
     void Client::setLossFactor(double mult) {
         if (!isOpen()) { return; }
         (*(double *)&s_cmd_data[0]) = mult;
@@ -514,6 +595,10 @@ namespace server {
                         sigpath::transmitter = nullptr;
                     }
                 }
+                else if (r_cmd_hdr->cmd == COMMAND_GET_DSP_STATS) {
+                    std::string str = std::string((char*)r_cmd_data, r_pkt_hdr->size - sizeof(PacketHeader) - sizeof(CommandHeader));
+                    flog::info("Server DSP stats: {}", str);
+                }
                 else if (r_cmd_hdr->cmd == COMMAND_DISCONNECT) {
                     flog::error("Asked to disconnect by the server");
                     serverBusy = true;
@@ -559,6 +644,22 @@ namespace server {
                 if (!decompIn.swap(outCount)) { break; }
                 updateStreamTime(this);
             }
+            else if (r_pkt_hdr->type == PACKET_TYPE_BASEBAND_ZSTD_STREAM) {
+                fftDecompressor.setEnabled(false);
+                int outCount = decompressStreamChunk();
+                if (outCount > 0) {
+                    if (!decompIn.swap(outCount)) { break; }
+                }
+                updateStreamTime(this);
+            }
+            else if (r_pkt_hdr->type == PACKET_TYPE_BASEBAND_LOSSLESS) {
+                fftDecompressor.setEnabled(false);
+                int outCount = decodeLossless();
+                if (outCount > 0) {
+                    if (!decompIn.swap(outCount)) { break; }
+                }
+                updateStreamTime(this);
+            }
             else if (r_pkt_hdr->type == PACKET_TYPE_BASEBAND_COMPRESSED) {
                 fftDecompressor.setEnabled(false);
                 size_t outCount = ZSTD_decompressDCtx(dctx, decompIn.writeBuf, STREAM_BUFFER_SIZE*sizeof(dsp::complex_t)+8, r_pkt_data, r_pkt_hdr->size - sizeof(PacketHeader));
@@ -22,7 +22,16 @@ namespace server {
     enum CompressionType {
         CT_NONE,
         CT_LEGACY,
-        CT_LOSSY
+        CT_LOSSY,
+        CT_STREAM,
+        CT_LOSSLESS
+    };
+
+    // Streaming compression figures as seen by the client
+    struct StreamCompressionStats {
+        double ratio;
+        int level;
+        double serverCpu;
     };
 
 
@@ -104,6 +113,11 @@ namespace server {
         void setLossFactor(double mult);
         void setNoiseMultiplierDB(double mult);
 
+        // The server replies with the cumulative counters of its DSP blocks as JSON, logged when received
+        void requestDSPStats();
+
+        StreamCompressionStats getStreamCompressionStats();
+
         void start();
         void stop();
 
@@ -199,6 +213,17 @@ namespace server {
 
         ZSTD_DCtx* dctx;
 
+        // Streaming compression, only touched by the worker except for the stats
+        int decompressStreamChunk();
+        int decodeLossless();
+        ZSTD_DCtx* streamDctx;
+        bool streamSynced = false;
+        std::mutex streamStatsMtx;
+        uint64_t streamCompressedBytes = 0;
+        uint64_t streamRawBytes = 0;
+        int streamLevel = 0;
+        int streamCpuPermille = 0;
+
         std::thread workerThread;
 
         double currentSampleRate = 1000000.0;